@@ -0,0 +1,370 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+/**
+ * Definitions.
+ *
+ * Defines `size_t` and `NULL`.
+ * https://pubs.opengroup.org/onlinepubs/009696899/basedefs/stddef.h.html
+ */
+#include <stddef.h>
+
+/**
+ * Integers.
+ *
+ * Defines macros that specify limits of integer types corresponding to types defined in other standard headers.
+ * https://pubs.opengroup.org/onlinepubs/009696899/basedefs/stdint.h.html
+ */
+#include <stdint.h>
+
+/**
+ * The Dittobytes runtime library (`libditto-rt`).
+ *
+ * Position independent code cannot call the C library, so this file implements its most common memory & string
+ * routines. It is compiled to bitcode for every target, and only the routines your code calls are linked into
+ * your module (with internal linkage) before the intermediate transpiler runs. They are therefore compiled and
+ * metamorphicated like your own functions. Definitions in your own code always take precedence.
+ *
+ * The routines work a word (8 bytes) at a time where possible. Unaligned word accesses are only used within the
+ * bounds of the buffers (AMD64 & ARM64 allow them), while strings are scanned with aligned words, which never
+ * cross a page boundary. This file must not contain global variables, as they would not be part of `.text`.
+ */
+
+/**
+ * A word of memory that may alias any other type, and that may be unaligned.
+ */
+typedef size_t __attribute__((__may_alias__, __aligned__(1))) word_t;
+
+/**
+ * Word helper macro's (`HAS_ZERO` is non-zero if any byte of the word is zero).
+ */
+#define WORD_SIZE sizeof(word_t)
+#define WORD_ONES ((size_t) -1 / 0xFF)
+#define WORD_HIGHS (WORD_ONES * 0x80)
+#define HAS_ZERO(word) (((word) - WORD_ONES) & ~(word) & WORD_HIGHS)
+#define IS_ALIGNED(pointer) (((uintptr_t) (pointer) & (WORD_SIZE - 1)) == 0)
+
+/**
+ * Copy `n` bytes from `source` to `destination` (the buffers may not overlap).
+ *
+ * @param void* destination The buffer to copy to.
+ * @param const void* source The buffer to copy from.
+ * @param size_t n The amount of bytes to copy.
+ * @return void* The destination.
+ */
+void* memcpy(void* destination, const void* source, size_t n) {
+    unsigned char* d = (unsigned char*) destination;
+    const unsigned char* s = (const unsigned char*) source;
+
+    for (; n >= WORD_SIZE; n -= WORD_SIZE, d += WORD_SIZE, s += WORD_SIZE) {
+        *(word_t*) d = *(const word_t*) s;
+    }
+
+    while (n--) *d++ = *s++;
+
+    return destination;
+}
+
+/**
+ * Copy `n` bytes from `source` to `destination` (the buffers may overlap).
+ *
+ * @param void* destination The buffer to copy to.
+ * @param const void* source The buffer to copy from.
+ * @param size_t n The amount of bytes to copy.
+ * @return void* The destination.
+ */
+void* memmove(void* destination, const void* source, size_t n) {
+    unsigned char* d = (unsigned char*) destination;
+    const unsigned char* s = (const unsigned char*) source;
+
+    if ((uintptr_t) d == (uintptr_t) s || n == 0) return destination;
+
+    // Copying forwards never overwrites bytes that are still to be read if the destination is in front of the source
+    if ((uintptr_t) d < (uintptr_t) s) {
+        for (; n >= WORD_SIZE; n -= WORD_SIZE, d += WORD_SIZE, s += WORD_SIZE) {
+            *(word_t*) d = *(const word_t*) s;
+        }
+
+        while (n--) *d++ = *s++;
+
+        return destination;
+    }
+
+    // Otherwise copy backwards
+    d += n;
+    s += n;
+
+    for (; n >= WORD_SIZE; n -= WORD_SIZE) {
+        d -= WORD_SIZE;
+        s -= WORD_SIZE;
+        *(word_t*) d = *(const word_t*) s;
+    }
+
+    while (n--) *--d = *--s;
+
+    return destination;
+}
+
+/**
+ * Set `n` bytes of `destination` to the (lowest byte of) `value`.
+ *
+ * @param void* destination The buffer to set.
+ * @param int value The value to set every byte to.
+ * @param size_t n The amount of bytes to set.
+ * @return void* The destination.
+ */
+void* memset(void* destination, int value, size_t n) {
+    unsigned char* d = (unsigned char*) destination;
+    size_t splat = (unsigned char) value * WORD_ONES;
+
+    for (; n >= WORD_SIZE; n -= WORD_SIZE, d += WORD_SIZE) {
+        *(word_t*) d = splat;
+    }
+
+    while (n--) *d++ = (unsigned char) value;
+
+    return destination;
+}
+
+/**
+ * Compare the first `n` bytes of two buffers.
+ *
+ * @param const void* a The first buffer.
+ * @param const void* b The second buffer.
+ * @param size_t n The amount of bytes to compare.
+ * @return int Zero if equal, otherwise the difference of the first byte that differs.
+ */
+int memcmp(const void* a, const void* b, size_t n) {
+    const unsigned char* x = (const unsigned char*) a;
+    const unsigned char* y = (const unsigned char*) b;
+
+    // Skip equal words (the byte loop below finds the difference within the first word that differs)
+    for (; n >= WORD_SIZE && *(const word_t*) x == *(const word_t*) y; n -= WORD_SIZE, x += WORD_SIZE, y += WORD_SIZE);
+
+    for (; n > 0; n--, x++, y++) {
+        if (*x != *y) return *x - *y;
+    }
+
+    return 0;
+}
+
+/**
+ * Find the first occurrence of a byte in the first `n` bytes of a buffer.
+ *
+ * @param const void* buffer The buffer to search.
+ * @param int value The byte to find.
+ * @param size_t n The amount of bytes to search.
+ * @return void* The first occurrence, or `NULL` if there is none.
+ */
+void* memchr(const void* buffer, int value, size_t n) {
+    const unsigned char* p = (const unsigned char*) buffer;
+    size_t splat = (unsigned char) value * WORD_ONES;
+
+    // Skip words without the byte (`HAS_ZERO` of the XOR is non-zero if any byte equals the value)
+    for (; n >= WORD_SIZE && !HAS_ZERO(*(const word_t*) p ^ splat); n -= WORD_SIZE, p += WORD_SIZE);
+
+    for (; n > 0; n--, p++) {
+        if (*p == (unsigned char) value) return (void*) p;
+    }
+
+    return NULL;
+}
+
+/**
+ * Calculate the length of a string.
+ *
+ * @param const char* string The string.
+ * @return size_t The amount of bytes before the null terminator.
+ */
+size_t strlen(const char* string) {
+    const char* p = string;
+
+    for (; !IS_ALIGNED(p); p++) {
+        if (*p == '\0') return p - string;
+    }
+
+    for (; !HAS_ZERO(*(const word_t*) p); p += WORD_SIZE);
+
+    for (; *p != '\0'; p++);
+
+    return p - string;
+}
+
+/**
+ * Calculate the length of a string, up to a maximum.
+ *
+ * @param const char* string The string.
+ * @param size_t maximum The maximum amount of bytes to scan.
+ * @return size_t The amount of bytes before the null terminator, or the maximum if there is none before it.
+ */
+size_t strnlen(const char* string, size_t maximum) {
+    const char* p = string;
+    const char* end = string + maximum;
+
+    for (; p < end && !IS_ALIGNED(p); p++) {
+        if (*p == '\0') return p - string;
+    }
+
+    for (; (size_t) (end - p) >= WORD_SIZE && !HAS_ZERO(*(const word_t*) p); p += WORD_SIZE);
+
+    for (; p < end && *p != '\0'; p++);
+
+    return p - string;
+}
+
+/**
+ * Compare two strings.
+ *
+ * @param const char* a The first string.
+ * @param const char* b The second string.
+ * @return int Zero if equal, otherwise the difference of the first byte that differs.
+ */
+int strcmp(const char* a, const char* b) {
+    const unsigned char* x = (const unsigned char*) a;
+    const unsigned char* y = (const unsigned char*) b;
+
+    // Words can only be compared if both strings can be aligned at the same time
+    if ((((uintptr_t) x ^ (uintptr_t) y) & (WORD_SIZE - 1)) == 0) {
+        for (; !IS_ALIGNED(x); x++, y++) {
+            if (*x != *y || *x == '\0') return *x - *y;
+        }
+
+        for (; *(const word_t*) x == *(const word_t*) y && !HAS_ZERO(*(const word_t*) x); x += WORD_SIZE, y += WORD_SIZE);
+    }
+
+    for (; *x == *y && *x != '\0'; x++, y++);
+
+    return *x - *y;
+}
+
+/**
+ * Compare two strings, up to a maximum amount of bytes.
+ *
+ * @param const char* a The first string.
+ * @param const char* b The second string.
+ * @param size_t n The maximum amount of bytes to compare.
+ * @return int Zero if equal, otherwise the difference of the first byte that differs.
+ */
+int strncmp(const char* a, const char* b, size_t n) {
+    const unsigned char* x = (const unsigned char*) a;
+    const unsigned char* y = (const unsigned char*) b;
+
+    // Words can only be compared if both strings can be aligned at the same time
+    if ((((uintptr_t) x ^ (uintptr_t) y) & (WORD_SIZE - 1)) == 0) {
+        for (; n > 0 && !IS_ALIGNED(x); n--, x++, y++) {
+            if (*x != *y || *x == '\0') return *x - *y;
+        }
+
+        for (; n >= WORD_SIZE && *(const word_t*) x == *(const word_t*) y && !HAS_ZERO(*(const word_t*) x); n -= WORD_SIZE, x += WORD_SIZE, y += WORD_SIZE);
+    }
+
+    for (; n > 0; n--, x++, y++) {
+        if (*x != *y || *x == '\0') return *x - *y;
+    }
+
+    return 0;
+}
+
+/**
+ * Copy a string (including its null terminator).
+ *
+ * @param char* destination The buffer to copy to.
+ * @param const char* source The string to copy.
+ * @return char* The destination.
+ */
+char* strcpy(char* destination, const char* source) {
+    char* d = destination;
+    const char* s = source;
+
+    for (; !IS_ALIGNED(s); d++, s++) {
+        if ((*d = *s) == '\0') return destination;
+    }
+
+    for (; !HAS_ZERO(*(const word_t*) s); d += WORD_SIZE, s += WORD_SIZE) {
+        *(word_t*) d = *(const word_t*) s;
+    }
+
+    while ((*d++ = *s++) != '\0');
+
+    return destination;
+}
+
+/**
+ * Copy a string of at most `n` bytes, and pad the remainder of the `n` bytes with null terminators.
+ *
+ * @param char* destination The buffer to copy to.
+ * @param const char* source The string to copy.
+ * @param size_t n The amount of bytes to write.
+ * @return char* The destination.
+ */
+char* strncpy(char* destination, const char* source, size_t n) {
+    size_t length = strnlen(source, n);
+
+    memcpy(destination, source, length);
+    memset(destination + length, 0, n - length);
+
+    return destination;
+}
+
+/**
+ * Append a string to another string.
+ *
+ * @param char* destination The string to append to.
+ * @param const char* source The string to append.
+ * @return char* The destination.
+ */
+char* strcat(char* destination, const char* source) {
+    strcpy(destination + strlen(destination), source);
+    return destination;
+}
+
+/**
+ * Find the first occurrence of a character in a string.
+ *
+ * @param const char* string The string to search.
+ * @param int character The character to find (which may be the null terminator).
+ * @return char* The first occurrence, or `NULL` if there is none.
+ */
+char* strchr(const char* string, int character) {
+    const char* p = string;
+    size_t splat = (unsigned char) character * WORD_ONES;
+
+    for (; !IS_ALIGNED(p); p++) {
+        if (*p == (char) character) return (char*) p;
+        if (*p == '\0') return NULL;
+    }
+
+    for (; !HAS_ZERO(*(const word_t*) p) && !HAS_ZERO(*(const word_t*) p ^ splat); p += WORD_SIZE);
+
+    for (; *p != (char) character; p++) {
+        if (*p == '\0') return NULL;
+    }
+
+    return (char*) p;
+}
+
+/**
+ * Find the last occurrence of a character in a string.
+ *
+ * @param const char* string The string to search.
+ * @param int character The character to find (which may be the null terminator).
+ * @return char* The last occurrence, or `NULL` if there is none.
+ */
+char* strrchr(const char* string, int character) {
+    const char* last = NULL;
+
+    do {
+        if (*string == (char) character) last = string;
+    } while (*string++ != '\0');
+
+    return (char*) last;
+}
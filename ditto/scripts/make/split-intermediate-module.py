@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+
+# GNU General Public License, version 2.0.
+#
+# Copyright (c) 2025 Tijme Gommers (@tijme).
+#
+# This source code file is part of Dittobytes. Dittobytes is
+# licensed under GNU General Public License, version 2.0, and
+# you are free to use, modify, and distribute this file under
+# its terms. However, any modified versions of this file must
+# include this same license and copyright notice.
+
+import os
+import re
+import subprocess
+import sys
+
+def get_defined_symbols(partition_file):
+    """
+    Retrieve the names of all symbols that are defined in an LLVM bitcode file.
+
+    Args:
+        partition_file (str): The path to the bitcode file.
+
+    Returns:
+        set: The (possibly mangled) names of the defined symbols.
+
+    """
+
+    output = subprocess.run(['llvm-nm', '--defined-only', '--format=just-symbols', partition_file], check=True, capture_output=True, text=True).stdout
+    return set(output.split())
+
+def count_instructions(partition_ir):
+    """
+    Count the instructions of all functions that are defined in an LLVM IL module.
+
+    Args:
+        partition_ir (str): The textual IL of the module.
+
+    Returns:
+        int: The amount of instructions.
+
+    """
+
+    result = 0
+    in_function = False
+
+    for line in partition_ir.splitlines():
+        if line.startswith('define '):
+            in_function = True
+        elif line.startswith('}'):
+            in_function = False
+        elif in_function and re.match(r'\s+[^\s;]', line):
+            result += 1
+
+    return result
+
+def add_payload_share(partition_file, partition_ir, share):
+    """
+    Add the share of the payload that a partition holds as a module flag (`ditto-payload-share`), so that the
+    machine transpiler can give every partition its share of an absolute payload growth budget.
+
+    Args:
+        partition_file (str): The path to the bitcode file.
+        partition_ir (str): The textual IL of the partition.
+        share (float): The share of the payload (between 0 and 1).
+
+    """
+
+    identifiers = [int(identifier) for identifier in re.findall(r'^!(\d+) = ', partition_ir, re.MULTILINE)]
+    identifier = max(identifiers, default=-1) + 1
+
+    flags = re.search(r'^!llvm\.module\.flags = !\{(.*)\}$', partition_ir, re.MULTILINE)
+
+    if flags:
+        partition_ir = partition_ir[:flags.start()] + f'!llvm.module.flags = !{{{flags.group(1)}, !{identifier}}}' + partition_ir[flags.end():]
+    else:
+        partition_ir += f'\n!llvm.module.flags = !{{!{identifier}}}\n'
+
+    partition_ir += f'!{identifier} = !{{i32 1, !"ditto-payload-share", !"{share:.6f}"}}\n'
+
+    subprocess.run(['llvm-as', '-o', partition_file, '-'], input=partition_ir, check=True, text=True)
+
+def main():
+    """
+    Main entry point of the script. Splits an LLVM IL file (.ll) into a fixed amount of partitions (`.partN.bc`), so
+    that every partition can be compiled (and metamorphicated) in parallel. Local symbols are kept in the partition
+    of their users, so their linkage does not change. The partition that defines the entry function is swapped with
+    the first one, so that the entry function is the first function of the first object (and thus of the `.text`
+    segment). Which function ends up in which partition only depends on the function names and the amount of
+    partitions, never on the amount of threads the partitions are compiled with. Every partition is annotated with
+    its share of the payload (by amount of instructions), which absolute payload growth budgets are divided by.
+    """
+
+    if len(sys.argv) != 4:
+        print("Usage: python split-intermediate-module.py <intermediate_file> <partitions> <entry_function>")
+        sys.exit(1)
+
+    intermediate_file = sys.argv[1]
+    partitions = int(sys.argv[2])
+    entry_function = sys.argv[3]
+
+    if partitions < 1:
+        print("Error: The amount of partitions must be at least 1.")
+        sys.exit(1)
+
+    prefix = os.path.splitext(intermediate_file)[0] + '.part'
+
+    subprocess.run(['llvm-split', '-j', str(partitions), '-preserve-locals', '-o', prefix, intermediate_file], check=True)
+
+    partition_files = []
+    for index in range(partitions):
+        partition_files.append(f'{prefix}{index}.bc')
+        os.replace(f'{prefix}{index}', partition_files[index])
+
+    # Mach-O symbols are prefixed with an underscore
+    entry_symbols = {entry_function, '_' + entry_function}
+
+    for index, partition_file in enumerate(partition_files):
+        if index == 0 or not (get_defined_symbols(partition_file) & entry_symbols):
+            continue
+
+        os.replace(partition_files[0], prefix + 'swap.bc')
+        os.replace(partition_file, partition_files[0])
+        os.replace(prefix + 'swap.bc', partition_file)
+        break
+
+    partition_irs = [subprocess.run(['llvm-dis', '-o', '-', partition_file], check=True, capture_output=True, text=True).stdout for partition_file in partition_files]
+    instructions = [count_instructions(partition_ir) for partition_ir in partition_irs]
+
+    for index, partition_file in enumerate(partition_files):
+        share = (instructions[index] / sum(instructions)) if sum(instructions) else (1 / partitions)
+        add_payload_share(partition_file, partition_irs[index], share)
+
+if __name__ == "__main__":
+    main()
@@ -154,7 +154,7 @@ class ExtractActionWin:
             instructions (CsInsn): A instruction to parse.
 
         Returns:
-            dict: An object with the instructions information.
+            dict: An object with the instructions information (including its bytes and the registers it writes to).
 
         """
 
@@ -163,9 +163,18 @@ class ExtractActionWin:
             "op_str": instruction.op_str,
             "id": instruction.id,
             "operands": [],
-            "size": instruction.size
+            "size": instruction.size,
+            "bytes": instruction.bytes.hex(),
+            "regs_write": None
         }
 
+        try:
+            _, regs_write = instruction.regs_access()
+            result["regs_write"] = [instruction.reg_name(reg) for reg in regs_write]
+        except CsError:
+            # Blocks with unknown register access are not used as noise
+            pass
+
         for op in instruction.operands:
             op_entry = {"type": op.type}
 
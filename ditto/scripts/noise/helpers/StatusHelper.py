@@ -27,6 +27,7 @@ class StatusHelper:
     ERROR_INVALID_DIRECTORY = (0x00000004, '!', 'Invalid input directory')
     ERROR_INVALID_PLATFORM = (0x00000005, '!', 'Invalid platform')
     ERROR_INVALID_ARCH = (0x00000006, '!', 'Invalid architecture')
+    ERROR_INVALID_CORPUS = (0x00000007, '!', 'Invalid (or missing) corpus {}')
 
     @staticmethod
     def exit(status, variables=[]):
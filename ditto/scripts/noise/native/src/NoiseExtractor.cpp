@@ -0,0 +1,256 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include "helpers/NoiseBlockExtractor.cpp"
+#include "helpers/NoiseCorpusState.cpp"
+#include "helpers/NoiseCorpusWriter.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * Exit codes (the same as the ones of `noise.py`).
+ */
+static constexpr int SUCCESS = 0x00000000;
+static constexpr int ERROR_FATAL_ERROR = 0x00000001;
+static constexpr int ERROR_INVALID_ARGUMENTS = 0x00000003;
+static constexpr int ERROR_INVALID_DIRECTORY = 0x00000004;
+static constexpr int ERROR_INVALID_PLATFORM = 0x00000005;
+static constexpr int ERROR_INVALID_ARCH = 0x00000006;
+static constexpr int ERROR_INVALID_CORPUS = 0x00000007;
+
+/**
+ * Command-line options.
+ */
+static cl::opt<std::string> Platform(cl::Positional, cl::desc("<platform (win|lin|mac)>"), cl::Required);
+static cl::opt<std::string> Architecture(cl::Positional, cl::desc("<arch (amd64|arm64)>"), cl::Required);
+static cl::opt<std::string> Directory(cl::Positional, cl::desc("<directory>"), cl::Optional);
+static cl::opt<std::string> Output("output", cl::desc("Path of the compiled corpus (default: ./ditto/scripts/noise/data/<platform>-<arch>.bin)"), cl::init(""));
+static cl::opt<std::string> State("state", cl::desc("Directory of the incremental state (default: <output>.state)"), cl::init(""));
+static cl::opt<std::string> Source("source", cl::desc("Name of the source the files in the directory belong to (default: the absolute directory)"), cl::init(""));
+static cl::opt<std::string> RemoveSource("remove-source", cl::desc("Remove the contributions of all files of a source (instead of extracting)"), cl::init(""));
+static cl::opt<unsigned> Top("top", cl::desc("Amount of most frequent block patterns to keep (default: 100000)"), cl::init(100000));
+static cl::opt<unsigned> SketchMemory("sketch-memory", cl::desc("Memory (in MiB) of the count-min sketch that counts the patterns (default: 64)"), cl::init(64));
+static cl::opt<unsigned> Jobs("jobs", cl::desc("Amount of extractor threads (default: all hardware threads)"), cl::init(0));
+static cl::alias JobsShort("j", cl::desc("Alias for --jobs"), cl::aliasopt(Jobs));
+
+/**
+ * Statistics of a run.
+ */
+struct ExtractionStatistics {
+    std::atomic<uint64_t> unchanged { 0 };
+    std::atomic<uint64_t> duplicates { 0 };
+    std::atomic<uint64_t> binaries { 0 };
+};
+
+/**
+ * Count a single file, unless it is unchanged since the previous run or its contents were counted already.
+ *
+ * @param const std::string& path The absolute path of the file.
+ * @param const std::string& source The source of the run.
+ * @param const NoiseBlockExtractor& extractor The extractor of the current thread.
+ * @param NoiseCorpusState& state The state of the corpus.
+ * @param NoiseCorpusWriter& writer The corpus writer.
+ * @param ExtractionStatistics& statistics The statistics of the run.
+ */
+static void extractFile(const std::string& path, const std::string& source, const NoiseBlockExtractor& extractor, NoiseCorpusState& state, NoiseCorpusWriter& writer, ExtractionStatistics& statistics) {
+    sys::fs::file_status status;
+    if (sys::fs::status(path, status) || status.type() != sys::fs::file_type::regular_file) return;
+
+    ManifestEntry entry;
+    entry.size = status.getSize();
+    entry.modified = status.getLastModificationTime().time_since_epoch().count();
+    entry.source = source;
+
+    if (state.isUnchanged(path, entry.size, entry.modified, source)) {
+        statistics.unchanged++;
+        return;
+    }
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(path, false, false);
+    if (!file) return;
+
+    MemoryBufferRef buffer = (*file)->getMemBufferRef();
+
+    // Files that are not binaries of the platform are recorded too, so that they are skipped next time
+    if (extractor.isPlatformBinary(buffer)) entry.contentHash = std::max<uint64_t>(xxh3_64bits(arrayRefFromStringRef(buffer.getBuffer())), 1);
+
+    if (!state.record(path, entry)) {
+        if (entry.contentHash) statistics.duplicates++;
+        return;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> counts;
+    extractor.extract(buffer, writer, counts);
+    statistics.binaries++;
+
+    if (std::error_code error = state.contribute(entry.contentHash, counts)) {
+        errs() << "[!] Warning: Could not store the contribution of " << path << " (" << error.message() << ").\n";
+    }
+}
+
+/**
+ * Extract semantic noise from all binaries in a directory (recursively) into a compiled noise corpus.
+ *
+ * Every file is handed to a thread pool as soon as it is found, so the walk and the extraction overlap. The
+ * workers memory-map and disassemble their file, and stream its blocks into the corpus writer, which counts
+ * them in a fixed amount of memory and keeps the most frequent patterns. The result can be used by the machine
+ * transpiler directly, without `noise.py extract` or `noise.py provide`.
+ *
+ * Runs are incremental (see `NoiseCorpusState`): only new or changed files are read, and the counts of files
+ * that were removed or changed (or of a source that is removed with `--remove-source`) are subtracted.
+ *
+ * @param int argc The amount of command-line arguments.
+ * @param char** argv The command-line arguments.
+ * @return int The exit code.
+ */
+int main(int argc, char** argv) {
+    InitLLVM X(argc, argv);
+
+    LLVMInitializeX86TargetInfo();
+    LLVMInitializeX86TargetMC();
+    LLVMInitializeX86Disassembler();
+    LLVMInitializeAArch64TargetInfo();
+    LLVMInitializeAArch64TargetMC();
+    LLVMInitializeAArch64Disassembler();
+
+    cl::ParseCommandLineOptions(argc, argv, "Dittobytes native semantic noise extractor\n");
+
+    if (Platform != "win" && Platform != "lin" && Platform != "mac") {
+        errs() << "[!] Error: Invalid platform.\n";
+        return ERROR_INVALID_PLATFORM;
+    }
+
+    if (Architecture != "amd64" && Architecture != "arm64") {
+        errs() << "[!] Error: Invalid architecture.\n";
+        return ERROR_INVALID_ARCH;
+    }
+
+    if (Directory.empty() == RemoveSource.empty()) {
+        errs() << "[!] Error: Invalid command-line arguments (pass either a directory or --remove-source).\n";
+        return ERROR_INVALID_ARGUMENTS;
+    }
+
+    SmallString<256> directory(Directory);
+    if (!Directory.empty() && (!sys::fs::is_directory(directory) || sys::fs::make_absolute(directory))) {
+        errs() << "[!] Error: Invalid input directory.\n";
+        return ERROR_INVALID_DIRECTORY;
+    }
+
+    std::string outputPath = Output.empty() ? "./ditto/scripts/noise/data/" + Platform + "-" + Architecture + ".bin" : std::string(Output);
+    std::string statePath = State.empty() ? outputPath + ".state" : std::string(State);
+    std::string source = !RemoveSource.empty() ? std::string(RemoveSource) : (Source.empty() ? std::string(directory) : std::string(Source));
+    std::string platform = Platform;
+    std::string arch = Architecture;
+
+    NoiseCorpusWriter writer((uint64_t) SketchMemory << 20, Top);
+    NoiseCorpusState state(statePath);
+
+    if (std::error_code error = state.create()) {
+        errs() << "[!] Error: Could not create state directory " << statePath << " (" << error.message() << ").\n";
+        return ERROR_FATAL_ERROR;
+    }
+
+    if (!state.load(writer)) {
+        errs() << "[!] Error: Invalid (or corrupt) state " << statePath << " (remove it to start over).\n";
+        return ERROR_INVALID_CORPUS;
+    }
+
+    outs() << "[+] Loaded state " << statePath << " with " << state.getFileCount() << " file(s).\n";
+
+    auto start = std::chrono::steady_clock::now();
+    size_t removedCount = 0;
+
+    if (!RemoveSource.empty()) {
+        removedCount = state.removeSource(source, nullptr);
+    } else {
+        ThreadPool pool(hardware_concurrency(Jobs));
+        ExtractionStatistics statistics;
+        std::set<std::string> paths;
+
+        outs() << "[+] Iterating over binaries in directory " << directory << " (source " << source << ") using " << pool.getThreadCount() << " thread(s).\n";
+        outs() << "[+] Keeping the " << Top << " most frequent pattern(s), counted in " << (writer.getSketchMemory() >> 20) << " MiB.\n";
+
+        std::error_code error;
+        // Symbolic links are not followed (they cause loops, e.g. `/usr/bin/X11`, and would count binaries twice)
+        for (sys::fs::recursive_directory_iterator entry(directory, error, false), end; entry != end && !error; entry.increment(error)) {
+            if (entry->type() == sys::fs::file_type::directory_file || entry->type() == sys::fs::file_type::symlink_file) continue;
+
+            auto inserted = paths.insert(entry->path());
+
+            pool.async([&, path = *inserted.first] {
+                // Every thread disassembles with its own MC layer
+                thread_local NoiseBlockExtractor extractor(platform, arch);
+                extractFile(path, source, extractor, state, writer, statistics);
+            });
+        }
+
+        pool.wait();
+
+        // Files of the source that were not found are only removed after a complete walk
+        if (error) {
+            errs() << "[!] Warning: Stopped iterating over " << directory << " (" << error.message() << ").\n";
+        } else {
+            removedCount = state.removeSource(source, &paths);
+        }
+
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count();
+        outs() << "[+] Extracted " << writer.getReceived() << " block(s) from " << statistics.binaries << " new or changed binary(ies) (of " << paths.size() << " file(s)) in " << seconds << " second(s).\n";
+        outs() << "[+] Skipped " << statistics.unchanged << " unchanged file(s) and " << statistics.duplicates << " copy(ies) of counted binaries.\n";
+    }
+
+    size_t subtractedCount = state.subtractUnreferenced(writer);
+    writer.refresh();
+
+    outs() << "[+] Removed " << removedCount << " file(s), and subtracted the counts of " << subtractedCount << " binary(ies) that are no longer referred to.\n";
+
+    if (std::error_code writeError = writer.write(outputPath)) {
+        errs() << "[!] Error: Could not write " << outputPath << " (" << writeError.message() << ").\n";
+        return ERROR_FATAL_ERROR;
+    }
+
+    if (std::error_code saveError = state.save(writer)) {
+        errs() << "[!] Error: Could not save state " << statePath << " (" << saveError.message() << ").\n";
+        return ERROR_FATAL_ERROR;
+    }
+
+    outs() << "[+] Saved " << writer.getPatternCount() << " pattern(s) in " << writer.getBucketCount() << " bucket(s) to " << outputPath << ".\n";
+    outs() << "[+] Finished\n";
+
+    return SUCCESS;
+}
@@ -0,0 +1,162 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * A count-min sketch of 64-bit hashes in a fixed amount of memory.
+ *
+ * Every row maps a hash to one of `width` counters. Adding a hash increments its counter in every row, and
+ * the estimate of a hash is the minimum of its counters. The estimate is never lower than the real count,
+ * and is at most `e / width` times the total amount of additions higher (with high probability). Counters
+ * are atomic, so all extractor threads add to the same sketch without a lock. The sketch is linear, so the
+ * counts of an earlier run can be merged into it, and counts that were added can be subtracted exactly.
+ */
+class CountMinSketch {
+
+private:
+
+    /**
+     * The amount of rows, and the amount of counters per row (a power of two).
+     */
+    static constexpr unsigned DEPTH = 4;
+    uint64_t width;
+
+    /**
+     * The counters (row after row).
+     */
+    std::unique_ptr<std::atomic<uint32_t>[]> counters;
+
+    /**
+     * Retrieve the counter of a hash in a row.
+     *
+     * @param uint64_t hash The hash.
+     * @param unsigned row The row.
+     * @return std::atomic<uint32_t>& The counter.
+     */
+    std::atomic<uint32_t>& getCounter(uint64_t hash, unsigned row) const {
+        // Derive an independent index per row from the one hash (double hashing)
+        uint64_t rowHash = (hash + row * ((hash >> 32) | 1)) * 0x9E3779B97F4A7C15ULL;
+        return counters[row * width + (rowHash >> 32) % width];
+    }
+
+public:
+
+    /**
+     * Allocate a (zeroed) sketch.
+     *
+     * @param uint64_t memory The maximum amount of memory (in bytes) of the counters.
+     */
+    explicit CountMinSketch(uint64_t memory) {
+        width = 1;
+        while (width * 2 * DEPTH * sizeof(uint32_t) <= memory) width *= 2;
+
+        counters.reset(new std::atomic<uint32_t>[DEPTH * width]());
+    }
+
+    /**
+     * Count a hash.
+     *
+     * @param uint64_t hash The hash to count.
+     * @return uint32_t The estimated count of the hash (including this addition).
+     */
+    uint32_t add(uint64_t hash) {
+        uint32_t result = UINT32_MAX;
+
+        for (unsigned row = 0; row < DEPTH; row++) {
+            result = std::min(result, getCounter(hash, row).fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+
+        return result;
+    }
+
+    /**
+     * Subtract counts that were added before (not thread-safe with concurrent additions of the same hash).
+     *
+     * @param uint64_t hash The hash.
+     * @param uint32_t count The count to subtract.
+     */
+    void subtract(uint64_t hash, uint32_t count) {
+        for (unsigned row = 0; row < DEPTH; row++) {
+            std::atomic<uint32_t>& counter = getCounter(hash, row);
+            uint32_t value = counter.load(std::memory_order_relaxed);
+            counter.store(value > count ? value - count : 0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Estimate the count of a hash.
+     *
+     * @param uint64_t hash The hash.
+     * @return uint32_t The estimated count.
+     */
+    uint32_t estimate(uint64_t hash) const {
+        uint32_t result = UINT32_MAX;
+
+        for (unsigned row = 0; row < DEPTH; row++) {
+            result = std::min(result, getCounter(hash, row).load(std::memory_order_relaxed));
+        }
+
+        return result;
+    }
+
+    /**
+     * Retrieve the amount of memory that is used by the counters.
+     *
+     * @return uint64_t The size (in bytes).
+     */
+    uint64_t getMemory() const {
+        return DEPTH * width * sizeof(uint32_t);
+    }
+
+    /**
+     * Retrieve a copy of all counters (e.g. to persist them).
+     *
+     * @return std::vector<uint32_t> The counters (row after row).
+     */
+    std::vector<uint32_t> getCounters() const {
+        std::vector<uint32_t> result(DEPTH * width);
+
+        for (uint64_t index = 0; index < DEPTH * width; index++) {
+            result[index] = counters[index].load(std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+    /**
+     * Replace all counters (e.g. by persisted ones).
+     *
+     * @param const uint32_t* values The counters (row after row).
+     * @param uint64_t count The amount of counters.
+     * @return bool Positive if the amount of counters matches the size of this sketch.
+     */
+    bool setCounters(const uint32_t* values, uint64_t count) {
+        if (count != DEPTH * width) return false;
+
+        for (uint64_t index = 0; index < count; index++) {
+            counters[index].store(values[index], std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+};
@@ -0,0 +1,319 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCDisassembler/MCDisassembler.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCInstrDesc.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/MCTargetOptions.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Object/Binary.h"
+#include "llvm/Object/MachOUniversal.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "NoiseCorpusWriter.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+using namespace llvm::object;
+
+/**
+ * Extracts the basic blocks of the executable sections of binaries (of one platform & architecture).
+ *
+ * Binaries (memory-mapped by the caller) are disassembled linearly with the MC disassembler of the target. Like
+ * the Python extractors, a block ends at any jump, call, return or trap, and only blocks of 3 to 99
+ * instructions are kept. The register footprint of a block is derived from the explicit and implicit
+ * definitions of its instructions, using the same rules as `noise.py provide`. The pattern of a block
+ * is a hash of its opcodes and operand kinds, so blocks that only differ in registers & immediates are
+ * counted as the same pattern.
+ *
+ * Blocks are streamed into the corpus writer in batches, so memory use does not grow with the size of a binary.
+ * The count of every pattern in a binary is returned as well, so that its contribution can be removed later.
+ * An instance is not thread-safe (the MC layer keeps state per disassembly), so every thread uses its own.
+ */
+class NoiseBlockExtractor {
+
+private:
+
+    /**
+     * The amount of blocks that is handed to the corpus writer at once.
+     */
+    static constexpr size_t BATCH_SIZE = 4096;
+
+    /**
+     * The platform (`win`, `lin` or `mac`) and whether the architecture is ARM64 (or AMD64).
+     */
+    std::string platform;
+    bool arm64;
+
+    /**
+     * The MC layer of the target.
+     */
+    std::unique_ptr<MCRegisterInfo> MRI;
+    std::unique_ptr<MCAsmInfo> MAI;
+    std::unique_ptr<MCSubtargetInfo> STI;
+    std::unique_ptr<MCInstrInfo> MII;
+    std::unique_ptr<MCContext> context;
+    std::unique_ptr<MCDisassembler> disassembler;
+
+    /**
+     * The footprint bit of every physical register (indexed by register number).
+     */
+    std::vector<int> footprintBits;
+
+    /**
+     * Add the footprint bit of a written register to the block.
+     *
+     * @param ExtractedBlock& block The block that is being extracted.
+     * @param unsigned reg The written physical register.
+     * @param bool isReturnAddress Whether a write to the stack pointer is the return address of a terminating call or return.
+     */
+    void addWrittenRegister(ExtractedBlock& block, unsigned reg, bool isReturnAddress) const {
+        if (reg == 0 || reg >= footprintBits.size()) return;
+
+        int bit = footprintBits[reg];
+
+        // The return address that a terminating call or return pushes or pops
+        if (!arm64 && bit == 4 && isReturnAddress) return;
+
+        if (bit >= 0) block.footprint |= 1ULL << bit;
+    }
+
+    /**
+     * Append the pattern of an instruction (its opcode & the kinds of its operands) to the pattern of a block.
+     *
+     * @param const MCInst& instruction The instruction.
+     * @param std::vector<uint32_t>& pattern The pattern of the block.
+     */
+    static void addPattern(const MCInst& instruction, std::vector<uint32_t>& pattern) {
+        pattern.push_back(instruction.getOpcode());
+
+        for (const MCOperand& operand : instruction) {
+            if (operand.isReg()) pattern.push_back(operand.getReg() ? 1 : 0);
+            else if (operand.isImm()) pattern.push_back(2);
+            else if (operand.isSFPImm() || operand.isDFPImm()) pattern.push_back(3);
+            else pattern.push_back(4);
+        }
+    }
+
+    /**
+     * Disassemble an executable section and group its instructions per basic block.
+     *
+     * @param ArrayRef<uint8_t> section The contents of the section.
+     * @param uint64_t address The address of the section.
+     * @param std::vector<ExtractedBlock>& blocks The extracted blocks that were not yet written (appended to).
+     * @param NoiseCorpusWriter& writer The corpus writer to stream full batches into.
+     * @param std::unordered_map<uint64_t, uint32_t>& counts The count of every pattern in the binary (updated).
+     */
+    void extractSection(ArrayRef<uint8_t> section, uint64_t address, std::vector<ExtractedBlock>& blocks, NoiseCorpusWriter& writer, std::unordered_map<uint64_t, uint32_t>& counts) const {
+        ExtractedBlock current;
+        std::vector<uint32_t> pattern;
+        unsigned instructionCount = 0;
+        uint64_t offset = 0;
+
+        while (offset < section.size()) {
+            MCInst instruction;
+            uint64_t size = 0;
+
+            if (disassembler->getInstruction(instruction, size, section.slice(offset), address + offset, nulls()) != MCDisassembler::Success || size == 0) {
+                // Resynchronize after data or an unknown instruction (the block is incomplete)
+                offset += arm64 ? 4 : 1;
+                current = ExtractedBlock();
+                pattern.clear();
+                instructionCount = 0;
+                continue;
+            }
+
+            const MCInstrDesc& desc = MII->get(instruction.getOpcode());
+            bool isTerminator = desc.isBranch() || desc.isIndirectBranch() || desc.isCall() || desc.isReturn() || desc.isTrap() || desc.isBarrier();
+
+            // Blocks that are too long are dropped anyway, so stop collecting them
+            if (++instructionCount < 100) {
+                for (unsigned index = 0; index < desc.getNumDefs() && index < instruction.getNumOperands(); index++) {
+                    const MCOperand& operand = instruction.getOperand(index);
+                    if (operand.isReg()) addWrittenRegister(current, operand.getReg(), false);
+                }
+
+                for (MCPhysReg reg : desc.implicit_defs()) {
+                    addWrittenRegister(current, reg, isTerminator && (desc.isCall() || desc.isReturn()));
+                }
+
+                addPattern(instruction, pattern);
+                current.lengths.push_back(size);
+                current.bytes.insert(current.bytes.end(), section.begin() + offset, section.begin() + offset + size);
+            }
+
+            offset += size;
+            if (!isTerminator) continue;
+
+            // Blocks that write unknown registers are still counted (but never stored) by the corpus writer
+            if (instructionCount > 2 && instructionCount < 100) {
+                current.pattern = xxh3_64bits(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t*>(pattern.data()), pattern.size() * sizeof(uint32_t)));
+                counts[current.pattern]++;
+                blocks.push_back(std::move(current));
+                if (blocks.size() >= BATCH_SIZE) writer.add(blocks);
+            }
+
+            current = ExtractedBlock();
+            pattern.clear();
+            instructionCount = 0;
+        }
+    }
+
+    /**
+     * Extract the blocks of all executable sections of an object file (of the architecture).
+     *
+     * @param const ObjectFile& object The object file.
+     * @param std::vector<ExtractedBlock>& blocks The extracted blocks that were not yet written (appended to).
+     * @param NoiseCorpusWriter& writer The corpus writer to stream full batches into.
+     * @param std::unordered_map<uint64_t, uint32_t>& counts The count of every pattern in the binary (updated).
+     */
+    void extractObject(const ObjectFile& object, std::vector<ExtractedBlock>& blocks, NoiseCorpusWriter& writer, std::unordered_map<uint64_t, uint32_t>& counts) const {
+        if (object.getArch() != (arm64 ? Triple::aarch64 : Triple::x86_64)) return;
+
+        for (const SectionRef& section : object.sections()) {
+            if (!section.isText() || section.isVirtual()) continue;
+
+            Expected<StringRef> contents = section.getContents();
+
+            if (!contents) {
+                consumeError(contents.takeError());
+                continue;
+            }
+
+            extractSection(arrayRefFromStringRef(*contents), section.getAddress(), blocks, writer, counts);
+        }
+    }
+
+public:
+
+    /**
+     * Initialize the MC layer of the architecture.
+     *
+     * @param const std::string& platform The platform to extract noise for (`win`, `lin` or `mac`).
+     * @param const std::string& arch The architecture to extract noise for (`amd64` or `arm64`).
+     */
+    NoiseBlockExtractor(const std::string& platform, const std::string& arch) : platform(platform), arm64(arch == "arm64") {
+        Triple triple(arm64 ? "aarch64-unknown-unknown" : "x86_64-unknown-unknown");
+        std::string error;
+
+        const Target* target = TargetRegistry::lookupTarget(triple.str(), error);
+        if (!target) report_fatal_error(Twine("NoiseBlockExtractor could not find target: ") + error);
+
+        MCTargetOptions options;
+        MRI.reset(target->createMCRegInfo(triple.str()));
+        MAI.reset(target->createMCAsmInfo(*MRI, triple.str(), options));
+        STI.reset(target->createMCSubtargetInfo(triple.str(), "", arm64 ? "+all" : ""));
+        MII.reset(target->createMCInstrInfo());
+        context = std::make_unique<MCContext>(triple, MAI.get(), MRI.get(), STI.get());
+        disassembler.reset(target->createMCDisassembler(*STI, *context));
+
+        if (!disassembler) report_fatal_error(Twine("NoiseBlockExtractor could not create a disassembler for: ") + triple.str());
+
+        // Resolve the footprint bit of every register once (by the name the corpus format expects)
+        footprintBits.resize(MRI->getNumRegs(), NoiseCorpusFormat::BIT_OTHER);
+
+        for (unsigned reg = 1; reg < MRI->getNumRegs(); reg++) {
+            footprintBits[reg] = NoiseCorpusFormat::getFootprintBit(arm64, StringRef(MRI->getName(reg)).lower());
+        }
+    }
+
+    /**
+     * Check if a file (by its contents) is a binary of the platform.
+     *
+     * @param MemoryBufferRef buffer The (memory-mapped) file.
+     * @return bool Positive if the file should be extracted.
+     */
+    bool isPlatformBinary(MemoryBufferRef buffer) const {
+        switch (identify_magic(buffer.getBuffer())) {
+            case file_magic::pecoff_executable:
+                return platform == "win";
+            case file_magic::elf_executable:
+            case file_magic::elf_shared_object:
+            case file_magic::elf_relocatable:
+                return platform == "lin";
+            case file_magic::macho_executable:
+            case file_magic::macho_dynamically_linked_shared_lib:
+            case file_magic::macho_bundle:
+            case file_magic::macho_object:
+            case file_magic::macho_universal_binary:
+                return platform == "mac";
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Extract the blocks of a binary of the platform (of the objects of the architecture).
+     *
+     * @param MemoryBufferRef buffer The (memory-mapped) binary.
+     * @param NoiseCorpusWriter& writer The corpus writer to stream the blocks into.
+     * @param std::unordered_map<uint64_t, uint32_t>& counts The count of every pattern in the binary (updated).
+     * @return bool Positive if the binary could be parsed.
+     */
+    bool extract(MemoryBufferRef buffer, NoiseCorpusWriter& writer, std::unordered_map<uint64_t, uint32_t>& counts) const {
+        Expected<std::unique_ptr<Binary>> binary = createBinary(buffer);
+
+        if (!binary) {
+            consumeError(binary.takeError());
+            return false;
+        }
+
+        std::vector<ExtractedBlock> blocks;
+
+        if (auto* universal = dyn_cast<MachOUniversalBinary>(binary->get())) {
+            for (const MachOUniversalBinary::ObjectForArch& slice : universal->objects()) {
+                Expected<std::unique_ptr<MachOObjectFile>> object = slice.getAsObjectFile();
+
+                if (!object) {
+                    consumeError(object.takeError());
+                    continue;
+                }
+
+                extractObject(**object, blocks, writer, counts);
+            }
+        } else if (auto* object = dyn_cast<ObjectFile>(binary->get())) {
+            extractObject(*object, blocks, writer, counts);
+        }
+
+        writer.add(blocks);
+        return true;
+    }
+
+};
@@ -0,0 +1,484 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "NoiseCorpusWriter.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * An input file of the corpus, as recorded in the manifest.
+ */
+struct ManifestEntry {
+
+    /**
+     * The hash of the contents of the file (zero if the file is not a binary of the platform).
+     */
+    uint64_t contentHash = 0;
+
+    /**
+     * The size and the modification time (in nanoseconds since the epoch) of the file when it was hashed.
+     */
+    uint64_t size = 0;
+    int64_t modified = 0;
+
+    /**
+     * The source the file belongs to (e.g. the directory of an OS build it was harvested from).
+     */
+    std::string source;
+
+};
+
+/**
+ * The count of a pattern in a binary, as stored in a contribution.
+ */
+struct ContributionEntry {
+    uint64_t pattern;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ContributionEntry) == 16, "A contribution entry must not be padded.");
+
+/**
+ * The persisted state of a corpus, which makes re-harvesting incremental.
+ *
+ * The state directory (`<corpus>.state` by default) contains:
+ * - `manifest.tsv`, with the content hash, size, modification time and source of every input file.
+ * - `sketch.bin`, with the counters of the count-min sketch of all counted binaries.
+ * - `candidates.bin`, with the representative of every kept pattern.
+ * - `contributions/<content hash>.bin`, with the count of every pattern in a binary (sorted by pattern).
+ *
+ * Files with the same size & modification time as in the manifest are skipped without reading them.
+ * Binaries are counted once per distinct content (so copies of a binary in several places do not inflate
+ * the counts). The sketch is linear, so when no input file refers to a content anymore (the file was
+ * removed, changed, or its source was removed), its contribution is subtracted from the sketch exactly.
+ */
+class NoiseCorpusState {
+
+private:
+
+    /**
+     * The magic & the version of the persisted sketch and candidates.
+     */
+    static constexpr char SKETCH_MAGIC[4] = { 'D', 'N', 'S', '1' };
+    static constexpr char CANDIDATES_MAGIC[4] = { 'D', 'N', 'R', '1' };
+
+    /**
+     * The state directory.
+     */
+    std::string directory;
+
+    /**
+     * Guards all state below (files are recorded from every extractor thread).
+     */
+    std::mutex mutex;
+
+    /**
+     * The manifest (by absolute path).
+     */
+    std::map<std::string, ManifestEntry> manifest;
+
+    /**
+     * The amount of manifest entries per content hash, and the content hashes whose contribution is in the sketch.
+     */
+    std::unordered_map<uint64_t, unsigned> references;
+    std::set<uint64_t> counted;
+
+    /**
+     * Retrieve the path of a file in the state directory.
+     *
+     * @param const Twine& name The name of the file.
+     * @return std::string The path.
+     */
+    std::string getPath(const Twine& name) const {
+        SmallString<256> result(directory);
+        sys::path::append(result, name);
+        return std::string(result);
+    }
+
+    /**
+     * Retrieve the path of the contribution of a content hash.
+     *
+     * @param uint64_t contentHash The content hash.
+     * @return std::string The path.
+     */
+    std::string getContributionPath(uint64_t contentHash) const {
+        return getPath("contributions/" + utohexstr(contentHash, true, 16) + ".bin");
+    }
+
+    /**
+     * Drop a reference to a content hash (the caller holds the lock).
+     *
+     * @param uint64_t contentHash The content hash.
+     */
+    void dereference(uint64_t contentHash) {
+        if (contentHash == 0) return;
+
+        auto found = references.find(contentHash);
+        if (found != references.end() && --found->second == 0) references.erase(found);
+    }
+
+    /**
+     * Write a file in the state directory (through a temporary file, so that an interrupted run keeps the old file).
+     *
+     * @param const std::string& path The path of the file.
+     * @param StringRef contents The contents.
+     * @return std::error_code The error (if any).
+     */
+    static std::error_code writeFile(const std::string& path, StringRef contents) {
+        std::error_code error;
+
+        {
+            raw_fd_ostream stream(path + ".tmp", error, sys::fs::OF_None);
+            if (error) return error;
+
+            stream << contents;
+            stream.close();
+            if (stream.has_error()) return stream.error();
+        }
+
+        return sys::fs::rename(path + ".tmp", path);
+    }
+
+    /**
+     * Load the manifest.
+     *
+     * @return bool Positive if the manifest is valid (or does not exist).
+     */
+    bool loadManifest() {
+        ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(getPath("manifest.tsv"));
+        if (!file) return true;
+
+        SmallVector<StringRef, 0> lines;
+        (*file)->getBuffer().split(lines, '\n', -1, false);
+
+        for (StringRef line : lines) {
+            if (line.starts_with("#")) continue;
+
+            SmallVector<StringRef, 5> fields;
+            line.split(fields, '\t', 4);
+
+            ManifestEntry entry;
+            if (fields.size() != 5 || fields[0].getAsInteger(16, entry.contentHash) || fields[1].getAsInteger(10, entry.size) || fields[2].getAsInteger(10, entry.modified)) return false;
+
+            entry.source = fields[3].str();
+            manifest[fields[4].str()] = entry;
+
+            if (entry.contentHash) {
+                references[entry.contentHash]++;
+                counted.insert(entry.contentHash);
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Load the counters of the sketch.
+     *
+     * @param CountMinSketch& sketch The sketch to restore.
+     * @return bool Positive if the counters are valid (or do not exist).
+     */
+    bool loadSketch(CountMinSketch& sketch) {
+        ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(getPath("sketch.bin"), false, false);
+        if (!file) return manifest.empty();
+
+        StringRef contents = (*file)->getBuffer();
+        if (contents.size() < 8 || std::memcmp(contents.data(), SKETCH_MAGIC, 4) != 0 || (contents.size() - 8) % sizeof(uint32_t) != 0) return false;
+
+        std::vector<uint32_t> counters((contents.size() - 8) / sizeof(uint32_t));
+        std::memcpy(counters.data(), contents.data() + 8, counters.size() * sizeof(uint32_t));
+
+        if (!sketch.setCounters(counters.data(), counters.size())) {
+            errs() << "[!] Error: The state was created with --sketch-memory=" << ((counters.size() * sizeof(uint32_t)) >> 20) << ".\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Load the representatives of the kept patterns.
+     *
+     * @param NoiseCorpusWriter& writer The writer to add the representatives to.
+     * @return bool Positive if the representatives are valid (or do not exist).
+     */
+    bool loadCandidates(NoiseCorpusWriter& writer) {
+        ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(getPath("candidates.bin"), false, false);
+        if (!file) return true;
+
+        StringRef contents = (*file)->getBuffer();
+        if (contents.size() < 8 || std::memcmp(contents.data(), CANDIDATES_MAGIC, 4) != 0) return false;
+
+        // Every candidate is its pattern, footprint, amount of instructions & size, lengths and bytes
+        for (size_t offset = 8; offset < contents.size();) {
+            if (contents.size() - offset < 20) return false;
+
+            ExtractedBlock block;
+            uint16_t instructionCount, size;
+            std::memcpy(&block.pattern, contents.data() + offset, 8);
+            std::memcpy(&block.footprint, contents.data() + offset + 8, 8);
+            std::memcpy(&instructionCount, contents.data() + offset + 16, 2);
+            std::memcpy(&size, contents.data() + offset + 18, 2);
+            offset += 20;
+
+            if (contents.size() - offset < (size_t) instructionCount + size) return false;
+
+            block.lengths.assign(contents.bytes_begin() + offset, contents.bytes_begin() + offset + instructionCount);
+            block.bytes.assign(contents.bytes_begin() + offset + instructionCount, contents.bytes_begin() + offset + instructionCount + size);
+            offset += instructionCount + size;
+
+            writer.addCandidate(block);
+        }
+
+        return true;
+    }
+
+public:
+
+    /**
+     * Create the state of a corpus.
+     *
+     * @param const std::string& directory The state directory.
+     */
+    explicit NoiseCorpusState(const std::string& directory) : directory(directory) {}
+
+    /**
+     * Load the state (if any) into the writer.
+     *
+     * @param NoiseCorpusWriter& writer The writer to restore the sketch & kept patterns of.
+     * @return bool Positive if the state is valid (or does not exist yet).
+     */
+    bool load(NoiseCorpusWriter& writer) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!loadManifest() || !loadSketch(writer.getSketch()) || !loadCandidates(writer)) return false;
+
+        writer.refresh();
+        return true;
+    }
+
+    /**
+     * Save the state of the writer (and the manifest).
+     *
+     * @param NoiseCorpusWriter& writer The writer to save the sketch & kept patterns of.
+     * @return std::error_code The error (if any).
+     */
+    std::error_code save(NoiseCorpusWriter& writer) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::string manifestContents = "# content hash\tsize\tmodified\tsource\tpath\n";
+        raw_string_ostream manifestStream(manifestContents);
+
+        for (const auto& entry : manifest) {
+            manifestStream << format_hex_no_prefix(entry.second.contentHash, 16) << "\t" << entry.second.size << "\t" << entry.second.modified << "\t" << entry.second.source << "\t" << entry.first << "\n";
+        }
+
+        std::vector<uint32_t> counters = writer.getSketch().getCounters();
+        std::string sketchContents(SKETCH_MAGIC, 4);
+        sketchContents.append(4, '\0');
+        sketchContents.append(reinterpret_cast<const char*>(counters.data()), counters.size() * sizeof(uint32_t));
+
+        std::string candidatesContents(CANDIDATES_MAGIC, 4);
+        candidatesContents.append(4, '\0');
+
+        for (const ExtractedBlock& block : writer.getCandidates()) {
+            uint16_t instructionCount = block.lengths.size(), size = block.bytes.size();
+            candidatesContents.append(reinterpret_cast<const char*>(&block.pattern), 8);
+            candidatesContents.append(reinterpret_cast<const char*>(&block.footprint), 8);
+            candidatesContents.append(reinterpret_cast<const char*>(&instructionCount), 2);
+            candidatesContents.append(reinterpret_cast<const char*>(&size), 2);
+            candidatesContents.append(block.lengths.begin(), block.lengths.end());
+            candidatesContents.append(block.bytes.begin(), block.bytes.end());
+        }
+
+        if (std::error_code error = writeFile(getPath("sketch.bin"), sketchContents)) return error;
+        if (std::error_code error = writeFile(getPath("candidates.bin"), candidatesContents)) return error;
+
+        // The manifest is written last, so that it never refers to counts that were not saved
+        return writeFile(getPath("manifest.tsv"), manifestStream.str());
+    }
+
+    /**
+     * Create the state directory (if it does not exist yet).
+     *
+     * @return std::error_code The error (if any).
+     */
+    std::error_code create() {
+        return sys::fs::create_directories(getPath("contributions"));
+    }
+
+    /**
+     * Check if a file is unchanged since it was recorded (by its size & modification time).
+     *
+     * @param const std::string& path The absolute path of the file.
+     * @param uint64_t size The current size.
+     * @param int64_t modified The current modification time.
+     * @param const std::string& source The source of the current run (the file moves to it if unchanged).
+     * @return bool Positive if the file does not have to be read.
+     */
+    bool isUnchanged(const std::string& path, uint64_t size, int64_t modified, const std::string& source) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto found = manifest.find(path);
+        if (found == manifest.end() || found->second.size != size || found->second.modified != modified) return false;
+
+        found->second.source = source;
+        return true;
+    }
+
+    /**
+     * Record the (new) contents of a file.
+     *
+     * @param const std::string& path The absolute path of the file.
+     * @param const ManifestEntry& entry The content hash, size, modification time & source of the file.
+     * @return bool Positive if the contents have not been counted yet (the caller must extract & contribute them).
+     */
+    bool record(const std::string& path, const ManifestEntry& entry) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto found = manifest.find(path);
+        if (found != manifest.end()) dereference(found->second.contentHash);
+
+        manifest[path] = entry;
+        if (entry.contentHash == 0) return false;
+
+        references[entry.contentHash]++;
+
+        // Claim the contents (another thread may find a copy of the same binary at the same time)
+        return counted.insert(entry.contentHash).second;
+    }
+
+    /**
+     * Store the contribution of the contents of a binary.
+     *
+     * @param uint64_t contentHash The content hash.
+     * @param const std::unordered_map<uint64_t, uint32_t>& counts The count of every pattern in the binary.
+     * @return std::error_code The error (if any).
+     */
+    std::error_code contribute(uint64_t contentHash, const std::unordered_map<uint64_t, uint32_t>& counts) {
+        std::vector<ContributionEntry> entries;
+        entries.reserve(counts.size());
+
+        for (const auto& count : counts) {
+            entries.push_back(ContributionEntry { count.first, count.second, 0 });
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const ContributionEntry& a, const ContributionEntry& b) { return a.pattern < b.pattern; });
+
+        return writeFile(getContributionPath(contentHash), StringRef(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ContributionEntry)));
+    }
+
+    /**
+     * Remove the files of a source that are not in the given set of paths (or all files of the source).
+     *
+     * @param const std::string& source The source.
+     * @param const std::set<std::string>* existing The paths that still exist (or a null pointer to remove all).
+     * @return size_t The amount of removed files.
+     */
+    size_t removeSource(const std::string& source, const std::set<std::string>* existing) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t result = 0;
+
+        for (auto entry = manifest.begin(); entry != manifest.end();) {
+            if (entry->second.source != source || (existing && existing->count(entry->first))) {
+                entry++;
+                continue;
+            }
+
+            dereference(entry->second.contentHash);
+            entry = manifest.erase(entry);
+            result++;
+        }
+
+        return result;
+    }
+
+    /**
+     * Subtract the contributions of all contents that no file refers to anymore from the sketch.
+     *
+     * @param NoiseCorpusWriter& writer The writer to subtract the counts from.
+     * @return size_t The amount of subtracted contributions.
+     */
+    size_t subtractUnreferenced(NoiseCorpusWriter& writer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t result = 0;
+
+        for (auto contentHash = counted.begin(); contentHash != counted.end();) {
+            if (references.count(*contentHash)) {
+                contentHash++;
+                continue;
+            }
+
+            std::string path = getContributionPath(*contentHash);
+            ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(path, false, false);
+
+            if (file) {
+                StringRef contents = (*file)->getBuffer();
+
+                for (size_t offset = 0; offset + sizeof(ContributionEntry) <= contents.size(); offset += sizeof(ContributionEntry)) {
+                    ContributionEntry entry;
+                    std::memcpy(&entry, contents.data() + offset, sizeof(ContributionEntry));
+                    writer.subtract(entry.pattern, entry.count);
+                }
+            }
+
+            sys::fs::remove(path);
+            contentHash = counted.erase(contentHash);
+            result++;
+        }
+
+        return result;
+    }
+
+    /**
+     * Retrieve the amount of files in the manifest.
+     *
+     * @return size_t The amount of files.
+     */
+    size_t getFileCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return manifest.size();
+    }
+
+};
@@ -0,0 +1,412 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../../../../../transpilers/shared/helpers/NoiseCorpusFormat.cpp"
+#include "CountMinSketch.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A basic block harvested from a binary, ready to be written to the corpus.
+ */
+struct ExtractedBlock {
+
+    /**
+     * The length (in bytes) of every instruction in the block.
+     */
+    std::vector<uint8_t> lengths;
+
+    /**
+     * The encoded instructions.
+     */
+    std::vector<uint8_t> bytes;
+
+    /**
+     * The registers the block writes to (see `NoiseCorpusFormat::getFootprintBit`).
+     */
+    uint64_t footprint = 0;
+
+    /**
+     * The hash of the pattern of the block (its instructions with registers & immediates abstracted).
+     */
+    uint64_t pattern = 0;
+
+};
+
+/**
+ * Collects the blocks of all extractor threads and writes the most frequent ones as a compiled noise corpus.
+ *
+ * The output is the same format that `noise.py provide` writes (see `NoiseCorpusFormat`). Every block is
+ * counted by its pattern in a count-min sketch, and only the `capacity` patterns with the highest counts are
+ * kept (a top-K ranking, with the usable block with the lowest bytes as representative of each pattern). The
+ * memory use is therefore fixed, no matter how many blocks are scanned. The counts that are written are the
+ * final estimates of the sketch, and blocks are sorted within every bucket. With a single thread the corpus is
+ * reproducible; with several threads, the patterns near the bottom of the ranking (and the representative of a
+ * pattern that was evicted and seen again) can depend on the order in which the threads add blocks.
+ */
+class NoiseCorpusWriter {
+
+private:
+
+    /**
+     * A pattern in the ranking.
+     */
+    struct FrequentBlock {
+        ExtractedBlock block;
+        uint32_t count;
+    };
+
+    /**
+     * The counts of all patterns (shared by all threads without a lock).
+     */
+    CountMinSketch sketch;
+
+    /**
+     * The maximum amount of patterns that is kept.
+     */
+    size_t capacity;
+
+    /**
+     * Guards all state below (blocks are added from every extractor thread).
+     */
+    std::mutex mutex;
+
+    /**
+     * The kept patterns (by pattern hash), and their ranking by (last known) count, lowest first.
+     */
+    std::unordered_map<uint64_t, FrequentBlock> entries;
+    std::set<std::pair<uint32_t, uint64_t>> ranking;
+
+    /**
+     * The amount of received blocks, and the amount of buckets that were written.
+     */
+    std::atomic<uint64_t> received;
+    uint64_t bucketCount = 0;
+
+    /**
+     * Write the given object to the stream as is (the format is little endian, like AMD64 & ARM64 hosts).
+     *
+     * @param raw_ostream& stream The stream to write to.
+     * @param const T& value The object to write.
+     */
+    template <typename T> static void writeRaw(raw_ostream& stream, const T& value) {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    /**
+     * Pad the stream with zeroes up to the next 8-byte boundary.
+     *
+     * @param raw_ostream& stream The stream to pad.
+     * @param uint64_t& offset The current offset (updated to the padded offset).
+     */
+    static void writeAlignment(raw_ostream& stream, uint64_t& offset) {
+        while (offset % 8 != 0) {
+            stream << '\0';
+            offset++;
+        }
+    }
+
+    /**
+     * Check if a block can be used as noise (and thus represent its pattern in the corpus).
+     *
+     * @param const ExtractedBlock& block The block.
+     * @return bool Positive if the block fits the corpus format and only writes known registers.
+     */
+    static bool isUsable(const ExtractedBlock& block) {
+        if (block.lengths.empty() || block.lengths.size() > 0xFFFF || block.bytes.size() > 0xFFFF) return false;
+        return !(block.footprint & (1ULL << NoiseCorpusFormat::BIT_OTHER));
+    }
+
+public:
+
+    /**
+     * Create a writer with a fixed memory budget.
+     *
+     * @param uint64_t sketchMemory The memory (in bytes) of the count-min sketch.
+     * @param size_t capacity The maximum amount of patterns to keep.
+     */
+    NoiseCorpusWriter(uint64_t sketchMemory, size_t capacity) : sketch(sketchMemory), capacity(capacity), received(0) {}
+
+    /**
+     * Count the blocks of a single binary, and keep the ones whose pattern ranks in the top.
+     *
+     * @param std::vector<ExtractedBlock>& blocks The blocks to add (moved into the corpus).
+     */
+    void add(std::vector<ExtractedBlock>& blocks) {
+        std::vector<uint32_t> counts;
+        counts.reserve(blocks.size());
+
+        for (const ExtractedBlock& block : blocks) {
+            counts.push_back(sketch.add(block.pattern));
+        }
+
+        received += blocks.size();
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (size_t index = 0; index < blocks.size(); index++) {
+            ExtractedBlock& block = blocks[index];
+            auto entry = entries.find(block.pattern);
+
+            if (entry != entries.end()) {
+                ranking.erase(std::make_pair(entry->second.count, block.pattern));
+                entry->second.count = std::max(entry->second.count, counts[index]);
+                ranking.insert(std::make_pair(entry->second.count, block.pattern));
+
+                if (isUsable(block) && block.bytes < entry->second.block.bytes) entry->second.block = std::move(block);
+                continue;
+            }
+
+            if (!isUsable(block) || capacity == 0) continue;
+
+            // Replace the lowest ranked pattern, if this pattern is more frequent
+            if (entries.size() >= capacity) {
+                if (counts[index] <= ranking.begin()->first) continue;
+
+                entries.erase(ranking.begin()->second);
+                ranking.erase(ranking.begin());
+            }
+
+            ranking.insert(std::make_pair(counts[index], block.pattern));
+            entries[block.pattern] = FrequentBlock { std::move(block), counts[index] };
+        }
+
+        blocks.clear();
+    }
+
+    /**
+     * Add a pattern that was kept by an earlier run (its count is the estimate of the sketch).
+     *
+     * @param ExtractedBlock& block The representative of the pattern (moved into the corpus).
+     */
+    void addCandidate(ExtractedBlock& block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!isUsable(block) || entries.count(block.pattern)) return;
+
+        uint32_t count = sketch.estimate(block.pattern);
+        ranking.insert(std::make_pair(count, block.pattern));
+        entries[block.pattern] = FrequentBlock { std::move(block), count };
+    }
+
+    /**
+     * Retrieve the representatives of all kept patterns (e.g. to persist them).
+     *
+     * @return std::vector<ExtractedBlock> The representatives.
+     */
+    std::vector<ExtractedBlock> getCandidates() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<ExtractedBlock> result;
+
+        for (const auto& entry : entries) {
+            result.push_back(entry.second.block);
+        }
+
+        return result;
+    }
+
+    /**
+     * Subtract the counts of blocks that were added before (e.g. of a removed binary).
+     *
+     * @param uint64_t pattern The hash of the pattern.
+     * @param uint32_t count The count to subtract.
+     */
+    void subtract(uint64_t pattern, uint32_t count) {
+        sketch.subtract(pattern, count);
+    }
+
+    /**
+     * Re-rank the kept patterns by their current estimate, and drop the ones that are no longer seen.
+     */
+    void refresh() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ranking.clear();
+
+        for (auto entry = entries.begin(); entry != entries.end();) {
+            entry->second.count = sketch.estimate(entry->first);
+
+            if (entry->second.count == 0) {
+                entry = entries.erase(entry);
+                continue;
+            }
+
+            ranking.insert(std::make_pair(entry->second.count, entry->first));
+            entry++;
+        }
+
+        while (entries.size() > capacity) {
+            entries.erase(ranking.begin()->second);
+            ranking.erase(ranking.begin());
+        }
+    }
+
+    /**
+     * Retrieve the count-min sketch (e.g. to persist or restore its counters).
+     *
+     * @return CountMinSketch& The sketch.
+     */
+    CountMinSketch& getSketch() {
+        return sketch;
+    }
+
+    /**
+     * Retrieve the amount of blocks that were received.
+     *
+     * @return uint64_t The amount of (usable and unusable) blocks.
+     */
+    uint64_t getReceived() const {
+        return received;
+    }
+
+    /**
+     * Retrieve the amount of kept patterns.
+     *
+     * @return uint64_t The amount of blocks that will be written.
+     */
+    uint64_t getPatternCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    /**
+     * Retrieve the amount of buckets that were written.
+     *
+     * @return uint64_t The amount of buckets.
+     */
+    uint64_t getBucketCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bucketCount;
+    }
+
+    /**
+     * Retrieve the amount of memory that is used by the count-min sketch.
+     *
+     * @return uint64_t The size (in bytes).
+     */
+    uint64_t getSketchMemory() const {
+        return sketch.getMemory();
+    }
+
+    /**
+     * Write the corpus to the given path.
+     *
+     * @param StringRef path The path of the compiled corpus (e.g. `./ditto/scripts/noise/data/win-amd64.bin`).
+     * @return std::error_code The error (if any).
+     */
+    std::error_code write(StringRef path) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::error_code error;
+        raw_fd_ostream stream(path, error, sys::fs::OF_None);
+        if (error) return error;
+
+        // The kept patterns per bucket (amount of instructions & footprint), with their final count
+        std::map<std::pair<uint32_t, uint64_t>, std::vector<std::pair<const ExtractedBlock*, uint32_t>>> buckets;
+        uint64_t blockCount = 0;
+        uint64_t poolSize = 0;
+
+        for (const auto& entry : entries) {
+            const ExtractedBlock& block = entry.second.block;
+
+            // Block offsets in the byte pool are 32 bits
+            if (poolSize + block.lengths.size() + block.bytes.size() > UINT32_MAX) continue;
+
+            poolSize += block.lengths.size() + block.bytes.size();
+            buckets[std::make_pair((uint32_t) block.lengths.size(), block.footprint)].push_back(std::make_pair(&block, sketch.estimate(entry.first)));
+            blockCount++;
+        }
+
+        for (auto& bucket : buckets) {
+            std::sort(bucket.second.begin(), bucket.second.end(), [](const auto& a, const auto& b) { return a.first->bytes < b.first->bytes; });
+        }
+
+        bucketCount = buckets.size();
+
+        NoiseCorpusHeader header;
+        std::memcpy(header.magic, NoiseCorpusFormat::MAGIC, sizeof(header.magic));
+        header.version = NoiseCorpusFormat::VERSION;
+        header.bucketCount = buckets.size();
+        header.blockCount = blockCount;
+        header.bucketsOffset = sizeof(NoiseCorpusHeader);
+        header.blocksOffset = alignTo(header.bucketsOffset + buckets.size() * sizeof(NoiseCorpusBucket), 8);
+        header.bytesOffset = alignTo(header.blocksOffset + blockCount * sizeof(NoiseCorpusBlock), 8);
+        header.bytesSize = poolSize;
+
+        uint64_t offset = 0;
+        writeRaw(stream, header);
+        offset += sizeof(NoiseCorpusHeader);
+
+        uint32_t firstBlock = 0;
+        for (const auto& bucket : buckets) {
+            uint64_t count = 0;
+            for (const auto& block : bucket.second) count += block.second;
+
+            NoiseCorpusBucket entry = { bucket.first.second, count, bucket.first.first, firstBlock, (uint32_t) bucket.second.size(), 0 };
+            writeRaw(stream, entry);
+            offset += sizeof(NoiseCorpusBucket);
+            firstBlock += bucket.second.size();
+        }
+
+        writeAlignment(stream, offset);
+
+        uint32_t poolOffset = 0;
+        for (const auto& bucket : buckets) {
+            uint64_t cumulativeCount = 0;
+
+            for (const auto& block : bucket.second) {
+                cumulativeCount += block.second;
+
+                NoiseCorpusBlock entry = { cumulativeCount, poolOffset, (uint16_t) block.first->bytes.size(), (uint16_t) block.first->lengths.size() };
+                writeRaw(stream, entry);
+                offset += sizeof(NoiseCorpusBlock);
+                poolOffset += block.first->lengths.size() + block.first->bytes.size();
+            }
+        }
+
+        writeAlignment(stream, offset);
+
+        for (const auto& bucket : buckets) {
+            for (const auto& block : bucket.second) {
+                stream.write(reinterpret_cast<const char*>(block.first->lengths.data()), block.first->lengths.size());
+                stream.write(reinterpret_cast<const char*>(block.first->bytes.data()), block.first->bytes.size());
+            }
+        }
+
+        stream.close();
+        return stream.error();
+    }
+
+};
@@ -32,11 +32,11 @@ def main():
         ExtractAction(sys.argv[2], sys.argv[3], sys.argv[4]).run()
         StatusHelper.exit(StatusHelper.SUCCESS)
 
-    if arg_action == 'provide' and len(sys.argv) != 4:
-        StatusHelper.error('Usage: python noise.py extract <platform> <arch>')
+    if arg_action == 'provide' and len(sys.argv) not in [4, 5]:
+        StatusHelper.error('Usage: python noise.py provide <platform> <arch> [directory]')
         StatusHelper.fatal(StatusHelper.ERROR_INVALID_ARGUMENTS)
     elif arg_action == 'provide':
-        ProvideAction(sys.argv[2], sys.argv[3]).run()
+        ProvideAction(sys.argv[2], sys.argv[3], sys.argv[4] if len(sys.argv) == 5 else None).run()
         StatusHelper.exit(StatusHelper.SUCCESS)
 
     StatusHelper.exit(StatusHelper.ERROR_INVALID_ARGUMENTS)
@@ -13,23 +13,258 @@
 # include this same license and copyright notice.
 
 import os
+import re
 import sys
+import json
+import struct
+
+from helpers.StatusHelper import StatusHelper
+from helpers.FileHelper import FileHelper
 
 class ProvideAction:
-    """The ProvideAction class provides the commonly found patterns or basic-blocks of instructions to Dittobytes."""
+    """The ProvideAction class provides the commonly found patterns or basic-blocks of instructions to Dittobytes.
+
+    The extracted JSON is compiled into a binary corpus that the machine transpiler memory-maps without parsing.
+    The format (and the register footprints) must stay in sync with `ditto/transpilers/shared/helpers/NoiseCorpusFormat.cpp`.
+
+    Blocks are counted per pattern (the mnemonics & operand types, so registers & immediates are abstracted). Every
+    pattern is stored once, with its count, so that the machine transpiler can sample by real-world frequency.
+
+    """
+
+    MAGIC = b'DNC1'
+    VERSION = 2
+
+    BIT_FLAGS = {'amd64': 16, 'arm64': 32}
+    BIT_VECTOR = {'amd64': 17, 'arm64': 33}
+    BIT_OTHER = 63
 
-    def __init__(self, platform, arch):
+    AMD64_LEGACY = [
+        ['rax', 'eax', 'ax', 'al', 'ah'], ['rcx', 'ecx', 'cx', 'cl', 'ch'], ['rdx', 'edx', 'dx', 'dl', 'dh'], ['rbx', 'ebx', 'bx', 'bl', 'bh'],
+        ['rsp', 'esp', 'sp', 'spl'], ['rbp', 'ebp', 'bp', 'bpl'], ['rsi', 'esi', 'si', 'sil'], ['rdi', 'edi', 'di', 'dil']
+    ]
+
+    def __init__(self, platform, arch, directory=None):
         """Initiate the ProvideAction class.
 
         Args:
             platform (str): The platform to provide noise for.
             arch (str): The arch to provide noise for.
+            directory (str): The directory with the extracted JSON (and for the binary corpus), `../data` by default.
 
         """
 
-        pass
+        self.platform = platform
+        self.arch = arch
+
+        if not self.platform in ['win', 'lin', 'mac']:
+            StatusHelper.fatal(StatusHelper.ERROR_INVALID_PLATFORM)
+
+        if not self.arch in ['amd64', 'arm64']:
+            StatusHelper.fatal(StatusHelper.ERROR_INVALID_ARCH)
+
+        if directory is None:
+            directory = '{}/../data'.format(os.path.dirname(os.path.abspath(__file__)))
+
+        data_path = '{}/{}-{}'.format(directory, self.platform, self.arch)
+
+        self.input_path = data_path + '.json'
+        self.output_path = data_path + '.bin'
+
+        if not FileHelper.file_exists(self.input_path):
+            StatusHelper.fatal(StatusHelper.ERROR_INVALID_CORPUS, [self.input_path])
 
     def run(self):
-        """Start providing the noise."""
+        """Start providing the noise (compile the extracted JSON to the binary corpus)."""
+
+        StatusHelper.info('Compiling {}-{}.json'.format(self.platform, self.arch))
+
+        with open(self.input_path, 'r') as input_handle:
+            basic_blocks = json.load(input_handle)
+
+        patterns = {}
+
+        for basic_block in basic_blocks:
+            pattern = patterns.setdefault(self.__get_pattern(basic_block), [0, None])
+            pattern[0] += 1
+
+            # The representative of a pattern is its usable block with the lowest bytes (independent of the input order)
+            compiled = self.__compile_block(basic_block)
+
+            if compiled and (pattern[1] is None or compiled[1] < pattern[1][1]):
+                pattern[1] = compiled
+
+        buckets = {}
+        stored = 0
+
+        for count, compiled in patterns.values():
+            if not compiled:
+                continue
+
+            stored += 1
+            buckets.setdefault((len(compiled[0]), compiled[2]), []).append((count,) + compiled)
+
+        with open(self.output_path, 'wb') as output_handle:
+            output_handle.write(self.__serialize(buckets))
+
+        StatusHelper.info('Saved {} pattern(s) (of {} block(s)) in {} bucket(s) to {}-{}.bin'.format(stored, len(basic_blocks), len(buckets), self.platform, self.arch))
+        StatusHelper.info('Finished')
+
+    def __get_pattern(self, basic_block):
+        """Get the pattern of a basic block (its instructions with registers & immediates abstracted).
+
+        Args:
+            basic_block (list): The instructions of the basic block (as extracted).
+
+        Returns:
+            tuple: The mnemonic and the operand types of every instruction.
+
+        """
+
+        return tuple((instruction['mnemonic'], tuple(operand['type'] for operand in instruction['operands'])) for instruction in basic_block)
+
+    def __compile_block(self, basic_block):
+        """Compile a single basic block to its instruction lengths, bytes and register footprint.
+
+        Args:
+            basic_block (list): The instructions of the basic block (as extracted).
+
+        Returns:
+            bool or tuple: A tuple with the lengths, the bytes and the footprint, False if the block is not usable.
+
+        """
+
+        lengths = []
+        encoded = b''
+        footprint = 0
+
+        for index, instruction in enumerate(basic_block):
+            if not instruction.get('bytes') or instruction.get('regs_write') is None:
+                return False
+
+            instruction_bytes = bytes.fromhex(instruction['bytes'])
+            lengths.append(len(instruction_bytes))
+            encoded += instruction_bytes
+
+            is_terminator = index == len(basic_block) - 1
+            is_call_or_return = instruction['mnemonic'].split(' ')[-1].startswith(('call', 'ret'))
+
+            for register in instruction['regs_write']:
+                bit = self.__get_footprint_bit(register.lower())
+
+                # The return address that a terminating call or return pushes or pops
+                if self.arch == 'amd64' and bit == 4 and is_terminator and is_call_or_return:
+                    continue
+
+                if bit >= 0:
+                    footprint |= 1 << bit
+
+        if footprint & (1 << self.BIT_OTHER):
+            return False
+
+        if self.arch == 'arm64' and any(length != 4 for length in lengths):
+            return False
+
+        if len(lengths) > 0xFFFF or len(encoded) > 0xFFFF:
+            return False
+
+        return (lengths, encoded, footprint)
+
+    def __get_footprint_bit(self, name):
+        """Get the footprint bit of a register name (see `NoiseCorpusFormat::getFootprintBit`).
+
+        Args:
+            name (str): The lowercase name of the register.
+
+        Returns:
+            int: The footprint bit, or -1 if writes to the register are not part of the footprint.
+
+        """
+
+        if self.arch == 'amd64':
+            for bit, aliases in enumerate(self.AMD64_LEGACY):
+                if name in aliases:
+                    return bit
+
+            match = re.fullmatch(r'r(\d+)[dwb]?', name)
+            if match and 8 <= int(match.group(1)) <= 15:
+                return int(match.group(1))
+
+            if name in ['rflags', 'eflags', 'flags']:
+                return self.BIT_FLAGS['amd64']
+
+            if name in ['rip', 'eip', 'ip', 'ssp']:
+                return -1
+
+            if re.fullmatch(r'(xmm|ymm|zmm|k)\d+', name) or name == 'mxcsr':
+                return self.BIT_VECTOR['amd64']
+
+            return self.BIT_OTHER
+
+        if name in ['xzr', 'wzr', 'pc']:
+            return -1
+
+        if name in ['sp', 'wsp']:
+            return 31
+
+        if name == 'fp':
+            return 29
+
+        if name == 'lr':
+            return 30
+
+        if name == 'nzcv':
+            return self.BIT_FLAGS['arm64']
+
+        if name in ['fpcr', 'fpsr']:
+            return self.BIT_VECTOR['arm64']
+
+        match = re.fullmatch(r'[xw](\d+)', name)
+        if match and int(match.group(1)) <= 30:
+            return int(match.group(1))
+
+        if re.fullmatch(r'[vqdshbzp]\d+', name):
+            return self.BIT_VECTOR['arm64']
+
+        return self.BIT_OTHER
+
+    def __serialize(self, buckets):
+        """Serialize the buckets to the binary corpus format.
+
+        Args:
+            buckets (dict): The counted & compiled blocks per (instruction count, footprint).
+
+        Returns:
+            bytes: The binary corpus.
+
+        """
+
+        align = lambda offset: (offset + 7) & ~7
+
+        bucket_table = b''
+        block_table = b''
+        pool = b''
+        block_count = 0
+
+        for (instruction_count, footprint) in sorted(buckets.keys()):
+            blocks = sorted(buckets[(instruction_count, footprint)], key=lambda block: block[2])
+            bucket_table += struct.pack('<QQIIII', footprint, sum(block[0] for block in blocks), instruction_count, block_count, len(blocks), 0)
+            cumulative_count = 0
+
+            for count, lengths, encoded, _ in blocks:
+                cumulative_count += count
+                block_table += struct.pack('<QIHH', cumulative_count, len(pool), len(encoded), len(lengths))
+                pool += bytes(lengths) + encoded
+                block_count += 1
+
+        buckets_offset = 48
+        blocks_offset = align(buckets_offset + len(bucket_table))
+        bytes_offset = align(blocks_offset + len(block_table))
+
+        header = self.MAGIC + struct.pack('<IIIQQQQ', self.VERSION, len(buckets), block_count, buckets_offset, blocks_offset, bytes_offset, len(pool))
+
+        result = header + bucket_table
+        result += b'\x00' * (blocks_offset - len(result)) + block_table
+        result += b'\x00' * (bytes_offset - len(result)) + pool
 
-        pass
\ No newline at end of file
+        return result
@@ -21,6 +21,7 @@ from helpers.StatusHelper import StatusHelper
 from helpers.EnvironmentHelper import EnvironmentHelper
 
 from verifications.VerificationHexNotPresent import VerificationHexNotPresent
+from verifications.VerificationMaximumSize import VerificationMaximumSize
 from verifications.VerificationMinimumLevenshteinDistance import VerificationMinimumLevenshteinDistance
 from verifications.VerificationMetamorphicationsNotOriginal import VerificationMetamorphicationsNotOriginal
 from verifications.VerificationReturns import VerificationReturns
@@ -207,6 +208,7 @@ class VerificationHelper:
 
         available_verifications = {
             'hex_not_present': VerificationHexNotPresent(),
+            'maximum_size': VerificationMaximumSize(),
             'metamorphications_not_original': VerificationMetamorphicationsNotOriginal(),
             'minimum_levenshtein_distance': VerificationMinimumLevenshteinDistance(),
             'returns': VerificationReturns(),
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+
+# -*- coding: utf-8 -*-
+
+# GNU General Public License, version 2.0.
+#
+# Copyright (c) 2025 Tijme Gommers (@tijme).
+#
+# This source code file is part of Dittobytes. Dittobytes is 
+# licensed under GNU General Public License, version 2.0, and 
+# you are free to use, modify, and distribute this file under 
+# its terms. However, any modified versions of this file must 
+# include this same license and copyright notice.
+
+from helpers.FileHelper import FileHelper
+
+class VerificationMaximumSize:
+    """Checks whether the given shellcode is not larger than the given amount of bytes."""
+
+    def requires_supported_os_and_arch(self):
+        """Whether this verification requires the os & arch of the shellcode to be executable in this runtime.
+
+        Returns:
+            bool: Positive if required.
+
+        """
+
+        return False
+
+    def verify(self, feature_test_specification):
+        """Checks whether the given shellcode is not larger than the given amount of bytes.
+
+        Args:
+            feature_test_specification (dict): A dict containing all test details.
+
+        Returns:
+            bool: Positive if the verification was successful.
+
+        """
+
+        shellcode = FileHelper.read_file(feature_test_specification['raw_file_path'], 'rb')
+        maximum_size = int(feature_test_specification['test_arguments'][0])
+
+        if len(shellcode) > maximum_size:
+            print('      Size of `{}-{}` shellcode with `{}` metamorphication is {} byte(s), which exceeds {} byte(s): `{}`.'.format(
+                feature_test_specification['compiled_for_os'],
+                feature_test_specification['compiled_for_arch'],
+                feature_test_specification['metamorphication'],
+                len(shellcode),
+                maximum_size,
+                feature_test_specification['raw_file_path']
+            ))
+
+            return False
+
+        return True
@@ -0,0 +1,79 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * Repeat a statement 64 times (to make the unreachable function much larger than the reachable code).
+ */
+#define REPEAT_2(statement) statement statement
+#define REPEAT_8(statement) REPEAT_2(REPEAT_2(REPEAT_2(statement)))
+#define REPEAT_64(statement) REPEAT_8(REPEAT_8(statement))
+
+/**
+ * A function that is declared, but never defined (linking fails if it is still referenced).
+ *
+ * @return uint8_t Never returns.
+ */
+uint8_t undefined();
+
+/**
+ * Get `5` (only reachable through a function pointer).
+ *
+ * @return uint8_t The result.
+ */
+uint8_t five();
+
+/**
+ * Call a function that does not exist, after mixing in a marker constant (never called, so it must be stripped).
+ *
+ * @return uint8_t Never returns.
+ */
+uint8_t unreachable();
+
+/**
+ * Return a deterministic uint8_t, while unreachable functions are stripped.
+ *
+ *            OS     Arch     Metamorphication        Test                              Argument(s)                      Description
+ * @verify    all    all      transpiled_1            minimum_levenshtein_distance      transpiled_2,15                  There must be a minimum % change per compile.
+ * @verify    all    all      all                     forensically_clean                None                             All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                     returns                           uint8_t,5                        Must be the case without metamorphications.
+ * @verify    all    all      original                maximum_size                      1024                             Must be the case if `unreachable` (over 1 KiB) is stripped.
+ */
+uint8_t EntryFunction() {
+    uint8_t (* volatile function)() = five;
+    return function();
+}
+
+/**
+ * Get `5` (only reachable through a function pointer).
+ *
+ * @return uint8_t The result.
+ */
+uint8_t five() {
+    return 5;
+}
+
+/**
+ * Call a function that does not exist, after mixing in a marker constant (never called, so it must be stripped).
+ *
+ * @return uint8_t Never returns.
+ */
+uint8_t unreachable() {
+    volatile uint64_t marker = 0;
+
+    // Over 1 KiB of code on any architecture (in the original compile)
+    REPEAT_64(marker = (marker * 0x5851F42D4C957F2DULL) ^ 0xD1770B7E12345678ULL;)
+
+    return undefined() ^ (uint8_t) marker;
+}
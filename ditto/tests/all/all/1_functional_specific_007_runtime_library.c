@@ -0,0 +1,59 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Routines of the C library, which are provided by the runtime library (`libditto-rt`).
+ */
+size_t strlen(const char* string);
+int strcmp(const char* a, const char* b);
+int strncmp(const char* a, const char* b, size_t n);
+char* strncpy(char* destination, const char* source, size_t n);
+char* strchr(const char* string, int character);
+int memcmp(const void* a, const void* b, size_t n);
+void* memmove(void* destination, const void* source, size_t n);
+
+/**
+ * Return a deterministic uint8_t, computed with routines of the runtime library.
+ *
+ *            OS     Arch     Metamorphication        Test                              Argument(s)                      Description
+ * @verify    all    all      transpiled_1            minimum_levenshtein_distance      transpiled_2,15                  There must be a minimum % change per compile.
+ * @verify    all    all      all                     forensically_clean                None                             All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                     returns                           uint8_t,22                       Must be the case without metamorphications.
+ */
+uint8_t EntryFunction() {
+    char greeting[] = "Hello, Dittobytes!";
+    char copy[32];
+    uint8_t result = 0;
+
+    // 18 characters
+    result += strlen(greeting);
+
+    // Equal after copying (and padding the remainder with null terminators)
+    strncpy(copy, greeting, sizeof(copy));
+    result += strcmp(copy, greeting) == 0;
+
+    // Overlapping moves forwards (a call) and backwards (an intrinsic)
+    memmove(copy + 2, copy, 5);
+    result += memcmp(copy + 2, "Hello", 5) == 0;
+
+    __builtin_memmove(copy, copy + 2, 5);
+    result += strncmp(copy, "Hello", 5) == 0;
+
+    // The `D` of `HellolloDittobytes!`
+    result += (strchr(copy, 'D') - copy) == 7;
+
+    return result;
+}
@@ -0,0 +1,86 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * A struct that is too large to copy with unrolled moves (more than 64 bytes).
+ */
+struct Large {
+    uint8_t bytes[200];
+};
+
+/**
+ * Sum all bytes of a struct that is passed by value (which code generation copies).
+ *
+ * @param struct Large large The struct (a copy, of which the first byte is overwritten).
+ * @return uint8_t The sum of all bytes.
+ */
+uint8_t sum(struct Large large);
+
+/**
+ * Create a struct with an aggregate initializer, and return it by value.
+ *
+ * @param uint8_t seed The multiplier of every third byte.
+ * @return struct Large The struct.
+ */
+struct Large make(uint8_t seed);
+
+/**
+ * Return a deterministic uint8_t, computed with large structs that are copied, initialized and returned.
+ *
+ *            OS     Arch     Metamorphication        Test                              Argument(s)                      Description
+ * @verify    all    all      transpiled_1            minimum_levenshtein_distance      transpiled_2,15                  There must be a minimum % change per compile.
+ * @verify    all    all      all                     forensically_clean                None                             All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                     returns                           uint8_t,225                      Must be the case without metamorphications.
+ */
+uint8_t EntryFunction() {
+    struct Large large = make(3);
+    uint8_t result = sum(large);
+
+    // The first byte is unchanged, as `sum` received a copy
+    return result + large.bytes[0] + large.bytes[199];
+}
+
+/**
+ * Sum all bytes of a struct that is passed by value (which code generation copies).
+ *
+ * @param struct Large large The struct (a copy, of which the first byte is overwritten).
+ * @return uint8_t The sum of all bytes.
+ */
+uint8_t sum(struct Large large) {
+    uint8_t result = 0;
+
+    for (int i = 0; i < (int) sizeof(large.bytes); i++) {
+        result += large.bytes[i];
+    }
+
+    large.bytes[0] = 0xFF;
+    return result;
+}
+
+/**
+ * Create a struct with an aggregate initializer, and return it by value.
+ *
+ * @param uint8_t seed The multiplier of every third byte.
+ * @return struct Large The struct.
+ */
+struct Large make(uint8_t seed) {
+    struct Large large = { { 1, 2, 3, 4 } };
+
+    for (int i = 4; i < (int) sizeof(large.bytes); i += 3) {
+        large.bytes[i] = (uint8_t) (i * seed);
+    }
+
+    return large;
+}
@@ -0,0 +1,44 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Return a deterministic uint8_t, computed with a `memcpy` and a `memset` of a length that is only known at runtime.
+ *
+ *            OS     Arch     Metamorphication        Test                              Argument(s)                      Description
+ * @verify    all    all      transpiled_1            minimum_levenshtein_distance      transpiled_2,15                  There must be a minimum % change per compile.
+ * @verify    all    all      all                     forensically_clean                None                             All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                     returns                           uint8_t,47                       Must be the case without metamorphications.
+ */
+uint8_t EntryFunction() {
+    volatile size_t length = 13;
+    uint8_t source[32];
+    uint8_t destination[32];
+    uint8_t result = 0;
+
+    for (size_t i = 0; i < sizeof(source); i++) {
+        source[i] = (uint8_t) (i + 1);
+        destination[i] = 0;
+    }
+
+    // Expanded to loops, as the lengths are not constant
+    __builtin_memcpy(destination, source, length);
+    __builtin_memset(destination + length, 0xAB, length - 3);
+
+    for (size_t i = 0; i < sizeof(destination); i++) {
+        result += destination[i] ^ (uint8_t) i;
+    }
+
+    return result;
+}
@@ -0,0 +1,34 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication          Test                              Argument(s)                   Description
+ * @verify    all    amd64    transpiled_1              hex_not_present                   78563412                      Substitutions must survive the cleanup (no `mov [rbp+var], 0x12345678`).
+ * @verify    all    all      transpiled_1              minimum_levenshtein_distance      transpiled_2,10               There must be a minimum % change per compile.
+ * @verify    all    all      all                       forensically_clean                None                          All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                       returns                           uint32_t,305419896            Must be the case with and without removing redundant instructions.
+ */
+uint32_t EntryFunction() {
+    uint32_t value = 0x12345678;
+    uint32_t result = 0;
+
+    for (uint32_t i = 0; i < 3; i++) {
+        result ^= value;
+    }
+
+    return result;
+}
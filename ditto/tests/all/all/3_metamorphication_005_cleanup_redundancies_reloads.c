@@ -0,0 +1,52 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * Many values that are live at once, causing spills that are (redundantly) reloaded right after being stored.
+ *
+ * The cleanup build of this test runs with `-verify-machineinstrs`, which fails on stale kill flags of removed reloads.
+ */
+uint32_t mix(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint32_t e = a * 3 + b;
+    uint32_t f = b ^ c;
+    uint32_t g = c + d * 5;
+    uint32_t h = d - a;
+
+    for (uint32_t i = 0; i < 4; i++) {
+        e += f;
+        f ^= g;
+        g += h;
+        h ^= e;
+    }
+
+    return e + f + g + h + a + b + c + d;
+}
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication          Test                              Argument(s)                   Description
+ * @verify    all    all      all                       forensically_clean                None                          All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                       returns                           uint32_t,14208                Must be the case with and without removing redundant reloads.
+ */
+uint32_t EntryFunction() {
+    uint32_t result = 0;
+
+    for (uint32_t i = 0; i < 3; i++) {
+        result += mix(i, result, i * 7, result ^ i);
+    }
+
+    return result;
+}
@@ -0,0 +1,36 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication                  Test                              Argument(s)                   Description
+ * @verify    all    all      randomize_instruction_schedule    minimum_levenshtein_distance      original,1                    Independent instructions must be reordered.
+ * @verify    all    all      transpiled_1                      minimum_levenshtein_distance      transpiled_2,10               There must be a minimum % change per compile.
+ * @verify    all    all      all                               forensically_clean                None                          All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                               returns                           uint32_t,66                   Must be the case in any (dependency preserving) order.
+ */
+uint32_t EntryFunction() {
+    uint32_t a = 3;
+    uint32_t b = 5;
+    uint32_t c = 7;
+    uint32_t d = 11;
+
+    uint32_t x = a * b;
+    uint32_t y = c * d;
+    uint32_t z = a + b + c + d;
+
+    return x + y - z;
+}
@@ -0,0 +1,39 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication          Test                              Argument(s)                   Description
+ * @verify    all    all      randomize_block_layout    minimum_levenshtein_distance      original,1                    Blocks must be reordered.
+ * @verify    all    all      transpiled_1              minimum_levenshtein_distance      transpiled_2,10               There must be a minimum % change per compile.
+ * @verify    all    all      all                       forensically_clean                None                          All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                       returns                           uint32_t,17                   Must be the case in any (control flow preserving) block layout.
+ */
+uint32_t EntryFunction() {
+    uint32_t result = 0;
+
+    for (uint32_t i = 0; i < 8; i++) {
+        if (i % 3 == 0) {
+            result += i;
+        } else if (i % 3 == 1) {
+            result += 2;
+        } else {
+            result += 1;
+        }
+    }
+
+    return result;
+}
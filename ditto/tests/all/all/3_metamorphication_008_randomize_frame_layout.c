@@ -0,0 +1,33 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication          Test                              Argument(s)                   Description
+ * @verify    all    all      randomize_frame_layout    minimum_levenshtein_distance      original,1                    Stack objects must be reordered.
+ * @verify    all    all      transpiled_1              minimum_levenshtein_distance      transpiled_2,10               There must be a minimum % change per compile.
+ * @verify    all    all      all                       forensically_clean                None                          All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                       returns                           uint64_t,1234                 Must be the case in any stack frame layout.
+ */
+uint64_t EntryFunction() {
+    uint8_t a = 1;
+    uint16_t b = 20;
+    uint32_t c = 200;
+    uint64_t d = 1000;
+    uint8_t e[3] = { 4, 5, 4 };
+
+    return a + b + c + d + e[0] + e[1] + e[2];
+}
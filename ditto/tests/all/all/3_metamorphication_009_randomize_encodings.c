@@ -0,0 +1,32 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication          Test                              Argument(s)                   Description
+ * @verify    all    amd64    transpiled_1              minimum_levenshtein_distance      transpiled_2,5                There must be a minimum % change per compile.
+ * @verify    all    all      all                       forensically_clean                None                          All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                       returns                           uint32_t,46                   Must be the case with any encoding.
+ */
+uint32_t EntryFunction() {
+    volatile uint32_t a = 12;
+    volatile uint32_t b = 34;
+    uint32_t c = a + b;
+    uint32_t d = c - a;
+    uint32_t e = (d & c) | (a ^ b);
+
+    return (e < c) ? c + d + a : e;
+}
@@ -0,0 +1,33 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication          Test                              Argument(s)                   Description
+ * @verify    all    all      transpiled_1              minimum_levenshtein_distance      transpiled_2,5                There must be a minimum % change per compile.
+ * @verify    all    all      all                       forensically_clean                None                          All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                       returns                           int32_t,-12                   Must be the case with any arithmetic identity.
+ */
+int32_t EntryFunction() {
+    int32_t result = 0;
+
+    for (int32_t i = 3; i != 0; i--) {
+        result += i - 7;
+        if (result == 0) result = 100;
+    }
+
+    return result + 3;
+}
@@ -0,0 +1,54 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+
+#include <stdint.h>
+
+/**
+ * Classify a value, using early returns (every return block is an insertion point for noise).
+ * 
+ * @param int32_t value The value to classify.
+ * @return int32_t The class of the value.
+ */
+int32_t Classify(int32_t value);
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication          Test                              Argument(s)                   Description
+ * @verify    all    all      insert_semantic_noise     minimum_levenshtein_distance      original,5                    Noise (of the fixture corpus in `ditto/scripts/tests/data/noise`) must be inserted.
+ * @verify    all    all      all                       forensically_clean                None                          All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    all      all                       returns                           int32_t,16                    Must be the case with any semantic noise.
+ */
+int32_t EntryFunction() {
+    int32_t result = 0;
+
+    for (int32_t i = -3; i < 15; i++) {
+        result += Classify(i);
+    }
+
+    return result;
+}
+
+/**
+ * Classify a value, using early returns (every return block is an insertion point for noise).
+ * 
+ * @param int32_t value The value to classify.
+ * @return int32_t The class of the value.
+ */
+int32_t Classify(int32_t value) {
+    if (value < 0) return -1;
+    if (value == 0) return 0;
+    if (value < 10) return 1;
+
+    return 2;
+}
@@ -0,0 +1,29 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+#include <stdint.h>
+
+/**
+ * The main function of the code to test.
+ * 
+ *            OS     Arch     Metamorphication                Test                              Argument(s)                           Description
+ * @verify    all    arm64    transpiled_1                    minimum_levenshtein_distance      transpiled_2,20                       There must be a minimum % change per compile.
+ * @verify    all    arm64    all                             forensically_clean                None                                  All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    all    arm64    all                             returns                           uint64_t,1234774353122090735,raw     Must be the case with any materialization sequence.
+ */
+uint64_t EntryFunction() {
+    volatile uint32_t small = 0x12345678;               // `movz` + `movk` (or `movn` + `movk`)
+    volatile uint64_t large = 0x1122334455667788ULL;    // `movz` + 3x `movk` (in any order)
+    volatile uint64_t pattern = 0x0000FFFF0000FFFFULL;  // `orr` of a logical immediate
+
+    return (large ^ pattern) + small;
+}
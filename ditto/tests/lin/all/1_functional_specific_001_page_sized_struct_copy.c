@@ -0,0 +1,48 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is 
+ * licensed under GNU General Public License, version 2.0, and 
+ * you are free to use, modify, and distribute this file under 
+ * its terms. However, any modified versions of this file must 
+ * include this same license and copyright notice.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A struct of 4 KiB (the stack frame that holds two of them would require stack probes on Windows).
+ */
+struct Page {
+    uint8_t bytes[4096];
+};
+
+/**
+ * Return a deterministic uint8_t, computed with a copy of a 4 KiB struct.
+ *
+ *            OS     Arch     Metamorphication        Test                              Argument(s)                      Description
+ * @verify    lin    all      transpiled_1            minimum_levenshtein_distance      transpiled_2,15                  There must be a minimum % change per compile.
+ * @verify    lin    all      all                     forensically_clean                None                             All compiled versions must have the minimum amount of potential forensic traces.
+ * @verify    lin    all      all                     returns                           uint8_t,141                      Must be the case without metamorphications.
+ */
+uint8_t EntryFunction() {
+    struct Page original;
+    uint8_t result = 0;
+
+    for (size_t i = 0; i < sizeof(original.bytes); i++) {
+        original.bytes[i] = (uint8_t) (i * 7 + 3);
+    }
+
+    // Copied by a single `memcpy` of 4096 bytes
+    struct Page copy = original;
+    original.bytes[0] = 0;
+
+    for (size_t i = 0; i < sizeof(copy.bytes); i += 3) {
+        result += copy.bytes[i] ^ (uint8_t) (i >> 4);
+    }
+
+    return result + copy.bytes[0] + copy.bytes[4095];
+}
@@ -34,7 +34,9 @@
  */
 #include "modules/expand_memcpy_calls/ExpandMemcpyCallsModule.cpp"
 #include "modules/expand_memset_calls/ExpandMemsetCallsModule.cpp"
+#include "modules/link_runtime_library/LinkRuntimeLibraryModule.cpp"
 #include "modules/move_globals_to_stack/MoveGlobalsToStackModule.cpp"
+#include "modules/strip_unreachable_functions/StripUnreachableFunctionsModule.cpp"
 
 /**
  * Namespace(s) to use
@@ -89,7 +91,13 @@ struct IntermediateTranspiler : PassInfoMixin<IntermediateTranspiler> {
 
         bool modified = false;
 
-        // Module 1: Move global variables to the stack
+        // Module 1: Link the routines of the runtime library that are used (before stripping what is unreachable)
+        modified = LinkRuntimeLibraryModule().run(M, MAM) || modified;
+
+        // Module 2: Strip functions & global variables that are unreachable from the entry function
+        modified = StripUnreachableFunctionsModule().run(M, MAM) || modified;
+
+        // Module 3: Move global variables to the stack
         modified = MoveGlobalsToStackModule().run(M, MAM) || modified;
 
         return modified ? PreservedAnalyses::none() : PreservedAnalyses::all();
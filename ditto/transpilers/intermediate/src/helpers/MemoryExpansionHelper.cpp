@@ -0,0 +1,139 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Alignment.h"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * Emits the chunks of an expanded memory intrinsic (e.g. `memcpy` or `memset`).
+ *
+ * Chunks are at most 8 bytes wide, so they fit a general purpose register on every target (vector chunks would
+ * need a constant pool for splatted values, which raw shellcode cannot refer to). Constant lengths up to the loop
+ * threshold are emitted as a straight sequence of chunks (e.g. 8, 8, 4, 2, 1 bytes), longer and variable lengths
+ * as a loop over 8-byte chunks followed by the tail.
+ */
+class MemoryExpansionHelper {
+
+public:
+
+    /**
+     * The widest chunk (in bytes).
+     */
+    static constexpr uint64_t MAXIMUM_CHUNK_SIZE = 8;
+
+    /**
+     * Constant lengths (in bytes) above this threshold are expanded to a loop.
+     */
+    static constexpr uint64_t LOOP_THRESHOLD = 128;
+
+    /**
+     * Emits a single chunk, given the builder, the (i64) byte offset, the alignment the offset is known to have,
+     * and the size (1, 2, 4 or 8 bytes) of the chunk.
+     */
+    using ChunkEmitter = function_ref<void(IRBuilder<>&, Value*, Align, uint64_t)>;
+
+    /**
+     * Expand a memory intrinsic of a constant length (in front of the intrinsic).
+     *
+     * @param Instruction* I The memory intrinsic to expand.
+     * @param uint64_t length The amount of bytes.
+     * @param ChunkEmitter emit The emitter of a single chunk.
+     */
+    static void expandConstant(Instruction* I, uint64_t length, ChunkEmitter emit) {
+        uint64_t offset = 0;
+
+        if (length > LOOP_THRESHOLD) {
+            IRBuilder<> IRB(I);
+            offset = length - (length % MAXIMUM_CHUNK_SIZE);
+            emitLoop(I, IRB.getInt64(0), IRB.getInt64(offset / MAXIMUM_CHUNK_SIZE), MAXIMUM_CHUNK_SIZE, emit);
+        }
+
+        IRBuilder<> IRB(I);
+
+        for (uint64_t size = MAXIMUM_CHUNK_SIZE; size > 0; size /= 2) {
+            for (; length - offset >= size; offset += size) {
+                emit(IRB, IRB.getInt64(offset), commonAlignment(Align(MAXIMUM_CHUNK_SIZE), offset), size);
+            }
+        }
+    }
+
+    /**
+     * Expand a memory intrinsic of a variable length (as loops in front of the intrinsic).
+     *
+     * @param Instruction* I The memory intrinsic to expand.
+     * @param Value* length The amount of bytes (an integer of any width).
+     * @param ChunkEmitter emit The emitter of a single chunk.
+     */
+    static void expandVariable(Instruction* I, Value* length, ChunkEmitter emit) {
+        IRBuilder<> IRB(I);
+
+        Value* bytes = IRB.CreateZExtOrTrunc(length, IRB.getInt64Ty());
+        Value* chunks = IRB.CreateLShr(bytes, Log2_64(MAXIMUM_CHUNK_SIZE));
+        Value* tail = IRB.CreateShl(chunks, Log2_64(MAXIMUM_CHUNK_SIZE));
+
+        emitLoop(I, IRB.getInt64(0), chunks, MAXIMUM_CHUNK_SIZE, emit);
+
+        IRB.SetInsertPoint(I);
+        emitLoop(I, tail, IRB.CreateSub(bytes, tail), 1, emit);
+    }
+
+private:
+
+    /**
+     * Emit a loop over `count` chunks of `size` bytes, starting at byte offset `base` (in front of an instruction).
+     *
+     * The block of the instruction is split, so that the loop runs in between. The base must be a multiple of the size.
+     *
+     * @param Instruction* I The instruction to emit the loop in front of.
+     * @param Value* base The (i64) byte offset of the first chunk.
+     * @param Value* count The (i64) amount of chunks.
+     * @param uint64_t size The size of every chunk.
+     * @param ChunkEmitter emit The emitter of a single chunk.
+     */
+    static void emitLoop(Instruction* I, Value* base, Value* count, uint64_t size, ChunkEmitter emit) {
+        BasicBlock* preheader = I->getParent();
+        BasicBlock* exit = preheader->splitBasicBlock(I, "expansion.exit");
+        BasicBlock* loop = BasicBlock::Create(I->getContext(), "expansion.loop", preheader->getParent(), exit);
+
+        // Skip the loop if there are no chunks at all
+        preheader->getTerminator()->eraseFromParent();
+        IRBuilder<> IRB(preheader);
+        IRB.CreateCondBr(IRB.CreateICmpEQ(count, IRB.getInt64(0)), exit, loop);
+
+        IRB.SetInsertPoint(loop);
+        PHINode* index = IRB.CreatePHI(IRB.getInt64Ty(), 2, "expansion.index");
+        index->addIncoming(IRB.getInt64(0), preheader);
+
+        Value* offset = IRB.CreateAdd(base, IRB.CreateMul(index, IRB.getInt64(size)));
+        emit(IRB, offset, Align(size), size);
+
+        Value* next = IRB.CreateAdd(index, IRB.getInt64(1));
+        index->addIncoming(next, loop);
+        IRB.CreateCondBr(IRB.CreateICmpULT(next, count), loop, exit);
+    }
+
+};
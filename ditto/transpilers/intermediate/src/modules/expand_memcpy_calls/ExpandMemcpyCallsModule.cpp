@@ -25,10 +25,16 @@
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Transforms/IPO/GlobalOpt.h"
 
+/**
+ * Regular includes
+ */
+#include "../../helpers/MemoryExpansionHelper.cpp"
+
 /**
  * Namespace(s) to use
  */
@@ -37,6 +43,9 @@ using namespace llvm;
 
 /**
  * A class to expand `memcpy` calls to manual copies.
+ *
+ * Copies are done in chunks of up to 8 bytes (see `MemoryExpansionHelper`). Long and variable lengths are copied
+ * in a loop, so that no `memcpy` implementation is needed (which position independent code does not have).
  */
 class ExpandMemcpyCallsModule {
 
@@ -69,49 +78,45 @@ public:
         // Ensure module is enabled
         if (!moduleIsEnabled()) return false;
         
-        SmallVector<CallInst *, 8> MemCpyCalls;
+        SmallVector<MemCpyInst *, 8> MemCpyCalls;
 
         // Inform user that we are running this module
         dbgs() << "        ↳ Running ExpandMemcpyCalls module.\n";
 
         for (auto &BB : F) {
             for (auto &I : BB) {
-                if (auto *CI = dyn_cast<CallInst>(&I)) {
-                    if (auto *F = CI->getCalledFunction()) {
-                        if (F->getName().starts_with("llvm.memcpy")) {
-                            MemCpyCalls.push_back(CI);
-                        }
-                    }
+                if (auto *MCI = dyn_cast<MemCpyInst>(&I)) {
+                    MemCpyCalls.push_back(MCI);
                 }
             }
         }
 
-        for (auto *CI : MemCpyCalls) {
+        for (auto *MCI : MemCpyCalls) {
             // Inform user that we encountered a `memcpy` call
             dbgs() << "          ↳ Expanding a `memcpy` call.\n";
 
-            auto *Dst = CI->getArgOperand(0);
-            auto *Src = CI->getArgOperand(1);
-            auto *Len = CI->getArgOperand(2);
-            auto *IsVolatile = CI->getArgOperand(3);
-
-            if (auto *ConstLen = dyn_cast<ConstantInt>(Len)) {
-                uint64_t Size = ConstLen->getZExtValue();
-                IRBuilder<> IRB(CI);
-
-                for (uint64_t i = 0; i < Size; ++i) {
-                    Value *Offset = IRB.getInt64(i);
-                    Value *SrcGEP = IRB.CreateInBoundsGEP(IRB.getInt8Ty(), Src, Offset);
-                    Value *DstGEP = IRB.CreateInBoundsGEP(IRB.getInt8Ty(), Dst, Offset);
-                    LoadInst *Load = IRB.CreateLoad(IRB.getInt8Ty(), SrcGEP);
-                    Load->setVolatile(cast<ConstantInt>(IsVolatile)->isOne());
-                    StoreInst *Store = IRB.CreateStore(Load, DstGEP);
-                    Store->setVolatile(cast<ConstantInt>(IsVolatile)->isOne());
-                }
-
-                CI->eraseFromParent();
-                modified = true;
+            auto *Dst = MCI->getRawDest();
+            auto *Src = MCI->getRawSource();
+            Align DstAlign = MCI->getDestAlign().valueOrOne();
+            Align SrcAlign = MCI->getSourceAlign().valueOrOne();
+            bool IsVolatile = MCI->isVolatile();
+
+            auto CopyChunk = [&](IRBuilder<> &IRB, Value *Offset, Align OffsetAlign, uint64_t Size) {
+                Type *ChunkTy = IRB.getIntNTy(Size * 8);
+                Value *SrcGEP = IRB.CreateInBoundsGEP(IRB.getInt8Ty(), Src, Offset);
+                Value *DstGEP = IRB.CreateInBoundsGEP(IRB.getInt8Ty(), Dst, Offset);
+                LoadInst *Load = IRB.CreateAlignedLoad(ChunkTy, SrcGEP, std::min(SrcAlign, OffsetAlign), IsVolatile);
+                IRB.CreateAlignedStore(Load, DstGEP, std::min(DstAlign, OffsetAlign), IsVolatile);
+            };
+
+            if (auto *ConstLen = dyn_cast<ConstantInt>(MCI->getLength())) {
+                MemoryExpansionHelper::expandConstant(MCI, ConstLen->getZExtValue(), CopyChunk);
+            } else {
+                MemoryExpansionHelper::expandVariable(MCI, MCI->getLength(), CopyChunk);
             }
+
+            MCI->eraseFromParent();
+            modified = true;
         }
 
         return modified;
@@ -25,10 +25,16 @@
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Transforms/IPO/GlobalOpt.h"
 
+/**
+ * Regular includes
+ */
+#include "../../helpers/MemoryExpansionHelper.cpp"
+
 /**
  * Namespace(s) to use
  */
@@ -37,6 +43,9 @@ using namespace llvm;
 
 /**
  * A class to expand `memset` calls to manual sets.
+ *
+ * The byte is splatted into a 64-bit value, which is stored in chunks of up to 8 bytes (see `MemoryExpansionHelper`).
+ * Long and variable lengths are set in a loop, so that no `memset` implementation is needed.
  */
 class ExpandMemsetCallsModule  {
 
@@ -69,48 +78,46 @@ public:
         // Ensure module is enabled
         if (!moduleIsEnabled()) return false;
         
-        SmallVector<CallInst *, 8> MemSetCalls;
+        SmallVector<MemSetInst *, 8> MemSetCalls;
 
         // Inform user that we are running this module
         dbgs() << "        ↳ Running ExpandMemsetCalls module.\n";
 
         for (auto &BB : F) {
             for (auto &I : BB) {
-                if (auto *CI = dyn_cast<CallInst>(&I)) {
-                    if (auto *F = CI->getCalledFunction()) {
-                        if (F->getName().starts_with("llvm.memset")) {
-                            MemSetCalls.push_back(CI);
-                        }
-                    }
+                if (auto *MSI = dyn_cast<MemSetInst>(&I)) {
+                    MemSetCalls.push_back(MSI);
                 }
             }
         }
 
-        for (auto *CI : MemSetCalls) {
+        for (auto *MSI : MemSetCalls) {
             // Inform user that we encountered a `memset` call
             dbgs() << "          ↳ Expanding a `memset` call.\n";
 
-            auto *Dst = CI->getArgOperand(0);
-            auto *Val = CI->getArgOperand(1);
-            auto *Len = CI->getArgOperand(2);
-            auto *IsVolatile = CI->getArgOperand(3);
-
-            if (auto *ConstLen = dyn_cast<ConstantInt>(Len)) {
-                uint64_t Size = ConstLen->getZExtValue();
-                IRBuilder<> IRB(CI);
-
-                // Value to be set (need to truncate/extend to i8 if not already)
-                Value *ValueToSet = IRB.CreateTruncOrBitCast(Val, IRB.getInt8Ty());
-                for (uint64_t i = 0; i < Size; ++i) {
-                    Value *Offset = IRB.getInt64(i);
-                    Value *DstGEP = IRB.CreateInBoundsGEP(IRB.getInt8Ty(), Dst, Offset);
-                    StoreInst *Store = IRB.CreateStore(ValueToSet, DstGEP);
-                    Store->setVolatile(cast<ConstantInt>(IsVolatile)->isOne());
-                }
-
-                CI->eraseFromParent();
-                modified = true;
+            auto *Dst = MSI->getRawDest();
+            Align DstAlign = MSI->getDestAlign().valueOrOne();
+            bool IsVolatile = MSI->isVolatile();
+
+            // Value to be set, repeated in every byte of an i64 (folded to a constant if the byte is constant)
+            IRBuilder<> IRB(MSI);
+            Value *Byte = IRB.CreateZExtOrTrunc(MSI->getValue(), IRB.getInt8Ty());
+            Value *Splat = IRB.CreateMul(IRB.CreateZExt(Byte, IRB.getInt64Ty()), IRB.getInt64(0x0101010101010101));
+
+            auto SetChunk = [&](IRBuilder<> &IRB, Value *Offset, Align OffsetAlign, uint64_t Size) {
+                Value *DstGEP = IRB.CreateInBoundsGEP(IRB.getInt8Ty(), Dst, Offset);
+                Value *Chunk = IRB.CreateTrunc(Splat, IRB.getIntNTy(Size * 8));
+                IRB.CreateAlignedStore(Chunk, DstGEP, std::min(DstAlign, OffsetAlign), IsVolatile);
+            };
+
+            if (auto *ConstLen = dyn_cast<ConstantInt>(MSI->getLength())) {
+                MemoryExpansionHelper::expandConstant(MSI, ConstLen->getZExtValue(), SetChunk);
+            } else {
+                MemoryExpansionHelper::expandVariable(MSI, MSI->getLength(), SetChunk);
             }
+
+            MSI->eraseFromParent();
+            modified = true;
         }
 
         return modified;
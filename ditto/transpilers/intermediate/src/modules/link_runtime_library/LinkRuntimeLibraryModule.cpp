@@ -0,0 +1,152 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+/**
+ * LLVM includes
+ */
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace std;
+using namespace llvm;
+
+/**
+ * A class to link the Dittobytes runtime library (`libditto-rt`) into the module.
+ *
+ * The runtime library implements common C library routines (e.g. `memmove`, `strlen` and `strcmp`), which
+ * position independent code cannot call. Only the routines that the module declares (but does not define) are
+ * linked, and they are internalized, so they are compiled & metamorphicated like any other function of the
+ * module. Calls to the `memmove` intrinsic are redirected to the runtime's `memmove` first, as code generation
+ * would otherwise emit a call to an external `memmove`.
+ */
+class LinkRuntimeLibraryModule {
+
+private:
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* LINK_RUNTIME_LIBRARY = std::getenv("LINK_RUNTIME_LIBRARY");
+        return (LINK_RUNTIME_LIBRARY && std::string(LINK_RUNTIME_LIBRARY) == "true");
+    }
+
+    /**
+     * Replace calls to the `memmove` intrinsic by calls to `memmove` (of the runtime library).
+     *
+     * @param Module& M The intermediate module to replace the calls in.
+     * @return bool Indicates if any call was replaced.
+     */
+    bool redirectMemmoveIntrinsics(Module& M) {
+        SmallVector<MemMoveInst*, 8> MemMoveCalls;
+
+        for (Function& F : M) {
+            for (BasicBlock& BB : F) {
+                for (Instruction& I : BB) {
+                    if (auto* MMI = dyn_cast<MemMoveInst>(&I)) {
+                        MemMoveCalls.push_back(MMI);
+                    }
+                }
+            }
+        }
+
+        if (MemMoveCalls.empty()) return false;
+
+        Type* PtrTy = PointerType::getUnqual(M.getContext());
+        Type* SizeTy = M.getDataLayout().getIntPtrType(M.getContext());
+        FunctionCallee Memmove = M.getOrInsertFunction("memmove", FunctionType::get(PtrTy, { PtrTy, PtrTy, SizeTy }, false));
+
+        for (MemMoveInst* MMI : MemMoveCalls) {
+            // Inform user that we encountered a `memmove` intrinsic
+            dbgs() << "          ↳ Redirecting a `memmove` intrinsic to the runtime library.\n";
+
+            IRBuilder<> IRB(MMI);
+            IRB.CreateCall(Memmove, { MMI->getRawDest(), MMI->getRawSource(), IRB.CreateZExtOrTrunc(MMI->getLength(), SizeTy) });
+            MMI->eraseFromParent();
+        }
+
+        return true;
+    }
+
+public:
+
+    /**
+     * Main execution method for the LinkRuntimeLibraryModule class.
+     *
+     * @param Module& M The intermediate module to run on.
+     * @param ModuleAnalysisManager& The LLVM module analysis manager.
+     * @return bool Indicates if the intermediate module was modified.
+     */
+    bool run(Module &M, ModuleAnalysisManager &) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running LinkRuntimeLibraryModule module.\n";
+
+        const char* RUNTIME_LIBRARY_BITCODE = std::getenv("RUNTIME_LIBRARY_BITCODE");
+        if (!RUNTIME_LIBRARY_BITCODE || std::string(RUNTIME_LIBRARY_BITCODE).empty()) {
+            dbgs() << "          ↳ No runtime library bitcode given, not linking anything.\n";
+            return false;
+        }
+
+        bool modified = redirectMemmoveIntrinsics(M);
+        bool linkedAnything = false;
+
+        SMDiagnostic error;
+        std::unique_ptr<Module> runtime = parseIRFile(RUNTIME_LIBRARY_BITCODE, error, M.getContext());
+
+        if (!runtime) {
+            report_fatal_error(formatv("LinkRuntimeLibraryModule failed to read `{0}`: {1}.", RUNTIME_LIBRARY_BITCODE, error.getMessage()));
+        }
+
+        // The runtime library is compiled for the same target, this only prevents warnings about e.g. the OS version
+        runtime->setTargetTriple(M.getTargetTriple());
+        runtime->setDataLayout(M.getDataLayout());
+
+        // Only link what is needed, and internalize what was linked (but nothing that was already in the module)
+        bool failed = Linker::linkModules(M, std::move(runtime), Linker::Flags::LinkOnlyNeeded, [&linkedAnything](Module& M, const StringSet<>& linked) {
+            linkedAnything = !linked.empty();
+
+            internalizeModule(M, [&linked](const GlobalValue& GV) {
+                if (!GV.hasName() || !linked.count(GV.getName())) return true;
+
+                dbgs() << "          ↳ Linked `" << GV.getName() << "` of the runtime library.\n";
+                return false;
+            });
+        });
+
+        if (failed) {
+            report_fatal_error(formatv("LinkRuntimeLibraryModule failed to link `{0}`.", RUNTIME_LIBRARY_BITCODE));
+        }
+
+        return modified || linkedAnything;
+    }
+
+};
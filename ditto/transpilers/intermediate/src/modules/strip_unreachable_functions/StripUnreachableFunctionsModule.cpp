@@ -0,0 +1,196 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+/**
+ * LLVM includes
+ */
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace std;
+using namespace llvm;
+
+/**
+ * A class to remove the functions and global variables that `EntryFunction` can never reach.
+ *
+ * Every global value that is referenced (called, or its address taken) by a reachable function or global
+ * variable is reachable as well. The roots are `EntryFunction`, the symbols in `KEEP_SYMBOLS` (a comma
+ * separated list) and the special `llvm.*` globals (e.g. `llvm.used`). Everything else is removed before
+ * code generation, so it is neither metamorphicated nor part of the payload. Functions that are only
+ * referenced from inline assembly must be kept explicitly.
+ */
+class StripUnreachableFunctionsModule {
+
+private:
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* STRIP_UNREACHABLE_FUNCTIONS = std::getenv("STRIP_UNREACHABLE_FUNCTIONS");
+        return (STRIP_UNREACHABLE_FUNCTIONS && std::string(STRIP_UNREACHABLE_FUNCTIONS) == "true");
+    }
+
+    /**
+     * Mark a global value as reachable (and queue it to visit its references).
+     *
+     * @param GlobalValue* GV The global value that is reachable.
+     * @param SmallPtrSetImpl<GlobalValue*>& reachable The reachable global values.
+     * @param SmallVectorImpl<GlobalValue*>& worklist The global values of which the references must still be visited.
+     */
+    void markReachable(GlobalValue* GV, SmallPtrSetImpl<GlobalValue*>& reachable, SmallVectorImpl<GlobalValue*>& worklist) {
+        if (reachable.insert(GV).second) {
+            worklist.push_back(GV);
+        }
+    }
+
+    /**
+     * Mark all global values that a value refers to as reachable (looking through constant expressions & aggregates).
+     *
+     * @param Value* V The value to visit.
+     * @param SmallPtrSetImpl<Constant*>& visited The constants that were visited already.
+     * @param SmallPtrSetImpl<GlobalValue*>& reachable The reachable global values.
+     * @param SmallVectorImpl<GlobalValue*>& worklist The global values of which the references must still be visited.
+     */
+    void markReferences(Value* V, SmallPtrSetImpl<Constant*>& visited, SmallPtrSetImpl<GlobalValue*>& reachable, SmallVectorImpl<GlobalValue*>& worklist) {
+        if (auto* GV = dyn_cast<GlobalValue>(V)) {
+            markReachable(GV, reachable, worklist);
+            return;
+        }
+
+        auto* C = dyn_cast<Constant>(V);
+        if (!C || !visited.insert(C).second) return;
+
+        for (Value* operand : C->operands()) {
+            markReferences(operand, visited, reachable, worklist);
+        }
+    }
+
+public:
+
+    /**
+     * Main execution method for the StripUnreachableFunctionsModule class.
+     *
+     * @param Module& M The intermediate module to run on.
+     * @param ModuleAnalysisManager& The LLVM module analysis manager.
+     * @return bool Indicates if the intermediate module was modified.
+     */
+    bool run(Module &M, ModuleAnalysisManager &) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running StripUnreachableFunctionsModule module.\n";
+
+        const char* ENTRY_FUNCTION = std::getenv("ENTRY_FUNCTION");
+        Function* entry = ENTRY_FUNCTION ? M.getFunction(ENTRY_FUNCTION) : nullptr;
+
+        // Without a (defined) entry function, everything could be reachable
+        if (!entry || entry->isDeclaration()) {
+            dbgs() << "          ↳ Entry function `" << (ENTRY_FUNCTION ? ENTRY_FUNCTION : "") << "` is not defined, not stripping anything.\n";
+            return false;
+        }
+
+        SmallPtrSet<GlobalValue*, 32> reachable;
+        SmallPtrSet<Constant*, 32> visited;
+        SmallVector<GlobalValue*, 32> worklist;
+
+        markReachable(entry, reachable, worklist);
+
+        const char* KEEP_SYMBOLS = std::getenv("KEEP_SYMBOLS");
+        if (KEEP_SYMBOLS) {
+            SmallVector<StringRef, 4> names;
+            StringRef(KEEP_SYMBOLS).split(names, ',', -1, false);
+
+            for (StringRef name : names) {
+                if (GlobalValue* GV = M.getNamedValue(name.trim())) {
+                    markReachable(GV, reachable, worklist);
+                }
+            }
+        }
+
+        // Aliases, ifuncs and the special `llvm.*` globals (e.g. `llvm.used`) are never removed
+        for (GlobalValue& GV : M.global_values()) {
+            if (isa<GlobalAlias>(GV) || isa<GlobalIFunc>(GV) || GV.getName().starts_with("llvm.")) {
+                markReachable(&GV, reachable, worklist);
+            }
+        }
+
+        while (!worklist.empty()) {
+            GlobalValue* GV = worklist.pop_back_val();
+
+            // The initializer of a variable, the aliasee of an alias, or the personality (etc.) of a function
+            for (Value* operand : GV->operands()) {
+                markReferences(operand, visited, reachable, worklist);
+            }
+
+            auto* F = dyn_cast<Function>(GV);
+            if (!F) continue;
+
+            for (BasicBlock& BB : *F) {
+                for (Instruction& I : BB) {
+                    for (Value* operand : I.operands()) {
+                        markReferences(operand, visited, reachable, worklist);
+                    }
+                }
+            }
+        }
+
+        SmallVector<Function*, 8> deadFunctions;
+        SmallVector<GlobalVariable*, 8> deadVariables;
+
+        for (Function& F : M) {
+            if (!F.isDeclaration() && !reachable.count(&F)) deadFunctions.push_back(&F);
+        }
+
+        for (GlobalVariable& GV : M.globals()) {
+            if (!GV.isDeclaration() && !reachable.count(&GV)) deadVariables.push_back(&GV);
+        }
+
+        // Unreachable values are only referenced by each other, so their references are dropped before erasing any of them
+        for (Function* F : deadFunctions) {
+            dbgs() << "          ↳ Removing unreachable function `" << F->getName() << "(...)`.\n";
+            F->deleteBody();
+        }
+
+        for (GlobalVariable* GV : deadVariables) {
+            dbgs() << "          ↳ Removing unreachable global variable `" << GV->getName() << "`.\n";
+            GV->setInitializer(nullptr);
+        }
+
+        for (Function* F : deadFunctions) {
+            F->removeDeadConstantUsers();
+            F->eraseFromParent();
+        }
+
+        for (GlobalVariable* GV : deadVariables) {
+            GV->removeDeadConstantUsers();
+            GV->eraseFromParent();
+        }
+
+        return !deadFunctions.empty() || !deadVariables.empty();
+    }
+
+};
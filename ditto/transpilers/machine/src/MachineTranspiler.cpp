@@ -30,11 +30,27 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineBranchProbabilityInfo.h"
+#include "llvm/CodeGen/MachineDominators.h"
+
+/**
+ * Helpers
+ */
+#include "helpers/TransformContext.cpp"
 
 /**
  * Modules
  */
+#include "modules/cleanup_redundancies/CleanupRedundanciesModule.cpp"
+#include "modules/inline_memory_calls/InlineMemoryCallsModule.cpp"
 #include "modules/insert_semantic_noise/InsertSemanticNoiseModule.cpp"
+#include "modules/randomize_block_layout/RandomizeBlockLayoutModule.cpp"
+#include "modules/randomize_encodings/RandomizeEncodingsModule.cpp"
+#include "modules/randomize_frame_layout/RandomizeFrameLayoutModule.cpp"
+#include "modules/randomize_instruction_schedule/RandomizeInstructionScheduleModule.cpp"
+#include "modules/transform_arithmetic_identities/TransformArithmeticIdentitiesModule.cpp"
 #include "modules/transform_nullifications/TransformNullificationsModule.cpp"
 #include "modules/transform_reg_mov_immediates/TransformRegMovImmediatesModule.cpp"
 #include "modules/transform_stack_mov_immediates/TransformStackMovImmediatesModule.cpp"
@@ -114,6 +130,34 @@ public:
         return "MachineTranspiler";
     }
 
+    /**
+     * Declares the analyses that the modules of this pass rely on.
+     * 
+     * Loop and block frequency information is used to lower the density of transformations in hot code,
+     * and branch probability information is used to keep hot paths falling through.
+     * 
+     * @param AnalysisUsage& AU The analysis usage to add the required analyses to.
+     */
+    void getAnalysisUsage(AnalysisUsage &AU) const override {
+        AU.addRequired<MachineLoopInfo>();
+        AU.addRequired<MachineBlockFrequencyInfo>();
+        AU.addRequired<MachineBranchProbabilityInfo>();
+        MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    /**
+     * Recalculate the loop & block frequency information, after blocks were added (e.g. by inlined loops).
+     *
+     * @param MachineFunction& MF The machine function that was modified.
+     */
+    void recalculateAnalyses(MachineFunction &MF) {
+        MachineDominatorTree MDT(MF);
+        MachineLoopInfo& MLI = getAnalysis<MachineLoopInfo>();
+
+        MLI.calculate(MDT);
+        getAnalysis<MachineBlockFrequencyInfo>().calculate(MF, getAnalysis<MachineBranchProbabilityInfo>(), MLI);
+    }
+
     /**
      * Main execution method for the MachineTranspiler pass.
      *
@@ -128,24 +172,55 @@ public:
 
         dbgs() << "      ↳ MachineTranspiler passing function `" << MF.getName() << "(...)` for step `" << step << "`.\n";
 
+        // Every function (and step) gets its own random substream, so the result does not depend on the partitioning
+        RandomHelper::seedFunction(MF.getName(), step);
+
+        // Module: Inline `memcpy` & `memset` calls of code generation (first, so that the lengths are still plain
+        // immediates, and the constants of the inline code are metamorphicated like any other)
+        if (step == FirstStep && InlineMemoryCallsModule().runOnMachineFunction(MF)) {
+            modified = true;
+            recalculateAnalyses(MF);
+        }
+
+        // State shared by all modules (e.g. loop & block frequency information)
+        TransformContext context(MF, getAnalysis<MachineLoopInfo>(), getAnalysis<MachineBlockFrequencyInfo>(), getAnalysis<MachineBranchProbabilityInfo>());
+
         switch (step) {
             case FirstStep:
                 // Module: Modify `mov reg, imm` immediate's
-                modified = TransformRegMovImmediatesModule().runOnMachineFunction(MF) || modified;
+                modified = TransformRegMovImmediatesModule().runOnMachineFunction(MF, context) || modified;
                 // Module: Modify `mov [reg+var_a], imm` immediate's
-                modified = TransformStackMovImmediatesModule().runOnMachineFunction(MF) || modified;
+                modified = TransformStackMovImmediatesModule().runOnMachineFunction(MF, context) || modified;
                 break;
             case LastStep:
-                // Module: Insert semantic noise (meaningful dead code)
-                // modified = InsertSemanticNoiseModule().runOnMachineFunction(MF) || modified;
+                // Module: Remove redundant spills, reloads & moves (before any substitution of this step)
+                modified = CleanupRedundanciesModule().runOnMachineFunction(MF, context) || modified;
                 // Module: Replace `xor reg, reg` instructions
-                modified = TransformNullificationsModule().runOnMachineFunction(MF) || modified;
+                modified = TransformNullificationsModule().runOnMachineFunction(MF, context) || modified;
+                // Module: Replace arithmetic instructions by equivalent ones (e.g. `add reg, imm` by `sub reg, -imm`)
+                modified = TransformArithmeticIdentitiesModule().runOnMachineFunction(MF, context) || modified;
+                // Module: Randomize the order of basic blocks (keeping hot paths falling through)
+                modified = RandomizeBlockLayoutModule().runOnMachineFunction(MF, context) || modified;
+                // Module: Insert semantic noise (meaningful dead code, after the block layout so that no jump around it is needed)
+                modified = InsertSemanticNoiseModule().runOnMachineFunction(MF, context) || modified;
+                // Module: Randomize the order of independent instructions (zero added bytes)
+                modified = RandomizeInstructionScheduleModule().runOnMachineFunction(MF, context) || modified;
+                // Module: Randomize the order of stack objects (zero added bytes)
+                modified = RandomizeFrameLayoutModule().runOnMachineFunction(MF, context) || modified;
+                // Module: Randomize between equivalent encodings of instructions (zero added bytes)
+                modified = RandomizeEncodingsModule().runOnMachineFunction(MF, context) || modified;
                 break;
             case UnknownStep:        
                 dbgs() << "        ↳ Unknown step `" << step << "`.\n";
                 break;
         }
 
+        // Report the estimated overhead of the transformations
+        context.report();
+
+        // Persist the growth, so that the next step (and the frame insertions) respect the same budget
+        context.persistGrowth();
+
         return modified;
     }
 
@@ -0,0 +1,326 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <initializer_list>
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * Classes of instructions that substitution options emit.
+ *
+ * The classes are target independent (e.g. `AluRegReg` is `xor r32, r32` on AMD64 and `eor w0, w0, w1` on ARM64),
+ * the cost profiles below define what they cost on a specific target.
+ */
+enum class InstructionClass : unsigned {
+    MovRegImmediate,        // mov reg, imm (up to 32 bits)
+    MovRegImmediate64,      // mov reg, imm (64 bits, e.g. `movabs` or `movz` + 3x `movk`)
+    MovRegReg,              // mov reg, reg
+    MovStackImmediate,      // mov [reg+offset], imm
+    AluRegReg,              // add/sub/xor reg, reg
+    AluRegImmediate,        // add/sub/xor reg, imm
+    AluStackReg,            // add/sub/xor [reg+offset], reg (read-modify-write)
+    LoadStack,              // mov reg, [reg+offset]
+    StoreStack,             // mov [reg+offset], reg
+    Count
+};
+
+/**
+ * The cost of a single instruction class on a specific target.
+ */
+struct InstructionCost {
+
+    /**
+     * Latency (in cycles) until the result is available.
+     */
+    double latency;
+
+    /**
+     * Reciprocal throughput (in cycles per instruction).
+     */
+    double throughput;
+
+    /**
+     * Typical encoded size (in bytes).
+     */
+    unsigned size;
+
+};
+
+/**
+ * A cost profile of a (family of) CPU(s).
+ */
+struct CostProfile {
+
+    /**
+     * Human readable name of the profile.
+     */
+    const char* name;
+
+    /**
+     * The architecture the profile applies to.
+     */
+    Triple::ArchType architecture;
+
+    /**
+     * Amount of instruction bytes the front-end fetches per cycle (used to weigh encoded size against cycles).
+     */
+    double fetchBytesPerCycle;
+
+    /**
+     * Costs per instruction class (indexed by `InstructionClass`).
+     */
+    InstructionCost costs[(unsigned) InstructionClass::Count];
+
+};
+
+/**
+ * A utility class to estimate the cost of instruction sequences that substitution options emit.
+ *
+ * The profile is selected based on the CPU of the subtarget (e.g. `llc -mcpu=znver4`). Unknown CPUs
+ * fall back to the generic profile of the architecture. Numbers are approximations based on publicly
+ * available instruction tables, and are only used to rank candidate sequences against each other.
+ */
+class CostModelHelper {
+
+public:
+
+    /**
+     * Retrieve the cost profile of the CPU that the given machine function is compiled for.
+     *
+     * @param const MachineFunction& MF The machine function to retrieve the profile for.
+     * @return const CostProfile& The cost profile of the (family of the) CPU.
+     */
+    static const CostProfile& getProfile(const MachineFunction& MF) {
+        Triple::ArchType architecture = MF.getTarget().getTargetTriple().getArch();
+        StringRef cpu = MF.getSubtarget().getCPU();
+
+        switch (architecture) {
+            // AMD64
+            case Triple::x86_64:
+                if (isOneOf(cpu, {"alderlake", "raptorlake", "meteorlake", "arrowlake", "lunarlake", "sapphirerapids", "emeraldrapids", "graniterapids", "pantherlake"})) return getProfiles()[1];
+                if (isOneOf(cpu, {"znver3", "znver4", "znver5"})) return getProfiles()[2];
+                return getProfiles()[0];
+            // ARM64
+            case Triple::aarch64:
+                if (cpu.starts_with("apple-")) return getProfiles()[5];
+                if (cpu.starts_with("cortex-") || cpu.starts_with("neoverse-")) return getProfiles()[4];
+                return getProfiles()[3];
+            // Unknown architecture
+            default:
+                report_fatal_error(formatv("CostModelHelper failed due to unknown architecture: {0}.", architecture));
+        }
+    }
+
+    /**
+     * Estimate the cost of an instruction sequence, combining latency, throughput and encoded size.
+     *
+     * Encoded size is converted to cycles using the fetch width of the profile.
+     *
+     * @param const CostProfile& profile The cost profile to use.
+     * @param ArrayRef<InstructionClass> sequence The instruction classes in the sequence.
+     * @return double The estimated cost (in cycles).
+     */
+    static double getSequenceCost(const CostProfile& profile, ArrayRef<InstructionClass> sequence) {
+        double result = 0;
+
+        for (InstructionClass instructionClass : sequence) {
+            const InstructionCost& cost = profile.costs[(unsigned) instructionClass];
+            result += cost.latency + cost.throughput + (cost.size / profile.fetchBytesPerCycle);
+        }
+
+        return result;
+    }
+
+    /**
+     * Estimate the encoded size of an instruction sequence.
+     *
+     * @param const CostProfile& profile The cost profile to use.
+     * @param ArrayRef<InstructionClass> sequence The instruction classes in the sequence.
+     * @return unsigned The estimated size (in bytes).
+     */
+    static unsigned getSequenceSize(const CostProfile& profile, ArrayRef<InstructionClass> sequence) {
+        unsigned result = 0;
+
+        for (InstructionClass instructionClass : sequence) {
+            result += profile.costs[(unsigned) instructionClass].size;
+        }
+
+        return result;
+    }
+
+    /**
+     * Estimate the encoded size of a single (machine) instruction, by mapping it onto the closest instruction class.
+     *
+     * Not every target reports instruction sizes before code emission (e.g. AMD64), so this is an approximation
+     * that is consistent with the sizes of the sequences that options emit.
+     *
+     * @param const CostProfile& profile The cost profile to use.
+     * @param const MachineInstr& instruction The instruction to estimate the size of.
+     * @return unsigned The estimated size (in bytes).
+     */
+    static unsigned getInstructionSize(const CostProfile& profile, const MachineInstr& instruction) {
+        if (instruction.isMetaInstruction()) return 0;
+
+        const MachineOperand* immediate = nullptr;
+        for (const MachineOperand& operand : instruction.operands()) {
+            if (operand.isImm()) {
+                immediate = &operand;
+                break;
+            }
+        }
+
+        InstructionClass instructionClass = InstructionClass::AluRegReg;
+
+        if (instruction.mayLoad() && instruction.mayStore()) {
+            instructionClass = InstructionClass::AluStackReg;
+        } else if (instruction.mayStore()) {
+            instructionClass = immediate ? InstructionClass::MovStackImmediate : InstructionClass::StoreStack;
+        } else if (instruction.mayLoad()) {
+            instructionClass = InstructionClass::LoadStack;
+        } else if (instruction.isMoveImmediate() && immediate) {
+            instructionClass = isInt<32>(immediate->getImm()) ? InstructionClass::MovRegImmediate : InstructionClass::MovRegImmediate64;
+        } else if (instruction.isCopy() || instruction.isMoveReg()) {
+            instructionClass = InstructionClass::MovRegReg;
+        } else if (immediate) {
+            instructionClass = InstructionClass::AluRegImmediate;
+        }
+
+        return profile.costs[(unsigned) instructionClass].size;
+    }
+
+private:
+
+    /**
+     * Check if the given CPU name is one of the given names.
+     *
+     * @param StringRef cpu The CPU name.
+     * @param std::initializer_list<const char*> names The names to compare against.
+     * @return bool Positive if the CPU name matches one of the names.
+     */
+    static bool isOneOf(StringRef cpu, std::initializer_list<const char*> names) {
+        for (const char* name : names) {
+            if (cpu == name) return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * Retrieve all available cost profiles.
+     *
+     * Columns are { latency, reciprocal throughput, size } in the order of `InstructionClass`.
+     *
+     * @return const CostProfile* The available cost profiles.
+     */
+    static const CostProfile* getProfiles() {
+        static const CostProfile profiles[] = {
+            // 0. AMD64 generic (conservative, e.g. Skylake-class)
+            { "x86-64", Triple::x86_64, 16, {
+                { 1, 0.25, 5 },   // MovRegImmediate
+                { 1, 0.50, 10 },  // MovRegImmediate64
+                { 1, 0.25, 3 },   // MovRegReg
+                { 1, 1.00, 8 },   // MovStackImmediate
+                { 1, 0.25, 3 },   // AluRegReg
+                { 1, 0.25, 4 },   // AluRegImmediate
+                { 6, 1.00, 4 },   // AluStackReg
+                { 5, 0.50, 4 },   // LoadStack
+                { 1, 1.00, 4 }    // StoreStack
+            }},
+            // 1. AMD64 recent Intel (Golden Cove & later)
+            { "intel-golden-cove", Triple::x86_64, 32, {
+                { 1, 0.20, 5 },
+                { 1, 0.20, 10 },
+                { 0, 0.20, 3 },
+                { 1, 0.50, 8 },
+                { 1, 0.20, 3 },
+                { 1, 0.20, 4 },
+                { 5, 0.50, 4 },
+                { 5, 0.33, 4 },
+                { 1, 0.50, 4 }
+            }},
+            // 2. AMD64 recent AMD (Zen 3 & later)
+            { "amd-zen", Triple::x86_64, 32, {
+                { 1, 0.25, 5 },
+                { 1, 0.25, 10 },
+                { 0, 0.17, 3 },
+                { 1, 0.50, 8 },
+                { 1, 0.25, 3 },
+                { 1, 0.25, 4 },
+                { 7, 0.50, 4 },
+                { 4, 0.33, 4 },
+                { 1, 0.50, 4 }
+            }},
+            // 3. ARM64 generic
+            { "aarch64", Triple::aarch64, 16, {
+                { 1, 0.50, 8 },
+                { 2, 1.00, 16 },
+                { 1, 0.50, 4 },
+                { 1, 1.00, 8 },
+                { 1, 0.50, 4 },
+                { 1, 0.50, 4 },
+                { 6, 1.00, 12 },
+                { 4, 0.50, 4 },
+                { 1, 1.00, 4 }
+            }},
+            // 4. ARM64 Cortex-A/X & Neoverse
+            { "arm-cortex", Triple::aarch64, 16, {
+                { 1, 0.33, 8 },
+                { 2, 0.67, 16 },
+                { 0, 0.33, 4 },
+                { 1, 0.50, 8 },
+                { 1, 0.33, 4 },
+                { 1, 0.33, 4 },
+                { 6, 0.50, 12 },
+                { 4, 0.33, 4 },
+                { 1, 0.50, 4 }
+            }},
+            // 5. ARM64 Apple (M-series & A-series)
+            { "apple", Triple::aarch64, 32, {
+                { 1, 0.17, 8 },
+                { 1, 0.33, 16 },
+                { 0, 0.17, 4 },
+                { 1, 0.50, 8 },
+                { 1, 0.17, 4 },
+                { 1, 0.17, 4 },
+                { 5, 0.50, 12 },
+                { 3, 0.33, 4 },
+                { 1, 0.50, 4 }
+            }}
+        };
+
+        return profiles;
+    }
+
+};
@@ -0,0 +1,269 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/StringRef.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+/**
+ * Regular includes
+ */
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <string>
+#include "CostModelHelper.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * Keeps track of the code growth that metamorphication adds, against the `MM_MAX_GROWTH` budget.
+ *
+ * The budget is `<function>[,<payload>]`, where each limit is either an amount of bytes (e.g. `256`) or
+ * a percentage of the original size (e.g. `25%`). Without a payload limit, only functions are limited.
+ *
+ * The machine transpiler runs in separate `llc` invocations (before and after register allocation), so
+ * the original size and the consumed growth of every function are persisted as function attributes, which
+ * end up in the intermediate MIR files. The remaining budget is persisted as well, for the frame insertions.
+ *
+ * Partitions of the payload are compiled separately, so an absolute payload limit is divided over them by
+ * their share of the payload (the `ditto-payload-share` module flag of the split intermediate module).
+ */
+class GrowthBudgetHelper {
+
+private:
+
+    /**
+     * The machine function that is being transformed.
+     */
+    MachineFunction& MF;
+
+    /**
+     * The cost profile used to estimate instruction sizes.
+     */
+    const CostProfile& profile;
+
+    /**
+     * Original size (in bytes) of the function and the payload (all functions in the module).
+     */
+    double functionSize = 0;
+    double payloadSize = 0;
+
+    /**
+     * Maximum growth (in bytes) of the function and the payload.
+     */
+    double functionLimit = std::numeric_limits<double>::infinity();
+    double payloadLimit = std::numeric_limits<double>::infinity();
+
+    /**
+     * Growth (in bytes) consumed by earlier invocations, for the function and the payload.
+     */
+    double functionConsumedBefore = 0;
+    double payloadConsumedBefore = 0;
+
+    /**
+     * Growth (in bytes) consumed in this invocation, in total and per module.
+     */
+    double consumed = 0;
+    std::map<std::string, double> consumedPerModule;
+
+    /**
+     * Retrieve a numeric function attribute that was persisted by an earlier invocation.
+     *
+     * @param const Function& F The function to retrieve the attribute of.
+     * @param StringRef name The name of the attribute.
+     * @param double fallback The value to return if the attribute is not present.
+     * @return double The value of the attribute.
+     */
+    static double getAttribute(const Function& F, StringRef name, double fallback) {
+        if (!F.hasFnAttribute(name)) return fallback;
+        return std::atof(F.getFnAttribute(name).getValueAsString().str().c_str());
+    }
+
+    /**
+     * Estimate the (current) size of a machine function.
+     *
+     * @param const MachineFunction& function The machine function to estimate the size of.
+     * @return double The estimated size (in bytes).
+     */
+    double getSize(const MachineFunction& function) {
+        double result = 0;
+
+        for (const auto& MachineBasicBlock : function) {
+            for (const auto& Instruction : MachineBasicBlock) {
+                result += CostModelHelper::getInstructionSize(profile, Instruction);
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Retrieve the share of the payload that this partition holds.
+     *
+     * @param const Module& M The (partition of the) module.
+     * @return double The share (between 0 and 1), or 1 if the module was not split.
+     */
+    static double getPayloadShare(const Module& M) {
+        const MDString* share = dyn_cast_or_null<MDString>(M.getModuleFlag("ditto-payload-share"));
+        if (!share) return 1;
+
+        return std::atof(share->getString().str().c_str());
+    }
+
+    /**
+     * Convert a single limit (e.g. `256` or `25%`) to an amount of bytes.
+     *
+     * @param StringRef limit The limit to convert.
+     * @param double size The original size the percentage is relative to.
+     * @param double share The share of an amount of bytes that applies (percentages are already relative).
+     * @return double The limit in bytes (infinite if the limit is empty).
+     */
+    static double parseLimit(StringRef limit, double size, double share = 1) {
+        limit = limit.trim();
+        if (limit.empty()) return std::numeric_limits<double>::infinity();
+
+        bool percentage = limit.consume_back("%");
+        double value = std::atof(limit.str().c_str());
+        if (value < 0) value = 0;
+
+        return percentage ? (size * value / 100.0) : (value * share);
+    }
+
+public:
+
+    /**
+     * Constructor that determines the original sizes and the limits of the function and the payload.
+     *
+     * @param MachineFunction& MF The machine function that is being transformed.
+     */
+    GrowthBudgetHelper(MachineFunction& MF) : MF(MF), profile(CostModelHelper::getProfile(MF)) {
+        const Function& F = MF.getFunction();
+
+        functionSize = getAttribute(F, "ditto-original-size", getSize(MF));
+        functionConsumedBefore = getAttribute(F, "ditto-growth", 0);
+
+        // Other functions either have been transformed (and have attributes), or are still original
+        for (const Function& other : F.getParent()->functions()) {
+            const MachineFunction* otherMF = (&other == &F) ? &MF : MF.getMMI().getMachineFunction(other);
+
+            payloadSize += getAttribute(other, "ditto-original-size", otherMF ? getSize(*otherMF) : 0);
+            payloadConsumedBefore += getAttribute(other, "ditto-growth", 0);
+        }
+
+        const char* MM_MAX_GROWTH = std::getenv("MM_MAX_GROWTH");
+        if (!MM_MAX_GROWTH) return;
+
+        std::pair<StringRef, StringRef> limits = StringRef(MM_MAX_GROWTH).split(',');
+        functionLimit = parseLimit(limits.first, functionSize);
+        payloadLimit = parseLimit(limits.second, payloadSize, getPayloadShare(*F.getParent()));
+    }
+
+    /**
+     * Check if there is any limit on the growth.
+     *
+     * @return bool Positive if the function or the payload is limited.
+     */
+    bool isLimited() const {
+        return functionLimit != std::numeric_limits<double>::infinity() || payloadLimit != std::numeric_limits<double>::infinity();
+    }
+
+    /**
+     * Retrieve the remaining budget (the lowest of the function and the payload budget).
+     *
+     * @return double The remaining budget (in bytes).
+     */
+    double getRemaining() const {
+        double function = functionLimit - functionConsumedBefore - consumed;
+        double payload = payloadLimit - payloadConsumedBefore - consumed;
+
+        return std::min(function, payload);
+    }
+
+    /**
+     * Check if the given growth fits in the remaining budget.
+     *
+     * @param double bytes The growth (in bytes).
+     * @return bool Positive if the growth fits.
+     */
+    bool fits(double bytes) const {
+        return bytes <= 0 || bytes <= getRemaining();
+    }
+
+    /**
+     * Consume (or, if negative, return) part of the budget.
+     *
+     * @param StringRef module The name of the module that caused the growth.
+     * @param double bytes The growth (in bytes).
+     */
+    void consume(StringRef module, double bytes) {
+        consumed += bytes;
+        consumedPerModule[module.str()] += bytes;
+    }
+
+    /**
+     * Retrieve the growth that a module consumed in this step.
+     *
+     * @param StringRef module The name of the module.
+     * @return double The growth (in bytes).
+     */
+    double getConsumed(StringRef module) const {
+        auto consumption = consumedPerModule.find(module.str());
+        return (consumption == consumedPerModule.end()) ? 0 : consumption->second;
+    }
+
+    /**
+     * Persist the original size, the consumed growth and the remaining budget as function attributes.
+     */
+    void persist() {
+        Function& F = MF.getFunction();
+
+        F.addFnAttr("ditto-original-size", std::to_string((long long) functionSize));
+        F.addFnAttr("ditto-growth", std::to_string((long long) (functionConsumedBefore + consumed)));
+
+        if (isLimited()) {
+            F.addFnAttr("ditto-growth-remaining", std::to_string((long long) std::max(0.0, getRemaining())));
+        }
+    }
+
+    /**
+     * Report the consumed budget in total and per module.
+     */
+    void report() {
+        dbgs() << "        ↳ Growth of `" << MF.getName() << "(...)`: " << format("%.0f", consumed) << " byte(s) in this step, " << format("%.0f", functionConsumedBefore + consumed) << " of " << format("%.0f", functionSize) << " original byte(s) in total";
+
+        if (isLimited()) {
+            dbgs() << ", " << format("%.0f", std::max(0.0, getRemaining())) << " byte(s) of budget remaining";
+        }
+
+        dbgs() << ".\n";
+
+        for (const auto& module : consumedPerModule) {
+            dbgs() << "          ↳ " << module.first << " consumed " << format("%.0f", module.second) << " byte(s).\n";
+        }
+    }
+
+};
@@ -0,0 +1,414 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/CodeGen/LivePhysRegs.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/Support/Alignment.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../../../shared/helpers/NoiseCorpusFormat.cpp"
+#include "../../../shared/helpers/RandomHelper.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A basic block harvested from a trusted binary (a view into the memory-mapped corpus).
+ */
+struct NoiseBlock {
+
+    /**
+     * The length (in bytes) of every instruction in the block.
+     */
+    ArrayRef<uint8_t> lengths;
+
+    /**
+     * The encoded instructions.
+     */
+    ArrayRef<uint8_t> bytes;
+
+};
+
+/**
+ * Provides the compiled corpus of harvested basic blocks (semantic noise) of a platform & architecture.
+ *
+ * The corpus is compiled by `./ditto/scripts/noise/noise.py provide` into `<os>-<arch>.bin`, in the directory
+ * given by `MM_NOISE_CORPUS_DIRECTORY` (default `./ditto/scripts/noise/data`). The file is memory-mapped and
+ * used as is (see `NoiseCorpusFormat`), so loading it costs the same for any corpus size.
+ *
+ * Sampling first picks a random bucket out of the buckets that are compatible with the allowed register
+ * footprint and the maximum amount of instructions, and then a random block in that bucket. By default, both
+ * are picked in proportion to how often the blocks were seen while harvesting, so common real-world blocks
+ * are inserted most (`MM_NOISE_BY_FREQUENCY=false` picks uniformly). The buckets are indexed by their footprint
+ * when the corpus is mapped, so a query only visits the distinct footprints and the buckets it is compatible with.
+ * The compatible buckets are determined once per distinct query, so every further sample with the same query is O(log n).
+ */
+class NoiseCorpusHelper {
+
+private:
+
+    /**
+     * The (memory-mapped) corpus file.
+     */
+    std::unique_ptr<MemoryBuffer> buffer;
+
+    /**
+     * Whether the corpus is of ARM64 (or AMD64).
+     */
+    bool arm64 = false;
+
+    /**
+     * The sections of the corpus.
+     */
+    ArrayRef<NoiseCorpusBucket> buckets;
+    ArrayRef<NoiseCorpusBlock> blocks;
+    ArrayRef<uint8_t> bytes;
+
+    /**
+     * The (validated) buckets of a register footprint, in order of their amount of instructions.
+     */
+    struct FootprintBuckets {
+        uint64_t footprint;
+        std::vector<uint32_t> indexes;
+    };
+
+    /**
+     * The buckets per distinct footprint (in order of the corpus).
+     */
+    std::vector<FootprintBuckets> footprints;
+
+    /**
+     * The buckets that are compatible with a query, and the sum of their counts up to and including each bucket.
+     */
+    struct CompatibleBuckets {
+        std::vector<uint32_t> indexes;
+        std::vector<uint64_t> cumulativeCounts;
+    };
+
+    /**
+     * The compatible buckets per query (allowed footprint & maximum amount of instructions).
+     */
+    std::map<std::pair<uint64_t, unsigned>, CompatibleBuckets> compatibleBuckets;
+
+    /**
+     * Whether blocks are sampled in proportion to their real-world count (default) or uniformly.
+     *
+     * @returns bool Positive if sampling by frequency.
+     */
+    static bool samplingByFrequency() {
+        const char* MM_NOISE_BY_FREQUENCY = std::getenv("MM_NOISE_BY_FREQUENCY");
+        return !MM_NOISE_BY_FREQUENCY || std::string(MM_NOISE_BY_FREQUENCY) != "false";
+    }
+
+    /**
+     * Pick a random block in a bucket.
+     *
+     * @param const NoiseCorpusBucket& bucket The (validated) bucket.
+     * @return const NoiseCorpusBlock& The block.
+     */
+    const NoiseCorpusBlock& sampleBlock(const NoiseCorpusBucket& bucket) const {
+        std::mt19937& generator = RandomHelper::getRandomGenerator();
+        ArrayRef<NoiseCorpusBlock> candidates = blocks.slice(bucket.firstBlock, bucket.blockCount);
+
+        if (!samplingByFrequency() || bucket.count == 0 || candidates.back().cumulativeCount != bucket.count) {
+            return candidates[std::uniform_int_distribution<uint32_t>(0, bucket.blockCount - 1)(generator)];
+        }
+
+        // The first block whose cumulative count exceeds a random count in the bucket
+        uint64_t target = std::uniform_int_distribution<uint64_t>(0, bucket.count - 1)(generator);
+        auto found = std::upper_bound(candidates.begin(), candidates.end(), target, [](uint64_t value, const NoiseCorpusBlock& block) { return value < block.cumulativeCount; });
+
+        return found != candidates.end() ? *found : candidates.back();
+    }
+
+    /**
+     * Retrieve a section of the corpus, if it lies within the file.
+     *
+     * @param uint64_t offset The offset of the section.
+     * @param uint64_t count The amount of entries in the section.
+     * @param ArrayRef<T>& result The section.
+     * @return bool Positive if the section lies within the file (and is aligned).
+     */
+    template <typename T> bool getSection(uint64_t offset, uint64_t count, ArrayRef<T>& result) {
+        StringRef file = buffer->getBuffer();
+
+        if (offset % alignof(T) != 0 || offset > file.size() || count > (file.size() - offset) / sizeof(T)) return false;
+
+        result = ArrayRef<T>(reinterpret_cast<const T*>(file.data() + offset), count);
+        return true;
+    }
+
+    /**
+     * Index the (valid) buckets by their footprint, so that queries don't have to visit every bucket.
+     */
+    void indexBuckets() {
+        std::unordered_map<uint64_t, size_t> positions;
+
+        for (uint32_t index = 0; index < buckets.size(); index++) {
+            const NoiseCorpusBucket& bucket = buckets[index];
+            if (bucket.blockCount == 0 || bucket.firstBlock > blocks.size() || bucket.blockCount > blocks.size() - bucket.firstBlock) continue;
+
+            auto position = positions.emplace(bucket.footprint, footprints.size());
+            if (position.second) footprints.push_back({ bucket.footprint, {} });
+
+            footprints[position.first->second].indexes.push_back(index);
+        }
+
+        for (FootprintBuckets& footprint : footprints) {
+            std::stable_sort(footprint.indexes.begin(), footprint.indexes.end(), [&](uint32_t a, uint32_t b) { return buckets[a].instructionCount < buckets[b].instructionCount; });
+        }
+    }
+
+    /**
+     * Map and validate the corpus at the given path.
+     *
+     * @param const std::string& path The path to the corpus.
+     * @return bool Positive if the corpus could be loaded.
+     */
+    bool load(const std::string& path) {
+        ErrorOr<std::unique_ptr<MemoryBuffer>> file = MemoryBuffer::getFile(path, false, false, false, Align(8));
+
+        if (!file) {
+            dbgs() << "          ↳ Semantic noise corpus `" << path << "` could not be opened (compile it with `noise.py provide`).\n";
+            return false;
+        }
+
+        buffer = std::move(*file);
+
+        if (buffer->getBufferSize() < sizeof(NoiseCorpusHeader)) return false;
+
+        const NoiseCorpusHeader* header = reinterpret_cast<const NoiseCorpusHeader*>(buffer->getBufferStart());
+
+        if (std::memcmp(header->magic, NoiseCorpusFormat::MAGIC, sizeof(header->magic)) != 0 || header->version != NoiseCorpusFormat::VERSION) {
+            dbgs() << "          ↳ Semantic noise corpus `" << path << "` has an unsupported format.\n";
+            return false;
+        }
+
+        if (!getSection(header->bucketsOffset, header->bucketCount, buckets) || !getSection(header->blocksOffset, header->blockCount, blocks) || !getSection(header->bytesOffset, header->bytesSize, bytes)) {
+            dbgs() << "          ↳ Semantic noise corpus `" << path << "` is truncated.\n";
+            buckets = {};
+            blocks = {};
+            return false;
+        }
+
+        indexBuckets();
+
+        dbgs() << "          ↳ Mapped " << blocks.size() << " block(s) in " << buckets.size() << " bucket(s) from semantic noise corpus `" << path << "`.\n";
+        return true;
+    }
+
+public:
+
+    /**
+     * Retrieve the name of the corpus of the given target (e.g. `win-amd64`).
+     *
+     * @param const Triple& triple The target triple.
+     * @return std::string The name of the corpus (or an empty string if the target is not supported).
+     */
+    static std::string getCorpusName(const Triple& triple) {
+        std::string os = triple.isOSWindows() ? "win" : (triple.isOSDarwin() ? "mac" : "lin");
+
+        switch (triple.getArch()) {
+            case Triple::x86_64:
+                return os + "-amd64";
+            case Triple::aarch64:
+                return os + "-arm64";
+            default:
+                return "";
+        }
+    }
+
+    /**
+     * Retrieve the (lazily mapped) corpus of the given target.
+     *
+     * @param const Triple& triple The target triple.
+     * @return NoiseCorpusHelper& The corpus (empty if it could not be loaded).
+     */
+    static NoiseCorpusHelper& getCorpus(const Triple& triple) {
+        static std::map<std::string, NoiseCorpusHelper> corpora;
+
+        std::string name = getCorpusName(triple);
+        auto cached = corpora.find(name);
+        if (cached != corpora.end()) return cached->second;
+
+        NoiseCorpusHelper& result = corpora[name];
+        result.arm64 = triple.getArch() == Triple::aarch64;
+        if (name.empty()) return result;
+
+        const char* MM_NOISE_CORPUS_DIRECTORY = std::getenv("MM_NOISE_CORPUS_DIRECTORY");
+        result.load(std::string(MM_NOISE_CORPUS_DIRECTORY ? MM_NOISE_CORPUS_DIRECTORY : "./ditto/scripts/noise/data") + "/" + name + ".bin");
+
+        return result;
+    }
+
+    /**
+     * Check if the corpus contains any block.
+     *
+     * @return bool Positive if blocks can be sampled.
+     */
+    bool isLoaded() const {
+        return !blocks.empty();
+    }
+
+    /**
+     * Resolve the name of a register (as used by the corpus format) to a physical register of the target.
+     *
+     * @param const TargetRegisterInfo* TRI The register information of the target.
+     * @param StringRef name The lowercase name of the register (e.g. `rax` or `x29`).
+     * @return MCRegister The physical register (or an invalid register if the name is unknown).
+     */
+    static MCRegister getRegister(const TargetRegisterInfo* TRI, StringRef name) {
+        static std::map<const TargetRegisterInfo*, StringMap<MCRegister>> registers;
+        StringMap<MCRegister>& names = registers[TRI];
+
+        if (names.empty()) {
+            for (unsigned reg = 1; reg < TRI->getNumRegs(); reg++) {
+                names[StringRef(TRI->getName(reg)).lower()] = reg;
+            }
+
+            // The corpus names some registers differently than LLVM does
+            const char* aliases[][2] = { { "x29", "fp" }, { "x30", "lr" } };
+
+            for (const auto& alias : aliases) {
+                if (names.count(alias[1])) names[alias[0]] = names[alias[1]];
+            }
+        }
+
+        return names.lookup(name);
+    }
+
+    /**
+     * Determine the register footprint that noise may have at an insertion point.
+     *
+     * @param const LivePhysRegs& live The registers that are live at the insertion point.
+     * @param const MachineRegisterInfo& MRI The register information of the machine function.
+     * @return uint64_t The footprint bits of all registers that are neither live nor reserved.
+     */
+    uint64_t getAllowedFootprint(const LivePhysRegs& live, const MachineRegisterInfo& MRI) const {
+        const TargetRegisterInfo* TRI = MRI.getTargetRegisterInfo();
+        uint64_t result = 0;
+
+        auto isAvailable = [&](StringRef name) {
+            MCRegister reg = getRegister(TRI, name);
+            return reg && live.available(MRI, reg);
+        };
+
+        for (int bit = 0; bit < 64; bit++) {
+            const char* name = NoiseCorpusFormat::getRegisterName(arm64, bit);
+            if (name && isAvailable(name)) result |= (1ULL << bit);
+        }
+
+        if (isAvailable(arm64 ? "nzcv" : "eflags")) {
+            result |= 1ULL << (arm64 ? NoiseCorpusFormat::BIT_FLAGS_ARM64 : NoiseCorpusFormat::BIT_FLAGS_AMD64);
+        }
+
+        bool vectorsAvailable = true;
+        for (unsigned index = 0; index < (arm64 ? 32 : 16); index++) {
+            vectorsAvailable = vectorsAvailable && isAvailable((arm64 ? "q" : "xmm") + std::to_string(index));
+        }
+
+        if (vectorsAvailable) {
+            result |= 1ULL << (arm64 ? NoiseCorpusFormat::BIT_VECTOR_ARM64 : NoiseCorpusFormat::BIT_VECTOR_AMD64);
+        }
+
+        return result;
+    }
+
+    /**
+     * Sample a random block that only writes to allowed registers.
+     *
+     * @param uint64_t allowed The allowed register footprint (see `getAllowedFootprint`).
+     * @param unsigned maximumInstructions The maximum amount of instructions of the block.
+     * @return std::optional<NoiseBlock> The block (if any block is compatible).
+     */
+    std::optional<NoiseBlock> sample(uint64_t allowed, unsigned maximumInstructions) {
+        auto query = std::make_pair(allowed, maximumInstructions);
+        auto cached = compatibleBuckets.find(query);
+
+        if (cached == compatibleBuckets.end()) {
+            CompatibleBuckets compatible;
+            uint64_t total = 0;
+
+            for (const FootprintBuckets& footprint : footprints) {
+                if ((footprint.footprint & ~allowed) != 0) continue;
+
+                for (uint32_t index : footprint.indexes) {
+                    const NoiseCorpusBucket& bucket = buckets[index];
+                    if (bucket.instructionCount > maximumInstructions) break;
+
+                    total += std::max<uint64_t>(bucket.count, 1);
+                    compatible.indexes.push_back(index);
+                    compatible.cumulativeCounts.push_back(total);
+                }
+            }
+
+            cached = compatibleBuckets.emplace(query, std::move(compatible)).first;
+        }
+
+        const CompatibleBuckets& compatible = cached->second;
+        if (compatible.indexes.empty()) return std::nullopt;
+
+        std::mt19937& generator = RandomHelper::getRandomGenerator();
+        size_t picked = std::uniform_int_distribution<size_t>(0, compatible.indexes.size() - 1)(generator);
+
+        if (samplingByFrequency()) {
+            uint64_t target = std::uniform_int_distribution<uint64_t>(0, compatible.cumulativeCounts.back() - 1)(generator);
+            picked = std::upper_bound(compatible.cumulativeCounts.begin(), compatible.cumulativeCounts.end(), target) - compatible.cumulativeCounts.begin();
+        }
+
+        const NoiseCorpusBucket& bucket = buckets[compatible.indexes[picked]];
+        const NoiseCorpusBlock& block = sampleBlock(bucket);
+
+        // Validate the picked block only (the corpus is never parsed as a whole)
+        uint64_t end = (uint64_t) block.offset + block.instructionCount + block.size;
+        if (block.instructionCount == 0 || end > bytes.size()) return std::nullopt;
+
+        NoiseBlock result = { bytes.slice(block.offset, block.instructionCount), bytes.slice(block.offset + block.instructionCount, block.size) };
+
+        size_t total = 0;
+        for (uint8_t length : result.lengths) total += length;
+        if (total != block.size) return std::nullopt;
+
+        return result;
+    }
+
+};
@@ -0,0 +1,333 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/RegisterClassInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <vector>
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * Estimates register pressure before register allocation (in the style of `RegPressureTracker`).
+ *
+ * The machine transpiler runs right before `regallocfast`, which spills every value that is live
+ * across blocks. Register pressure is therefore estimated per block, by a backward liveness scan
+ * of the (virtual and physical) registers in that block, per register pressure set.
+ *
+ * Each block is scanned once (on the first query), after which the pressure across its instructions
+ * is kept up to date incrementally as substitutions replace instructions (see `update`).
+ */
+class RegisterPressureHelper {
+
+private:
+
+    /**
+     * The machine function that is being transformed.
+     */
+    MachineFunction& MF;
+
+    /**
+     * Allocatable registers (and pressure set limits) of the target, excluding reserved registers.
+     */
+    RegisterClassInfo RCI;
+
+    /**
+     * The pressure across every instruction of the blocks that were scanned (per pressure set).
+     */
+    DenseMap<const MachineInstr*, std::vector<unsigned>> pressureAcross;
+    SmallPtrSet<const MachineBasicBlock*, 16> scannedBlocks;
+
+    /**
+     * The instruction that is being substituted, its block, the pressure across it and the registers it referenced.
+     */
+    const MachineInstr* pendingInstruction = nullptr;
+    const MachineBasicBlock* pendingBlock = nullptr;
+    std::vector<unsigned> pendingPressure;
+    SmallVector<Register, 4> pendingRegisters;
+
+    /**
+     * Add the weight of a register to the pressure sets it belongs to.
+     *
+     * @param Register reg The register to add.
+     * @param std::vector<unsigned>& pressure The pressure per pressure set.
+     */
+    void addPressure(Register reg, std::vector<unsigned>& pressure) {
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+        const MachineRegisterInfo& MRI = MF.getRegInfo();
+
+        const TargetRegisterClass* registerClass = reg.isVirtual() ? MRI.getRegClass(reg) : TRI->getMinimalPhysRegClass(reg);
+        addPressure(registerClass, pressure);
+    }
+
+    /**
+     * Remove the weight of a register from the pressure sets it belongs to.
+     *
+     * @param Register reg The register to remove.
+     * @param std::vector<unsigned>& pressure The pressure per pressure set.
+     */
+    void removePressure(Register reg, std::vector<unsigned>& pressure) {
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+        const MachineRegisterInfo& MRI = MF.getRegInfo();
+
+        const TargetRegisterClass* registerClass = reg.isVirtual() ? MRI.getRegClass(reg) : TRI->getMinimalPhysRegClass(reg);
+        addPressure(registerClass, pressure, -1);
+    }
+
+    /**
+     * Add the weight of a register of the given class to the pressure sets of that class.
+     *
+     * @param const TargetRegisterClass* registerClass The class of the register.
+     * @param std::vector<unsigned>& pressure The pressure per pressure set.
+     * @param int direction Positive to add the weight, negative to remove it.
+     */
+    void addPressure(const TargetRegisterClass* registerClass, std::vector<unsigned>& pressure, int direction = 1) {
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+        unsigned weight = TRI->getRegClassWeight(registerClass).RegWeight;
+
+        for (const int* set = TRI->getRegClassPressureSets(registerClass); *set != -1; ++set) {
+            pressure[*set] = (direction > 0) ? (pressure[*set] + weight) : (pressure[*set] - std::min(pressure[*set], weight));
+        }
+    }
+
+    /**
+     * Estimate the pressure across every instruction of a block, in a single backward liveness scan.
+     *
+     * The pressure across an instruction includes the registers that are live after it, and the registers
+     * it reads & writes. Values that are live across blocks are spilled, so the scan starts empty.
+     *
+     * @param const MachineBasicBlock& MBB The block to scan.
+     */
+    void scanBlock(const MachineBasicBlock& MBB) {
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+        SmallVector<Register, 32> live;
+        std::vector<unsigned> livePressure(TRI->getNumRegPressureSets(), 0);
+
+        for (const MachineInstr& Instruction : reverse(MBB)) {
+            std::vector<unsigned> across = livePressure;
+            SmallVector<Register, 8> referenced;
+
+            // Registers read & written by the instruction itself
+            for (const MachineOperand& operand : Instruction.operands()) {
+                if (operand.isReg() && isTracked(operand.getReg()) && !is_contained(live, operand.getReg()) && !is_contained(referenced, operand.getReg())) {
+                    referenced.push_back(operand.getReg());
+                    addPressure(operand.getReg(), across);
+                }
+            }
+
+            pressureAcross[&Instruction] = std::move(across);
+
+            for (const MachineOperand& operand : Instruction.operands()) {
+                if (operand.isReg() && operand.isDef() && !operand.isImplicit() && is_contained(live, operand.getReg())) {
+                    live.erase(std::remove(live.begin(), live.end(), operand.getReg()), live.end());
+                    removePressure(operand.getReg(), livePressure);
+                }
+            }
+
+            for (const MachineOperand& operand : Instruction.operands()) {
+                if (operand.isReg() && operand.isUse() && isTracked(operand.getReg()) && !is_contained(live, operand.getReg())) {
+                    live.push_back(operand.getReg());
+                    addPressure(operand.getReg(), livePressure);
+                }
+            }
+        }
+
+        scannedBlocks.insert(&MBB);
+    }
+
+    /**
+     * Add the live range of a register that an instruction references, from the previous reference of the
+     * register in the block up to that instruction, to the pressure across the instructions in that range.
+     *
+     * Registers that are not referenced earlier in the block are live-in, and are reloaded right before the
+     * instruction, so they only add to the pressure across the instruction itself.
+     *
+     * @param MachineInstr& Instruction The instruction that references the register.
+     * @param Register reg The register.
+     */
+    void addLiveRange(MachineInstr& Instruction, Register reg) {
+        SmallVector<const MachineInstr*, 16> range;
+        bool referenced = false;
+
+        if (Instruction.readsRegister(reg)) {
+            for (auto it = std::next(Instruction.getReverseIterator()); it != Instruction.getParent()->rend() && !referenced; ++it) {
+                referenced = it->readsRegister(reg) || it->modifiesRegister(reg);
+                if (!referenced) range.push_back(&*it);
+            }
+        }
+
+        if (!referenced) range.clear();
+        range.push_back(&Instruction);
+
+        for (const MachineInstr* instruction : range) {
+            addPressure(reg, pressureAcross[instruction]);
+        }
+    }
+
+    /**
+     * Check if a register occupies an allocatable register (virtual, or a non-reserved physical register).
+     *
+     * @param Register reg The register to check.
+     * @return bool Positive if the register adds to the register pressure.
+     */
+    bool isTracked(Register reg) {
+        if (!reg) return false;
+        if (reg.isVirtual()) return true;
+
+        return MF.getRegInfo().isAllocatable(reg.asMCReg());
+    }
+
+public:
+
+    /**
+     * Constructor that determines the allocatable registers of the machine function.
+     *
+     * @param MachineFunction& MF The machine function that is being transformed.
+     */
+    RegisterPressureHelper(MachineFunction& MF) : MF(MF) {
+        if (!MF.getRegInfo().reservedRegsFrozen()) {
+            MF.getRegInfo().freezeReservedRegs(MF);
+        }
+
+        RCI.runOnMachineFunction(MF);
+    }
+
+    /**
+     * Estimate the register pressure across the given instruction (per pressure set).
+     *
+     * This includes the registers that are live after the instruction, and the registers it reads & writes.
+     * The block is scanned on the first query, and again if it contains instructions that were not tracked.
+     *
+     * @param const MachineInstr& Instruction The instruction to estimate the register pressure at.
+     * @return const std::vector<unsigned>& The pressure per pressure set.
+     */
+    const std::vector<unsigned>& getPressureAcross(const MachineInstr& Instruction) {
+        auto pressure = pressureAcross.find(&Instruction);
+
+        if (!scannedBlocks.count(Instruction.getParent()) || pressure == pressureAcross.end()) {
+            scanBlock(*Instruction.getParent());
+            pressure = pressureAcross.find(&Instruction);
+        }
+
+        return pressure->second;
+    }
+
+    /**
+     * Remember the pressure across an instruction that is about to be substituted, so that the pressure
+     * across the substitution can be derived from it by `update`.
+     *
+     * @param const MachineInstr& Instruction The instruction that is about to be substituted.
+     */
+    void prepareUpdate(const MachineInstr& Instruction) {
+        pendingBlock = nullptr;
+
+        // Blocks that were not scanned yet will include the substitution once they are
+        auto pressure = pressureAcross.find(&Instruction);
+        if (!scannedBlocks.count(Instruction.getParent()) || pressure == pressureAcross.end()) return;
+
+        pendingInstruction = &Instruction;
+        pendingBlock = Instruction.getParent();
+        pendingPressure = pressure->second;
+        pendingRegisters.clear();
+
+        for (const MachineOperand& operand : Instruction.operands()) {
+            if (operand.isReg() && operand.getReg()) pendingRegisters.push_back(operand.getReg());
+        }
+    }
+
+    /**
+     * Update the pressure after the instruction passed to `prepareUpdate` was substituted.
+     *
+     * The substitution inherits the pressure across the original instruction. Virtual registers that it
+     * introduces (e.g. keys), or that it reads again (e.g. a shared key or a reused decoded constant),
+     * add their live range within the block. Blocks that instructions were hoisted into are scanned again.
+     *
+     * @param ArrayRef<MachineInstr*> emitted The instructions of the substitution (in program order).
+     */
+    void update(ArrayRef<MachineInstr*> emitted) {
+        if (!pendingBlock) return;
+
+        const MachineBasicBlock* MBB = pendingBlock;
+        SmallVector<MachineInstr*, 8> inBlock;
+        SmallVector<Register, 8> added;
+
+        pendingBlock = nullptr;
+        pressureAcross.erase(pendingInstruction);
+
+        for (MachineInstr* instruction : emitted) {
+            if (instruction->getParent() != MBB) {
+                scannedBlocks.erase(instruction->getParent());
+                continue;
+            }
+
+            inBlock.push_back(instruction);
+            pressureAcross[instruction] = pendingPressure;
+
+            for (const MachineOperand& operand : instruction->operands()) {
+                if (!operand.isReg() || !operand.getReg().isVirtual()) continue;
+                if (is_contained(pendingRegisters, operand.getReg()) || is_contained(added, operand.getReg())) continue;
+
+                added.push_back(operand.getReg());
+            }
+        }
+
+        for (Register reg : added) {
+            for (MachineInstr* instruction : inBlock) {
+                if (instruction->readsRegister(reg) || instruction->modifiesRegister(reg)) addLiveRange(*instruction, reg);
+            }
+        }
+    }
+
+    /**
+     * Check if keeping an additional register of the given class live across the instruction would exceed
+     * the allocatable registers of the target (and thus cause additional spills & reloads).
+     *
+     * @param const MachineInstr& Instruction The instruction the additional register is live across.
+     * @param const TargetRegisterClass* registerClass The class of the additional register.
+     * @return bool Positive if the limit of any pressure set of the class would be exceeded.
+     */
+    bool exceedsLimit(const MachineInstr& Instruction, const TargetRegisterClass* registerClass) {
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+
+        std::vector<unsigned> pressure = getPressureAcross(Instruction);
+        addPressure(registerClass, pressure);
+
+        for (const int* set = TRI->getRegClassPressureSets(registerClass); *set != -1; ++set) {
+            if (pressure[*set] > RCI.getRegPressureSetLimit(*set)) return true;
+        }
+
+        return false;
+    }
+
+};
@@ -0,0 +1,1066 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineBranchProbabilityInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+/**
+ * Regular includes
+ */
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <numeric>
+#include <random>
+#include <string>
+#include <tuple>
+#include "CostModelHelper.cpp"
+#include "GrowthBudgetHelper.cpp"
+#include "RegisterPressureHelper.cpp"
+#include "TransformOptionRegistry.cpp"
+#include "../../../shared/helpers/RandomHelper.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * State that is shared by all modules while they transform one machine function.
+ *
+ * It exposes the loop & block frequency analyses, so that modules can lower the density of their
+ * transformations in hot code (e.g. inner loops), it hoists decoded constants of substitutions
+ * into loop preheaders, and it keeps track of the estimated overhead.
+ */
+class TransformContext {
+
+public:
+
+    /**
+     * Possible outcomes of the register pressure check of a substitution.
+     */
+    enum class PressureDecision {
+        Keep,      // Emit the substitution as-is
+        Downgrade, // Emit a form that doesn't need an additional register (e.g. an immediate key)
+        Skip       // Don't substitute the instruction at all
+    };
+
+    /**
+     * An instruction that a module wants to substitute, and the option it picked for it.
+     */
+    struct Candidate {
+        MachineInstr* instruction;
+        const TransformOption* option;
+        size_t optionCount; // Amount of options that were able to substitute the instruction
+    };
+
+private:
+
+    /**
+     * The machine function that is being transformed.
+     */
+    MachineFunction& MF;
+
+    /**
+     * Loop information of the machine function.
+     */
+    MachineLoopInfo& MLI;
+
+    /**
+     * Block frequency information of the machine function.
+     */
+    MachineBlockFrequencyInfo& MBFI;
+
+    /**
+     * Branch probability information of the machine function.
+     */
+    MachineBranchProbabilityInfo& MBPI;
+
+    /**
+     * Whether the rewrite probability is lowered in hot blocks.
+     */
+    bool loopAwareDensity;
+
+    /**
+     * How strongly the rewrite probability is lowered relative to the block frequency.
+     */
+    double densityFactor;
+
+    /**
+     * Whether loop-invariant instructions of substitutions are hoisted into loop preheaders.
+     */
+    bool hoistLoopInvariants;
+
+    /**
+     * Whether keys are shared by runs of adjacent substitutions, and decoded constants are reused.
+     */
+    bool amortizeKeys;
+
+    /**
+     * Whether substitutions are downgraded or skipped in blocks under register pressure.
+     */
+    bool registerPressureAware;
+
+    /**
+     * Register pressure estimates of the machine function.
+     */
+    RegisterPressureHelper pressure;
+
+    /**
+     * The cost profile of the target (used to estimate instruction sizes & cycles).
+     */
+    const CostProfile& profile;
+
+    /**
+     * Code growth of the machine function (and payload) against the `MM_MAX_GROWTH` budget.
+     */
+    GrowthBudgetHelper budget;
+
+    /**
+     * Amount of substitutions that were skipped because they didn't fit in the growth budget.
+     */
+    unsigned overBudget = 0;
+
+    /**
+     * Amount of instructions added by substitutions (static).
+     */
+    double staticOverhead = 0;
+
+    /**
+     * Amount of instructions added by substitutions, weighted by block frequency (dynamic, per invocation).
+     */
+    double dynamicOverhead = 0;
+
+    /**
+     * Amount of substitutions that were performed.
+     */
+    unsigned substitutions = 0;
+
+    /**
+     * Amount of substitutions that were skipped because of the block frequency.
+     */
+    unsigned skipped = 0;
+
+    /**
+     * Amount of instructions that were hoisted into loop preheaders.
+     */
+    unsigned hoisted = 0;
+
+    /**
+     * Amount of keys in loops that were folded into an immediate instead of being hoisted.
+     */
+    unsigned foldedKeys = 0;
+
+    /**
+     * Instructions that were emitted by substitutions (and thus must not be substituted again).
+     */
+    SmallPtrSet<const MachineInstr*, 32> emittedInstructions;
+
+    /**
+     * Amount of substitutions that shared the key of the previous (adjacent) substitution.
+     */
+    unsigned sharedKeys = 0;
+
+    /**
+     * Amount of substitutions that reused an earlier decoded constant.
+     */
+    unsigned reusedConstants = 0;
+
+    /**
+     * Amount of substitutions that had enough register headroom.
+     */
+    unsigned pressureKept = 0;
+
+    /**
+     * Amount of substitutions that were downgraded because of register pressure.
+     */
+    unsigned pressureDowngraded = 0;
+
+    /**
+     * Amount of substitutions that were skipped because of register pressure.
+     */
+    unsigned pressureSkipped = 0;
+
+    /**
+     * Amount of redundant instructions that were removed after register allocation.
+     */
+    unsigned removed = 0;
+
+    /**
+     * The key register of the current run of adjacent substitutions.
+     */
+    struct {
+        const MachineBasicBlock* block = nullptr;
+        const MachineInstr* end = nullptr;
+        Register reg;
+        size_t value = 0;
+        bool used = false;
+    } runKey;
+
+    /**
+     * Registers holding decoded constants, by block, width (in bits) and immediate value of the original `mov`.
+     */
+    std::map<std::tuple<const MachineBasicBlock*, unsigned, int64_t>, Register> decodedConstants;
+
+    /**
+     * Whether the rewrite probability should be lowered in hot blocks (default) or not.
+     *
+     * @returns bool Positive if enabled.
+     */
+    static bool loopAwareDensityIsEnabled() {
+        const char* MM_LOOP_AWARE_DENSITY = std::getenv("MM_LOOP_AWARE_DENSITY");
+        return !MM_LOOP_AWARE_DENSITY || std::string(MM_LOOP_AWARE_DENSITY) != "false";
+    }
+
+    /**
+     * Retrieve how strongly the rewrite probability is lowered in hot blocks (default 1.0).
+     *
+     * A factor of 1.0 makes the rewrite probability inversely proportional to the block frequency, so
+     * that the expected dynamic overhead of every block is equal to that of the entry block.
+     *
+     * @returns double The density factor.
+     */
+    static double getDensityFactor() {
+        const char* MM_LOOP_DENSITY_FACTOR = std::getenv("MM_LOOP_DENSITY_FACTOR");
+        if (!MM_LOOP_DENSITY_FACTOR) return 1.0;
+
+        double result = std::atof(MM_LOOP_DENSITY_FACTOR);
+        return (result < 0) ? 0 : result;
+    }
+
+    /**
+     * Whether loop-invariant instructions of substitutions should be hoisted into loop preheaders (default) or not.
+     *
+     * @returns bool Positive if enabled.
+     */
+    static bool loopInvariantHoistingIsEnabled() {
+        const char* MM_HOIST_LOOP_INVARIANTS = std::getenv("MM_HOIST_LOOP_INVARIANTS");
+        return !MM_HOIST_LOOP_INVARIANTS || std::string(MM_HOIST_LOOP_INVARIANTS) != "false";
+    }
+
+    /**
+     * Whether keys & decoded constants should be reused by adjacent or repeated substitutions (default) or not.
+     *
+     * @returns bool Positive if enabled.
+     */
+    static bool keyAmortizationIsEnabled() {
+        const char* MM_AMORTIZE_KEYS = std::getenv("MM_AMORTIZE_KEYS");
+        return !MM_AMORTIZE_KEYS || std::string(MM_AMORTIZE_KEYS) != "false";
+    }
+
+    /**
+     * Whether substitutions should respect the register pressure of their block (default) or not.
+     *
+     * @returns bool Positive if enabled.
+     */
+    static bool registerPressureAwarenessIsEnabled() {
+        const char* MM_REGISTER_PRESSURE_AWARE = std::getenv("MM_REGISTER_PRESSURE_AWARE");
+        return !MM_REGISTER_PRESSURE_AWARE || std::string(MM_REGISTER_PRESSURE_AWARE) != "false";
+    }
+
+    /**
+     * Check if an instruction moves an immediate value into a register (e.g. `mov reg, imm`).
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction is a register move of an immediate.
+     */
+    static bool isRegMovImmediate(const MachineInstr& instruction) {
+        if (!instruction.isMoveImmediate() || instruction.mayLoadOrStore() || instruction.getNumOperands() < 2) return false;
+
+        const MachineOperand& destination = instruction.getOperand(0);
+        return destination.isReg() && destination.isDef() && !destination.getSubReg() && instruction.getOperand(1).isImm();
+    }
+
+    /**
+     * Check if an instruction only stores an immediate value into a stack slot (e.g. `mov [rbp+var], imm`).
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction is a stack move of an immediate.
+     */
+    static bool isStackMovImmediate(const MachineInstr& instruction) {
+        if (!instruction.mayStore() || instruction.mayLoad() || !instruction.hasOneMemOperand() || instruction.getNumOperands() < 2) return false;
+
+        return instruction.getOperand(0).isFI() && instruction.getOperand(instruction.getNumOperands() - 1).isImm();
+    }
+
+    /**
+     * Retrieve the width (in bits) of the value that a register or stack move of an immediate writes.
+     *
+     * @param const MachineInstr& instruction The register or stack move of an immediate.
+     * @return unsigned The width in bits, or zero if the instruction is neither.
+     */
+    unsigned getImmediateWidth(const MachineInstr& instruction) {
+        if (isStackMovImmediate(instruction)) {
+            return 8 * (*instruction.memoperands_begin())->getSize();
+        }
+
+        if (isRegMovImmediate(instruction)) {
+            const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+            return TRI->getRegSizeInBits(instruction.getOperand(0).getReg(), MF.getRegInfo());
+        }
+
+        return 0;
+    }
+
+    /**
+     * Retrieve the immediate value of a register or stack move, truncated to the given width, so that equal
+     * constants compare equal regardless of how the instruction encodes them (e.g. sign or zero extended).
+     *
+     * @param const MachineInstr& instruction The register or stack move of an immediate.
+     * @param unsigned bits The width of the value.
+     * @return int64_t The truncated immediate value.
+     */
+    static int64_t getTruncatedImmediate(const MachineInstr& instruction, unsigned bits) {
+        int64_t immediateValue = isStackMovImmediate(instruction) ? instruction.getOperand(instruction.getNumOperands() - 1).getImm() : instruction.getOperand(1).getImm();
+        return (bits >= 64) ? immediateValue : (int64_t) ((uint64_t) immediateValue & ((1ULL << bits) - 1));
+    }
+
+    /**
+     * Check if a register or stack move of the given immediate value occurs again later in the block.
+     *
+     * @param MachineBasicBlock::const_iterator from The instruction to start searching at.
+     * @param const MachineBasicBlock& MBB The block to search in.
+     * @param unsigned bits The width of the immediate value.
+     * @param int64_t immediateValue The (truncated) immediate value.
+     * @return bool Positive if the immediate value recurs.
+     */
+    bool immediateRecurs(MachineBasicBlock::const_iterator from, const MachineBasicBlock& MBB, unsigned bits, int64_t immediateValue) {
+        for (auto it = from; it != MBB.end(); ++it) {
+            if (emittedInstructions.count(&*it) || getImmediateWidth(*it) != bits) continue;
+            if (getTruncatedImmediate(*it, bits) == immediateValue) return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * Collect the instructions that a register would additionally be live across, if it were read by the
+     * given instruction: those since its previous reference in the block, up to and including the instruction.
+     *
+     * @param const MachineInstr& Instruction The instruction that would read the register.
+     * @param Register reg The register.
+     * @return SmallVector<const MachineInstr*, 16> The instructions of the extended live range.
+     */
+    static SmallVector<const MachineInstr*, 16> getExtendedLiveRange(const MachineInstr& Instruction, Register reg) {
+        SmallVector<const MachineInstr*, 16> result = { &Instruction };
+
+        for (auto it = std::next(Instruction.getReverseIterator()); it != Instruction.getParent()->rend(); ++it) {
+            if (it->readsRegister(reg) || it->modifiesRegister(reg)) break;
+            result.push_back(&*it);
+        }
+
+        return result;
+    }
+
+    /**
+     * Find the preheader of the outermost loop that contains the given block.
+     *
+     * The preheader of any enclosing loop dominates the block, so constants that are materialized
+     * there are available on every iteration of all enclosing loops.
+     *
+     * @param const MachineBasicBlock& MBB The block that is (possibly) part of a loop.
+     * @return MachineBasicBlock* The preheader, or a null pointer if the block is not in a loop with a preheader.
+     */
+    MachineBasicBlock* getOutermostPreheader(const MachineBasicBlock& MBB) {
+        MachineBasicBlock* result = nullptr;
+
+        for (MachineLoop* loop = MLI.getLoopFor(&MBB); loop; loop = loop->getParentLoop()) {
+            if (MachineBasicBlock* preheader = loop->getLoopPreheader()) {
+                result = preheader;
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Check if an instruction only computes a value from its (register) operands, without any side effects.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be executed speculatively.
+     */
+    static bool isPureComputation(const MachineInstr& instruction) {
+        if (instruction.mayLoadOrStore() || instruction.hasUnmodeledSideEffects()) return false;
+        if (instruction.isCall() || instruction.isTerminator() || instruction.isPHI()) return false;
+
+        for (const MachineOperand& operand : instruction.operands()) {
+            if (!operand.isReg() && !operand.isImm()) return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Check if all physical registers that are clobbered by the given instructions are dead at the insertion point.
+     *
+     * @param ArrayRef<MachineInstr*> instructions The instructions to check.
+     * @param MachineBasicBlock& preheader The block the instructions would be moved to.
+     * @param MachineBasicBlock::iterator insertionPoint The position the instructions would be moved to.
+     * @param Register except A physical register that is allowed to be clobbered (e.g. a renamed destination).
+     * @return bool Positive if no live physical register would be clobbered.
+     */
+    bool clobbersAreDead(ArrayRef<MachineInstr*> instructions, MachineBasicBlock& preheader, MachineBasicBlock::iterator insertionPoint, Register except) {
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+
+        for (MachineInstr* instruction : instructions) {
+            for (const MachineOperand& operand : instruction->operands()) {
+                if (!operand.isReg() || !operand.getReg().isPhysical() || operand.getReg() == except) continue;
+
+                // Physical registers may only be clobbered (e.g. flags), never read
+                if (operand.isUse()) return false;
+
+                if (preheader.computeRegisterLiveness(TRI, operand.getReg().asMCReg(), insertionPoint) != MachineBasicBlock::LQR_Dead) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Compute the decoded constant of a substitution into a new virtual register, and replace the
+     * substitution by a copy of that register.
+     *
+     * If a preheader is given, the computation is hoisted into it, so that the loop only contains the copy.
+     * This is only legal if the substitution purely computes one destination register from immediates.
+     *
+     * @param SmallVectorImpl<MachineInstr*>& emitted The instructions of the substitution (updated in place).
+     * @param MachineBasicBlock::iterator next The instruction that followed the substitution.
+     * @param MachineBasicBlock* preheader The preheader to hoist into, or a null pointer to keep the computation in place.
+     * @return Register The register holding the decoded constant, or an invalid register if not possible.
+     */
+    Register isolateDecodedConstant(SmallVectorImpl<MachineInstr*>& emitted, MachineBasicBlock::iterator next, MachineBasicBlock* preheader) {
+        const TargetInstrInfo* TII = MF.getSubtarget().getInstrInfo();
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+        MachineRegisterInfo& MRI = MF.getRegInfo();
+
+        // The destination is the (explicit) definition of the last instruction
+        MachineInstr* last = emitted.back();
+        if (last->getNumOperands() == 0 || !last->getOperand(0).isReg() || !last->getOperand(0).isDef()) return Register();
+
+        Register destinationRegister = last->getOperand(0).getReg();
+        const TargetRegisterClass* registerClass = destinationRegister.isVirtual()
+            ? MRI.getRegClass(destinationRegister)
+            : TII->getRegClass(last->getDesc(), 0, TRI, MF);
+
+        if (!registerClass) return Register();
+
+        SmallVector<Register, 8> defined;
+
+        for (MachineInstr* instruction : emitted) {
+            if (!isPureComputation(*instruction)) return Register();
+
+            for (const MachineOperand& operand : instruction->operands()) {
+                if (!operand.isReg() || !operand.getReg()) continue;
+                Register reg = operand.getReg();
+
+                // Partial (sub-)register accesses of the destination can't be renamed
+                if (reg != destinationRegister && destinationRegister.isPhysical() && reg.isPhysical() && TRI->regsOverlap(reg, destinationRegister)) return Register();
+                if (operand.getSubReg()) return Register();
+
+                // Every register that is read must have been computed by the substitution itself
+                if (operand.isUse() && !is_contained(defined, reg)) return Register();
+            }
+
+            for (const MachineOperand& operand : instruction->operands()) {
+                if (operand.isReg() && operand.isDef() && operand.getReg()) defined.push_back(operand.getReg());
+            }
+        }
+
+        // Other virtual registers must not be used outside of the substitution
+        for (Register reg : defined) {
+            if (reg == destinationRegister || reg.isPhysical()) continue;
+
+            for (const MachineInstr& user : MRI.reg_instructions(reg)) {
+                if (!is_contained(emitted, &user)) return Register();
+            }
+        }
+
+        MachineBasicBlock::iterator insertionPoint = preheader ? preheader->getFirstTerminator() : next;
+        if (preheader && !clobbersAreDead(emitted, *preheader, insertionPoint, destinationRegister)) return Register();
+
+        // Compute the decoded constant into a new virtual register
+        Register constantRegister = MRI.createVirtualRegister(registerClass);
+        MachineBasicBlock& MBB = *last->getParent();
+
+        for (MachineInstr* instruction : emitted) {
+            for (MachineOperand& operand : instruction->operands()) {
+                if (operand.isReg() && operand.getReg() == destinationRegister) {
+                    operand.setReg(constantRegister);
+                    if (operand.isUse()) operand.setIsKill(false);
+                }
+            }
+
+            if (preheader) preheader->splice(insertionPoint, &MBB, instruction->getIterator());
+        }
+
+        MachineInstr* copy = BuildMI(MBB, next, emitted.front()->getDebugLoc(), TII->get(TargetOpcode::COPY), destinationRegister).addReg(constantRegister);
+
+        if (preheader) {
+            dbgs() << "          ↳ Hoisted decoded constant into preheader `" << preheader->getName() << "`.\n";
+            hoisted += emitted.size();
+        }
+
+        emitted.push_back(copy);
+        return constantRegister;
+    }
+
+public:
+
+    /**
+     * Constructor that initializes the context for a machine function.
+     *
+     * @param MachineFunction& MF The machine function that is being transformed.
+     * @param MachineLoopInfo& MLI Loop information of the machine function.
+     * @param MachineBlockFrequencyInfo& MBFI Block frequency information of the machine function.
+     * @param MachineBranchProbabilityInfo& MBPI Branch probability information of the machine function.
+     */
+    TransformContext(MachineFunction& MF, MachineLoopInfo& MLI, MachineBlockFrequencyInfo& MBFI, MachineBranchProbabilityInfo& MBPI) :
+        MF(MF), MLI(MLI), MBFI(MBFI), MBPI(MBPI), loopAwareDensity(loopAwareDensityIsEnabled()), densityFactor(getDensityFactor()), hoistLoopInvariants(loopInvariantHoistingIsEnabled()), amortizeKeys(keyAmortizationIsEnabled()),
+        registerPressureAware(registerPressureAwarenessIsEnabled()), pressure(MF), profile(CostModelHelper::getProfile(MF)), budget(MF) { }
+
+    /**
+     * Retrieve the loop information of the machine function.
+     *
+     * @return MachineLoopInfo& The loop information.
+     */
+    MachineLoopInfo& getLoopInfo() {
+        return MLI;
+    }
+
+    /**
+     * Retrieve the block frequency information of the machine function.
+     *
+     * @return MachineBlockFrequencyInfo& The block frequency information.
+     */
+    MachineBlockFrequencyInfo& getBlockFrequencyInfo() {
+        return MBFI;
+    }
+
+    /**
+     * Retrieve the branch probability information of the machine function.
+     *
+     * @return MachineBranchProbabilityInfo& The branch probability information.
+     */
+    MachineBranchProbabilityInfo& getBranchProbabilityInfo() {
+        return MBPI;
+    }
+
+    /**
+     * Estimate how often a block is executed per invocation of the machine function.
+     *
+     * Falls back to the loop depth (assuming 8 iterations per loop) if no frequency information is available.
+     *
+     * @param const MachineBasicBlock& MBB The block to estimate the frequency of.
+     * @return double The estimated frequency relative to the entry block.
+     */
+    double getRelativeFrequency(const MachineBasicBlock& MBB) {
+        double result = MBFI.getBlockFreqRelativeToEntryBlock(&MBB);
+
+        if (!std::isfinite(result)) {
+            result = std::pow(8.0, MLI.getLoopDepth(&MBB));
+        }
+
+        return result;
+    }
+
+    /**
+     * Decide whether an instruction in the given block should be modified.
+     *
+     * The probability is inversely proportional to the (configurable) relative block frequency, so the
+     * runtime overhead of metamorphication concentrates in cold code. Blocks that are executed at most
+     * once per invocation are always modified.
+     *
+     * @param const MachineBasicBlock& MBB The block of the instruction.
+     * @return bool Positive if the instruction should be modified.
+     */
+    bool shouldModify(const MachineBasicBlock& MBB) {
+        if (!loopAwareDensity) return true;
+
+        double frequency = getRelativeFrequency(MBB);
+        if (frequency <= 1.0) return true;
+
+        double probability = 1.0 / (1.0 + densityFactor * (frequency - 1.0));
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+        if (dist(RandomHelper::getRandomGenerator()) < probability) {
+            return true;
+        }
+
+        dbgs() << "          ↳ Skipping modification in hot block `" << MBB.getName() << "` (loop depth " << MLI.getLoopDepth(&MBB) << ", frequency " << format("%.2f", frequency) << ").\n";
+        skipped++;
+        return false;
+    }
+
+    /**
+     * Retrieve the key register of the current run of adjacent substitutions, if the given instruction
+     * directly follows that run and the key register is of the given class.
+     *
+     * Options that share the key must not emit their own key materialization.
+     *
+     * @param const MachineInstr& Instruction The instruction that is being substituted.
+     * @param const TargetRegisterClass* registerClass The register class the option needs for its key.
+     * @param size_t& keyValue Set to the value of the key (if it is shared).
+     * @return Register The key register, or an invalid register if there is no compatible run.
+     */
+    Register getRunKey(const MachineInstr& Instruction, const TargetRegisterClass* registerClass, size_t& keyValue) {
+        const MachineBasicBlock& MBB = *Instruction.getParent();
+
+        if (!amortizeKeys || !runKey.reg || runKey.block != &MBB || Instruction.getIterator() == MBB.begin()) return Register();
+        if (&*std::prev(Instruction.getIterator()) != runKey.end) return Register();
+        if (MF.getRegInfo().getRegClass(runKey.reg) != registerClass) return Register();
+
+        dbgs() << "          ↳ Sharing the key register of the current run of adjacent substitutions.\n";
+        keyValue = runKey.value;
+        runKey.used = true;
+        sharedKeys++;
+        return runKey.reg;
+    }
+
+    /**
+     * Decide how a substitution that needs an additional register (e.g. for its key) should be emitted,
+     * based on the register pressure across the instruction. Every decision is recorded in the statistics.
+     *
+     * Substitutions are downgraded (if possible) or skipped when the additional register would exceed the
+     * allocatable registers of the target, as `regallocfast` would then spill & reload around the substitution.
+     *
+     * @param const MachineInstr& Instruction The instruction that is being substituted.
+     * @param const TargetRegisterClass* registerClass The class of the additional register.
+     * @param bool canDowngrade Whether the option has a form that doesn't need the additional register.
+     * @return PressureDecision How the substitution should be emitted.
+     */
+    PressureDecision getPressureDecision(const MachineInstr& Instruction, const TargetRegisterClass* registerClass, bool canDowngrade) {
+        return getPressureDecision(ArrayRef<const MachineInstr*>(&Instruction), registerClass, canDowngrade);
+    }
+
+    /**
+     * Decide how a substitution that keeps an additional register live across several instructions (e.g. the
+     * extended live range of a reused decoded constant) should be emitted, based on the register pressure
+     * across each of these instructions. Every decision is recorded in the statistics.
+     *
+     * @param ArrayRef<const MachineInstr*> span The instructions the additional register is live across (non-empty, in one block).
+     * @param const TargetRegisterClass* registerClass The class of the additional register.
+     * @param bool canDowngrade Whether the option has a form that doesn't need the additional register.
+     * @return PressureDecision How the substitution should be emitted.
+     */
+    PressureDecision getPressureDecision(ArrayRef<const MachineInstr*> span, const TargetRegisterClass* registerClass, bool canDowngrade) {
+        if (!registerPressureAware || none_of(span, [&](const MachineInstr* instruction) { return pressure.exceedsLimit(*instruction, registerClass); })) {
+            pressureKept++;
+            return PressureDecision::Keep;
+        }
+
+        if (canDowngrade) {
+            dbgs() << "          ↳ Downgrading substitution in block `" << span.front()->getParent()->getName() << "` due to register pressure.\n";
+            pressureDowngraded++;
+            return PressureDecision::Downgrade;
+        }
+
+        dbgs() << "          ↳ Skipping substitution in block `" << span.front()->getParent()->getName() << "` due to register pressure.\n";
+        pressureSkipped++;
+        return PressureDecision::Skip;
+    }
+
+    /**
+     * Retrieve the register holding the decoded constant of an earlier substitution of the same immediate in
+     * the block of the given (register or stack) move, so that the move can use it instead of a substitution.
+     *
+     * The live range of the register is extended up to the move, so it is only reused if that doesn't exceed
+     * the allocatable registers of the target anywhere in the extended range.
+     *
+     * @param const MachineInstr& Instruction The register or stack move of an immediate.
+     * @param const TargetRegisterClass* registerClass The class the move needs, or a null pointer if any class of the same width will do (e.g. for a copy).
+     * @return Register The register holding the decoded constant, or an invalid register if there is none (or it can't be reused).
+     */
+    Register getDecodedConstant(const MachineInstr& Instruction, const TargetRegisterClass* registerClass) {
+        unsigned bits = getImmediateWidth(Instruction);
+        if (!amortizeKeys || !bits || MF.getProperties().hasProperty(MachineFunctionProperties::Property::NoVRegs)) return Register();
+
+        int64_t immediateValue = getTruncatedImmediate(Instruction, bits);
+        auto cached = decodedConstants.find(std::make_tuple(Instruction.getParent(), bits, immediateValue));
+        if (cached == decodedConstants.end()) return Register();
+
+        MachineRegisterInfo& MRI = MF.getRegInfo();
+        const TargetRegisterClass* constantRegisterClass = MRI.getRegClass(cached->second);
+        if (registerClass && !registerClass->hasSubClassEq(constantRegisterClass)) return Register();
+
+        if (getPressureDecision(getExtendedLiveRange(Instruction, cached->second), constantRegisterClass, false) != PressureDecision::Keep) return Register();
+
+        dbgs() << "          ✓ Reused decoded constant of an earlier substitution in this block.\n";
+        MRI.clearKillFlags(cached->second);
+        reusedConstants++;
+        return cached->second;
+    }
+
+    /**
+     * Check if the immediate of the given (register or stack) move recurs later in its block, in which case
+     * the decoded constant is worth keeping in a register (see `setDecodedConstant`).
+     *
+     * @param const MachineInstr& Instruction The register or stack move of an immediate.
+     * @return bool Positive if the immediate recurs.
+     */
+    bool shouldKeepDecodedConstant(const MachineInstr& Instruction) {
+        unsigned bits = getImmediateWidth(Instruction);
+        if (!amortizeKeys || !bits || MF.getProperties().hasProperty(MachineFunctionProperties::Property::NoVRegs)) return false;
+
+        int64_t immediateValue = getTruncatedImmediate(Instruction, bits);
+        if (decodedConstants.count(std::make_tuple(Instruction.getParent(), bits, immediateValue))) return false;
+
+        return immediateRecurs(std::next(Instruction.getIterator()), *Instruction.getParent(), bits, immediateValue);
+    }
+
+    /**
+     * Keep the decoded constant of the given (register or stack) move, so that later moves of the same
+     * immediate in its block can reuse it (see `getDecodedConstant`).
+     *
+     * @param const MachineInstr& Instruction The register or stack move of an immediate (before it is erased).
+     * @param Register reg The virtual register holding the decoded constant.
+     */
+    void setDecodedConstant(const MachineInstr& Instruction, Register reg) {
+        unsigned bits = getImmediateWidth(Instruction);
+        if (!bits) return;
+
+        int64_t immediateValue = getTruncatedImmediate(Instruction, bits);
+        decodedConstants[std::make_tuple(Instruction.getParent(), bits, immediateValue)] = reg;
+    }
+
+    /**
+     * Decide whether the key of a substitution inside a loop should be folded into an immediate form
+     * (e.g. `xor [rbp+x], imm`), instead of being materialized in a register on every iteration.
+     *
+     * This is the loop-invariant alternative for substitutions that can't be hoisted as a whole (e.g. stack
+     * stores). Hoisting only the key register is never cheaper, as `regallocfast` spills every register that
+     * is live out of a block: the key would cost a spill in the preheader plus one reload per iteration, which
+     * is as much per iteration as materializing the key in the loop. A folded key costs nothing per iteration.
+     *
+     * @param const MachineInstr& Instruction The instruction that is being substituted.
+     * @return bool Positive if the option should emit its immediate key form.
+     */
+    bool shouldFoldKey(const MachineInstr& Instruction) {
+        if (!hoistLoopInvariants || MF.getProperties().hasProperty(MachineFunctionProperties::Property::NoVRegs)) return false;
+
+        const MachineBasicBlock& MBB = *Instruction.getParent();
+        MachineBasicBlock* preheader = getOutermostPreheader(MBB);
+        if (!preheader) return false;
+
+        dbgs() << "          ↳ Folding the key into an immediate in loop block `" << MBB.getName() << "` (frequency " << format("%.2f", getRelativeFrequency(MBB)) << ").\n";
+        foldedKeys++;
+        return true;
+    }
+
+    /**
+     * Start a new run of adjacent substitutions that share the given (freshly materialized) key register.
+     *
+     * @param const MachineInstr& Instruction The instruction that is being substituted.
+     * @param Register reg The virtual register holding the key.
+     * @param size_t keyValue The value of the key.
+     */
+    void setRunKey(const MachineInstr& Instruction, Register reg, size_t keyValue) {
+        runKey.block = Instruction.getParent();
+        runKey.reg = reg;
+        runKey.value = keyValue;
+        runKey.used = true;
+    }
+
+    /**
+     * Run an option on the given instruction, hoist the loop-invariant part of the substitution out of
+     * loops, and keep track of the overhead of the resulting instructions.
+     *
+     * Hoisting only applies while the machine function still has virtual registers (before register allocation).
+     * Where legal, the decoded constant is hoisted as a whole, so that the loop no longer decodes it. As the
+     * register allocator (at `-O0`) spills it in the preheader, the loop still reloads it on every iteration.
+     *
+     * If the same immediate recurs later in the block, the decoded constant is kept in a register, so that
+     * the next `mov` of that immediate becomes a copy (or, for stack moves, a store of that register)
+     * instead of another substitution.
+     *
+     * @param const TransformOption& option The option to run.
+     * @param MachineInstr& Instruction The instruction to substitute.
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool applyOption(const TransformOption& option, MachineInstr& Instruction) {
+        runKey.used = false;
+
+        // Hoisted instructions may end up in blocks that have not been visited yet
+        if (emittedInstructions.count(&Instruction)) return false;
+
+        MachineBasicBlock& MBB = *Instruction.getParent();
+        double frequency = getRelativeFrequency(MBB);
+        pressure.prepareUpdate(Instruction);
+        bool hasVirtualRegisters = !MF.getProperties().hasProperty(MachineFunctionProperties::Property::NoVRegs);
+
+        // Remember what the instruction was (it is erased by the option)
+        double originalSize = CostModelHelper::getInstructionSize(profile, Instruction);
+        bool regMovImmediate = amortizeKeys && hasVirtualRegisters && isRegMovImmediate(Instruction);
+        bool keepDecodedConstant = regMovImmediate && shouldKeepDecodedConstant(Instruction);
+        unsigned bits = regMovImmediate ? getImmediateWidth(Instruction) : 0;
+        int64_t immediateValue = regMovImmediate ? getTruncatedImmediate(Instruction, bits) : 0;
+
+        // Reuse the decoded constant of an earlier substitution of the same immediate (stack moves reuse it in their option)
+        if (regMovImmediate) {
+            if (Register decodedConstant = getDecodedConstant(Instruction, nullptr)) {
+                const TargetInstrInfo* TII = MF.getSubtarget().getInstrInfo();
+                MachineInstr* copy = BuildMI(MBB, Instruction, Instruction.getDebugLoc(), TII->get(TargetOpcode::COPY), Instruction.getOperand(0).getReg()).addReg(decodedConstant);
+                Instruction.eraseFromParent();
+                pressure.update(copy);
+
+                budget.consume(option.module, CostModelHelper::getInstructionSize(profile, *copy) - originalSize);
+                emittedInstructions.insert(copy);
+                substitutions++;
+                return true;
+            }
+        }
+
+        // Remember the boundaries of the substitution
+        MachineBasicBlock::iterator next = std::next(Instruction.getIterator());
+        bool atBegin = Instruction.getIterator() == MBB.begin();
+        MachineBasicBlock::iterator previous = atBegin ? MBB.end() : std::prev(Instruction.getIterator());
+
+        if (!option.run(Instruction, *this)) return false;
+
+        SmallVector<MachineInstr*, 8> emitted;
+        for (auto it = atBegin ? MBB.begin() : std::next(previous); it != next; ++it) {
+            emitted.push_back(&*it);
+        }
+
+        // Keep track of the end of the run (a run is broken by any substitution that doesn't use its key)
+        if (runKey.used && !emitted.empty()) {
+            runKey.end = emitted.back();
+        } else {
+            runKey.reg = Register();
+        }
+
+        // Move the decoded constant into the preheader of the outermost loop
+        MachineBasicBlock* preheader = getOutermostPreheader(MBB);
+        Register decodedConstant;
+
+        if (hoistLoopInvariants && hasVirtualRegisters && preheader && !emitted.empty()) {
+            decodedConstant = isolateDecodedConstant(emitted, next, preheader);
+        }
+
+        bool hoistedConstant = decodedConstant.isValid();
+
+        // Keep the decoded constant in a register if the same immediate recurs in this block
+        if (!decodedConstant && keepDecodedConstant && !emitted.empty()) {
+            decodedConstant = isolateDecodedConstant(emitted, next, nullptr);
+        }
+
+        if (decodedConstant && regMovImmediate) {
+            decodedConstants[std::make_tuple(&MBB, bits, immediateValue)] = decodedConstant;
+        }
+
+        // Keep the register pressure up to date with the keys & constants of the substitution
+        pressure.update(emitted);
+
+        // Keep track of the overhead, relative to the frequency of the block the instructions ended up in
+        staticOverhead += (emitted.size() > 0) ? (emitted.size() - 1) : 0;
+        dynamicOverhead -= frequency;
+        double growth = -originalSize;
+
+        for (MachineInstr* instruction : emitted) {
+            dynamicOverhead += getRelativeFrequency(*instruction->getParent());
+            growth += CostModelHelper::getInstructionSize(profile, *instruction);
+            emittedInstructions.insert(instruction);
+        }
+
+        // The hoisted constant lives across blocks, so it is spilled in the preheader and reloaded in the loop
+        if (hoistedConstant) {
+            staticOverhead += 2;
+            dynamicOverhead += getRelativeFrequency(*preheader) + frequency;
+            growth += CostModelHelper::getSequenceSize(profile, { InstructionClass::StoreStack, InstructionClass::LoadStack });
+        }
+
+        budget.consume(option.module, growth);
+
+        substitutions++;
+        return true;
+    }
+
+    /**
+     * Apply the picked options to the candidates of a module, in program order.
+     *
+     * Under a growth budget (`MM_MAX_GROWTH`), candidates are ranked by the diversity they add per byte
+     * and cycle they cost, and picked greedily until the budget is exhausted. The picked candidates are
+     * still applied in program order, as keys & decoded constants are only shared with later instructions.
+     *
+     * @param ArrayRef<Candidate> candidates The candidates of the module (in program order).
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool applyOptions(ArrayRef<Candidate> candidates) {
+        bool modified = false;
+        std::vector<bool> picked(candidates.size(), true);
+
+        if (budget.isLimited()) {
+            std::vector<double> scores;
+            std::vector<double> sizes;
+
+            for (const Candidate& candidate : candidates) {
+                ArrayRef<InstructionClass> sequence(candidate.option->sequence, candidate.option->sequenceLength);
+                double size = std::max(1.0, (double) CostModelHelper::getSequenceSize(profile, sequence) - CostModelHelper::getInstructionSize(profile, *candidate.instruction));
+                double cycles = CostModelHelper::getSequenceCost(profile, sequence) * getRelativeFrequency(*candidate.instruction->getParent());
+
+                sizes.push_back(size);
+                scores.push_back(getDiversity(candidate) / (size + cycles));
+            }
+
+            std::vector<size_t> ranking(candidates.size());
+            std::iota(ranking.begin(), ranking.end(), 0);
+            std::stable_sort(ranking.begin(), ranking.end(), [&](size_t a, size_t b) { return scores[a] > scores[b]; });
+
+            double remaining = budget.getRemaining();
+
+            for (size_t index : ranking) {
+                picked[index] = sizes[index] <= remaining;
+                if (picked[index]) remaining -= sizes[index];
+            }
+        }
+
+        for (size_t index = 0; index < candidates.size(); index++) {
+            // The actual growth may differ from the estimate (e.g. shared keys), so check the budget again
+            if (!picked[index] || !budget.fits(1)) {
+                dbgs() << "          ↳ Skipping modification because it doesn't fit in the growth budget.\n";
+                overBudget++;
+                continue;
+            }
+
+            if (applyOption(*candidates[index].option, *candidates[index].instruction)) {
+                modified = true;
+            }
+        }
+
+        return modified;
+    }
+
+    /**
+     * Estimate the diversity (in bits) that substituting a candidate adds to the output.
+     *
+     * This is the randomness of the picked option plus, for instructions with an immediate, the randomness
+     * of the key (the width of the destination), as that is what changes the bytes in the output.
+     *
+     * @param const Candidate& candidate The candidate to estimate the diversity of.
+     * @return double The estimated diversity (in bits).
+     */
+    double getDiversity(const Candidate& candidate) {
+        const MachineInstr& Instruction = *candidate.instruction;
+        double result = 1.0 + std::log2((double) std::max<size_t>(1, candidate.optionCount));
+
+        if (!any_of(Instruction.operands(), [](const MachineOperand& operand) { return operand.isImm(); })) {
+            return result;
+        }
+
+        if (Instruction.mayStore() && !Instruction.memoperands_empty()) {
+            return result + 8.0 * (*Instruction.memoperands_begin())->getSize();
+        }
+
+        const MachineOperand& destination = Instruction.getOperand(0);
+        if (destination.isReg() && destination.getReg()) {
+            const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+            return result + TRI->getRegSizeInBits(destination.getReg(), MF.getRegInfo());
+        }
+
+        return result + 32.0;
+    }
+
+    /**
+     * Keep track of a redundant instruction that is about to be removed (lowering the overhead).
+     *
+     * @param StringRef module The name of the module that removes the instruction.
+     * @param const MachineInstr& Instruction The instruction that is about to be removed.
+     */
+    void recordRemoval(StringRef module, const MachineInstr& Instruction) {
+        staticOverhead -= 1;
+        dynamicOverhead -= getRelativeFrequency(*Instruction.getParent());
+        budget.consume(module, -(double) CostModelHelper::getInstructionSize(profile, Instruction));
+        removed++;
+    }
+
+    /**
+     * Check if the given growth fits in the remaining growth budget (`MM_MAX_GROWTH`).
+     *
+     * @param double bytes The growth (in bytes).
+     * @return bool Positive if the growth fits.
+     */
+    bool fitsGrowth(double bytes) {
+        return budget.fits(bytes);
+    }
+
+    /**
+     * Keep track of growth that a module added outside of substitutions (e.g. by inserting branches).
+     *
+     * @param StringRef module The name of the module that caused the growth.
+     * @param double bytes The growth (in bytes, negative if the module shrunk the function).
+     */
+    void recordGrowth(StringRef module, double bytes) {
+        budget.consume(module, bytes);
+    }
+
+    /**
+     * Retrieve the growth that a module added to the machine function (in this step).
+     *
+     * @param StringRef module The name of the module.
+     * @return double The growth (in bytes).
+     */
+    double getGrowth(StringRef module) {
+        return budget.getConsumed(module);
+    }
+
+    /**
+     * Estimate the size of the given instructions.
+     *
+     * @param const MachineBasicBlock& MBB The block with the instructions.
+     * @return double The estimated size (in bytes).
+     */
+    double getSize(const MachineBasicBlock& MBB) {
+        double result = 0;
+        for (const MachineInstr& Instruction : MBB) result += CostModelHelper::getInstructionSize(profile, Instruction);
+        return result;
+    }
+
+    /**
+     * Persist the growth of the machine function, so that later steps respect the same budget.
+     */
+    void persistGrowth() {
+        budget.persist();
+    }
+
+    /**
+     * Report the estimated overhead of all substitutions in the machine function.
+     */
+    void report() {
+        dbgs() << "        ↳ Estimated overhead of `" << MF.getName() << "(...)`: " << substitutions << " substitution(s), " << skipped << " skipped in hot code, " << hoisted << " hoisted out of loops, " << foldedKeys << " folded key(s) in loops, ";
+        dbgs() << sharedKeys << " shared key(s), " << reusedConstants << " reused constant(s), ";
+        dbgs() << pressureDowngraded << " downgraded & " << pressureSkipped << " skipped (of " << (pressureKept + pressureDowngraded + pressureSkipped) << ") due to register pressure, " << removed << " redundant instruction(s) removed, " << overBudget << " over budget, ";
+        dbgs() << format("%.0f", staticOverhead) << " static instruction(s), " << format("%.2f", dynamicOverhead) << " dynamic instruction(s) per invocation.\n";
+        budget.report();
+    }
+
+};
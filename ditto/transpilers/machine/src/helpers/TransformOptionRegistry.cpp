@@ -0,0 +1,416 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <list>
+#include <vector>
+#include "CostModelHelper.cpp"
+#include "../../../shared/helpers/RandomHelper.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * State shared by all substitutions of a machine function (see `TransformContext.cpp`).
+ */
+class TransformContext;
+
+/**
+ * Signature of the candidate check of a transform option.
+ */
+typedef bool (*TransformOptionCandidateFunction)(const MachineInstr&);
+
+/**
+ * Signature of the entry point of a transform option.
+ *
+ * A plain function pointer (instead of e.g. `std::function`) keeps module dispatch a single indirect call.
+ */
+typedef bool (*TransformOptionFunction)(MachineInstr&, TransformContext&);
+
+/**
+ * Metadata of a single transform option (e.g. the `XOR` substitution of `mov reg, imm`).
+ *
+ * This is a plain C-compatible struct, so that out-of-tree option libraries (loaded via
+ * `llc -load`) can register options through `dittoRegisterTransformOption`.
+ */
+struct TransformOption {
+
+    /**
+     * The name of the module the option belongs to (e.g. `TransformRegMovImmediates`).
+     */
+    const char* module;
+
+    /**
+     * The name of the option itself (e.g. `XOR`).
+     */
+    const char* name;
+
+    /**
+     * The architecture the option can be applied to.
+     */
+    Triple::ArchType architecture;
+
+    /**
+     * The opcodes of the instructions the option is able to substitute.
+     */
+    const unsigned* opcodes;
+
+    /**
+     * The amount of opcodes in `opcodes`.
+     */
+    size_t opcodesCount;
+
+    /**
+     * The classes of the instructions the option emits per substitution (used by the cost model).
+     */
+    const InstructionClass* sequence;
+
+    /**
+     * The amount of instruction classes in `sequence`.
+     */
+    size_t sequenceLength;
+
+    /**
+     * The relative chance of the option being picked (zero disables the option).
+     */
+    unsigned weight;
+
+    /**
+     * Checks if the option is able to substitute the given instruction.
+     */
+    TransformOptionCandidateFunction isCandidate;
+
+    /**
+     * Substitutes the given instruction.
+     */
+    TransformOptionFunction run;
+
+};
+
+/**
+ * Register a transform option with the registry of the machine transpiler.
+ *
+ * This function is exported (C-linkage) so that out-of-tree option libraries, loaded with an additional
+ * `-load` after `libMachineTranspiler`, can register their options during their static initialization.
+ * Out-of-tree libraries should define `DITTO_TRANSFORM_OPTION_LIBRARY` before including this file.
+ *
+ * @param const TransformOption* option The option to register (its strings must outlive the process, its opcodes and sequence are copied).
+ */
+extern "C" LLVM_EXTERNAL_VISIBILITY void dittoRegisterTransformOption(const TransformOption* option);
+
+/**
+ * A registry of all available transform options, grouped by module and architecture.
+ *
+ * Options are kept in one flat table that is sorted by module and architecture, so that the
+ * options of one module & architecture are always a contiguous slice of that table. The opcodes
+ * and sequence of every entry are copied into storage that is owned by the registry.
+ */
+class TransformOptionRegistry {
+
+public:
+
+    /**
+     * Add an option to the registry, keeping the table sorted by module and architecture.
+     *
+     * @param const TransformOption& option The option to add.
+     */
+    static void add(const TransformOption& option) {
+        OptionStorage& storage = getStorage().emplace_back();
+        storage.opcodes.assign(option.opcodes, option.opcodes + option.opcodesCount);
+        storage.sequence.assign(option.sequence, option.sequence + option.sequenceLength);
+
+        TransformOption entry = option;
+        entry.opcodes = storage.opcodes.data();
+        entry.sequence = storage.sequence.data();
+
+        std::vector<TransformOption>& options = getTable();
+        auto position = std::upper_bound(options.begin(), options.end(), entry, isOrderedBefore);
+        options.insert(position, entry);
+    }
+
+    /**
+     * Retrieve all options of the given module that are compatible with the given architecture.
+     *
+     * @param StringRef module The name of the module to retrieve options for.
+     * @param Triple::ArchType architecture The architecture to retrieve options for.
+     * @return ArrayRef<TransformOption> A contiguous slice of the registry table.
+     */
+    static ArrayRef<TransformOption> getOptions(StringRef module, Triple::ArchType architecture) {
+        std::vector<TransformOption>& options = getTable();
+
+        // The module name is not necessarily null-terminated, so compare it by length
+        auto first = std::partition_point(options.begin(), options.end(), [&](const TransformOption& option) {
+            int comparison = StringRef(option.module).compare(module);
+            return comparison < 0 || (comparison == 0 && option.architecture < architecture);
+        });
+
+        auto last = std::partition_point(first, options.end(), [&](const TransformOption& option) {
+            return StringRef(option.module) == module && option.architecture == architecture;
+        });
+
+        return ArrayRef<TransformOption>(options.data() + (first - options.begin()), last - first);
+    }
+
+    /**
+     * Check if the given option is able to substitute instructions with the given opcode.
+     *
+     * @param const TransformOption& option The option to check.
+     * @param unsigned opcode The opcode of the instruction.
+     * @return bool Positive if the opcode is supported by the option.
+     */
+    static bool supportsOpcode(const TransformOption& option, unsigned opcode) {
+        return std::find(option.opcodes, option.opcodes + option.opcodesCount, opcode) != option.opcodes + option.opcodesCount;
+    }
+
+private:
+
+    /**
+     * The opcodes and sequence of a registered option.
+     */
+    struct OptionStorage {
+        std::vector<unsigned> opcodes;
+        std::vector<InstructionClass> sequence;
+    };
+
+    /**
+     * Retrieve the (lazily initialized) storage of the registered options (a list, so entries never move).
+     *
+     * @return std::list<OptionStorage>& The storage of the options.
+     */
+    static std::list<OptionStorage>& getStorage() {
+        static std::list<OptionStorage> storage;
+        return storage;
+    }
+
+    /**
+     * Retrieve the (lazily initialized) table of registered options.
+     *
+     * @return std::vector<TransformOption>& The table of options.
+     */
+    static std::vector<TransformOption>& getTable() {
+        static std::vector<TransformOption> options;
+        return options;
+    }
+
+    /**
+     * Strict weak ordering of options by module name and architecture.
+     *
+     * @param const TransformOption& a The first option.
+     * @param const TransformOption& b The second option.
+     * @return bool Positive if `a` should be ordered before `b`.
+     */
+    static bool isOrderedBefore(const TransformOption& a, const TransformOption& b) {
+        int comparison = std::strcmp(a.module, b.module);
+        return comparison < 0 || (comparison == 0 && a.architecture < b.architecture);
+    }
+
+};
+
+/**
+ * Picks a transform option per instruction, by weighted sampling under the cost model of the target.
+ *
+ * The effective weight of an option is its registered weight divided by (one plus) the estimated cost
+ * of the sequence it emits, so cheaper sequences are picked more often while expensive ones remain possible.
+ */
+class TransformOptionSampler {
+
+private:
+
+    /**
+     * The options of the module & architecture.
+     */
+    ArrayRef<TransformOption> options;
+
+    /**
+     * The effective weights of the options (same order as `options`).
+     */
+    std::vector<double> weights;
+
+    /**
+     * Scratch list of the effective weights of the options that are candidates for the current instruction.
+     */
+    std::vector<double> candidateWeights;
+
+    /**
+     * Scratch list of the options that are candidates for the current instruction.
+     */
+    std::vector<const TransformOption*> candidates;
+
+public:
+
+    /**
+     * Constructor that resolves the options of a module and calculates their effective weights.
+     *
+     * @param StringRef module The name of the module to sample options for.
+     * @param const MachineFunction& MF The machine function that is being transformed.
+     */
+    TransformOptionSampler(StringRef module, const MachineFunction& MF) {
+        const CostProfile& profile = CostModelHelper::getProfile(MF);
+        options = TransformOptionRegistry::getOptions(module, MF.getTarget().getTargetTriple().getArch());
+
+        for (const TransformOption& option : options) {
+            double cost = CostModelHelper::getSequenceCost(profile, ArrayRef<InstructionClass>(option.sequence, option.sequenceLength));
+            weights.push_back(option.weight / (1.0 + cost));
+        }
+
+        dbgs() << "        ↳ Sampling " << options.size() << " option(s) of " << module << " under cost profile " << profile.name << ".\n";
+    }
+
+    /**
+     * Check if the module has any options on this architecture.
+     *
+     * @return bool Positive if at least one option is registered.
+     */
+    bool hasOptions() const {
+        return !options.empty();
+    }
+
+    /**
+     * Pick a random option that is able to substitute the given instruction.
+     *
+     * @param const MachineInstr& instruction The instruction to pick an option for.
+     * @return const TransformOption* The picked option, or a null pointer if no option is able to substitute the instruction.
+     */
+    const TransformOption* pick(const MachineInstr& instruction) {
+        candidates.clear();
+        candidateWeights.clear();
+
+        for (size_t index = 0; index < options.size(); index++) {
+            const TransformOption& option = options[index];
+
+            if (option.weight == 0) continue;
+            if (!TransformOptionRegistry::supportsOpcode(option, instruction.getOpcode())) continue;
+            if (!option.isCandidate(instruction)) continue;
+
+            candidates.push_back(&option);
+            candidateWeights.push_back(weights[index]);
+        }
+
+        if (candidates.empty()) {
+            return nullptr;
+        }
+
+        return candidates[RandomHelper::getWeightedIndex(candidateWeights)];
+    }
+
+    /**
+     * Retrieve the amount of options that were able to substitute the instruction of the last `pick`.
+     *
+     * @return size_t The amount of compatible options.
+     */
+    size_t getCandidateCount() const {
+        return candidates.size();
+    }
+
+};
+
+/**
+ * Helper to (statically) register an option class with the registry.
+ *
+ * The option class must be default constructible and implement `bool isCandidate(const MachineInstr&)`
+ * and `bool runOnMachineInstruction(MachineInstr&, TransformContext&)`.
+ */
+template <typename Option>
+class RegisterTransformOption {
+
+public:
+
+    /**
+     * Register the option class with the registry.
+     *
+     * @param const char* module The name of the module the option belongs to.
+     * @param const char* name The name of the option.
+     * @param Triple::ArchType architecture The architecture the option can be applied to.
+     * @param std::initializer_list<unsigned> opcodes The opcodes the option is able to substitute.
+     * @param std::initializer_list<InstructionClass> sequence The classes of the instructions the option emits.
+     * @param unsigned weight The relative chance of the option being picked.
+     */
+    RegisterTransformOption(const char* module, const char* name, Triple::ArchType architecture, std::initializer_list<unsigned> opcodes, std::initializer_list<InstructionClass> sequence, unsigned weight) {
+        // The registry copies the opcodes and sequence into its own entry
+        TransformOption option = {};
+        option.module = module;
+        option.name = name;
+        option.architecture = architecture;
+        option.opcodes = opcodes.begin();
+        option.opcodesCount = opcodes.size();
+        option.sequence = sequence.begin();
+        option.sequenceLength = sequence.size();
+        option.weight = weight;
+        option.isCandidate = &RegisterTransformOption<Option>::isCandidate;
+        option.run = &RegisterTransformOption<Option>::run;
+
+        dittoRegisterTransformOption(&option);
+    }
+
+private:
+
+    /**
+     * Retrieve the (single) instance of the option class, which is constructed on first use.
+     *
+     * @return Option& The instance of the option class.
+     */
+    static Option& getInstance() {
+        static Option instance;
+        return instance;
+    }
+
+    /**
+     * Trampoline that checks if the option class is able to substitute the given instruction.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the option is able to substitute the instruction.
+     */
+    static bool isCandidate(const MachineInstr &instruction) {
+        return getInstance().isCandidate(instruction);
+    }
+
+    /**
+     * Trampoline that runs the option class on the given instruction.
+     *
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
+     * @return bool Indicates if the machine function was modified.
+     */
+    static bool run(MachineInstr &Instruction, TransformContext &context) {
+        return getInstance().runOnMachineInstruction(Instruction, context);
+    }
+
+};
+
+#ifndef DITTO_TRANSFORM_OPTION_LIBRARY
+
+extern "C" LLVM_EXTERNAL_VISIBILITY void dittoRegisterTransformOption(const TransformOption* option) {
+    TransformOptionRegistry::add(*option);
+}
+
+#endif
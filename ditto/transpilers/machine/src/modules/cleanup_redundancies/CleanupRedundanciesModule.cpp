@@ -0,0 +1,314 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/LivePhysRegs.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <vector>
+#include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to remove provably redundant instructions that fast register allocation introduced around substitutions.
+ *
+ * This module only ever removes instructions. It never folds or combines instructions, so it can't undo
+ * a substitution (e.g. `mov reg, enc; xor reg, key` is never turned back into `mov reg, imm`). It removes:
+ * - Identity copies (`mov reg, reg` to the same register).
+ * - Reloads of a spill slot directly after storing the same register into it.
+ * - Stores to spill slots that are never read.
+ * - Register moves & copies whose result is never read (e.g. dead key moves).
+ */
+class CleanupRedundanciesModule {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+    /**
+     * Amount of removed instructions per category.
+     */
+    unsigned removedIdentityCopies = 0;
+    unsigned removedReloads = 0;
+    unsigned removedSpills = 0;
+    unsigned removedDeadMoves = 0;
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* MM_CLEANUP_REDUNDANCIES = std::getenv("MM_CLEANUP_REDUNDANCIES");
+        bool result = (MM_CLEANUP_REDUNDANCIES && std::string(MM_CLEANUP_REDUNDANCIES) == "true");
+
+        return result || moduleIsBeingTested();
+    }
+
+    /**
+     * Whether the module is being feature tested or not (default).
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsBeingTested() {
+        const char* MM_TEST_CLEANUP_REDUNDANCIES = std::getenv("MM_TEST_CLEANUP_REDUNDANCIES");
+        bool result = (MM_TEST_CLEANUP_REDUNDANCIES && std::string(MM_TEST_CLEANUP_REDUNDANCIES) == "true");
+
+        return result;
+    }
+
+    /**
+     * Remove an instruction, keeping track of the overhead that is saved.
+     *
+     * @param MachineInstr& Instruction The instruction to remove.
+     * @param TransformContext& context State shared by all modules.
+     * @param unsigned& counter The counter of the category of the instruction.
+     */
+    void remove(MachineInstr &Instruction, TransformContext &context, unsigned &counter) {
+        dbgs() << "          ↳ Removing redundant instruction: ";
+        Instruction.print(dbgs());
+
+        context.recordRemoval("CleanupRedundancies", Instruction);
+        Instruction.eraseFromParent();
+
+        counter++;
+        modified = true;
+    }
+
+    /**
+     * Remove identity copies (copies of a register to itself).
+     *
+     * @param MachineFunction& MF The machine function to clean up.
+     * @param TransformContext& context State shared by all modules.
+     */
+    void removeIdentityCopies(MachineFunction &MF, TransformContext &context) {
+        for (auto &MachineBasicBlock : MF) {
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                if (Instruction.isIdentityCopy() && Instruction.getNumImplicitOperands() == 0) {
+                    remove(Instruction, context, removedIdentityCopies);
+                }
+            }
+        }
+    }
+
+    /**
+     * Remove reloads of a spill slot into the same register that was just stored into it.
+     *
+     * The register and spill slot may not be modified in between, and the register may not be killed in
+     * between. Any store, call or instruction with side effects in between is conservatively assumed to
+     * modify the spill slot. As the register now stays live up to (and beyond) a removed reload, kill flags
+     * of the register on the store and on the instructions in between are cleared.
+     *
+     * @param MachineFunction& MF The machine function to clean up.
+     * @param TransformContext& context State shared by all modules.
+     */
+    void removeRedundantReloads(MachineFunction &MF, TransformContext &context) {
+        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+        const TargetRegisterInfo *TRI = MF.getSubtarget().getRegisterInfo();
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ++MachineInstruction) {
+                int storeFrameIndex = 0;
+                unsigned storeSize = 0;
+                Register storedRegister = TII->isStoreToStackSlot(*MachineInstruction, storeFrameIndex, storeSize);
+                if (!storedRegister) continue;
+
+                // Instructions from here up to a removed reload no longer end the live range of the register
+                auto KillsCleared = MachineInstruction;
+
+                for (auto Next = std::next(MachineInstruction); Next != MachineBasicBlock.end(); ) {
+                    MachineInstr &Instruction = *Next++;
+
+                    int loadFrameIndex = 0;
+                    unsigned loadSize = 0;
+                    Register loadedRegister = TII->isLoadFromStackSlot(Instruction, loadFrameIndex, loadSize);
+
+                    if (loadedRegister == storedRegister && loadFrameIndex == storeFrameIndex && loadSize == storeSize) {
+                        for (; &*KillsCleared != &Instruction; ++KillsCleared) {
+                            KillsCleared->clearRegisterKills(storedRegister, TRI);
+                        }
+
+                        KillsCleared = Next;
+                        remove(Instruction, context, removedReloads);
+                        continue;
+                    }
+
+                    if (Instruction.isDebugInstr()) continue;
+                    if (Instruction.killsRegister(storedRegister, TRI)) break;
+                    if (Instruction.modifiesRegister(storedRegister, TRI)) break;
+                    if (Instruction.mayStore() || Instruction.isCall() || Instruction.hasUnmodeledSideEffects()) break;
+                }
+            }
+        }
+    }
+
+    /**
+     * Remove stores to spill slots that are never read by any instruction.
+     *
+     * @param MachineFunction& MF The machine function to clean up.
+     * @param TransformContext& context State shared by all modules.
+     */
+    void removeUnreadSpills(MachineFunction &MF, TransformContext &context) {
+        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+        const MachineFrameInfo &MFI = MF.getFrameInfo();
+
+        // Spill slots that are referenced by anything else than a spill store
+        std::vector<bool> isRead(MFI.getObjectIndexEnd() - MFI.getObjectIndexBegin(), false);
+        SmallVector<MachineInstr*, 16> spills;
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto &Instruction : MachineBasicBlock) {
+                int frameIndex = 0;
+
+                if (TII->isStoreToStackSlot(Instruction, frameIndex) && MFI.isSpillSlotObjectIndex(frameIndex)) {
+                    spills.push_back(&Instruction);
+                    continue;
+                }
+
+                for (const MachineOperand &operand : Instruction.operands()) {
+                    if (operand.isFI()) isRead[operand.getIndex() - MFI.getObjectIndexBegin()] = true;
+                }
+            }
+        }
+
+        for (MachineInstr* Instruction : spills) {
+            int frameIndex = 0;
+            TII->isStoreToStackSlot(*Instruction, frameIndex);
+
+            if (!isRead[frameIndex - MFI.getObjectIndexBegin()]) {
+                remove(*Instruction, context, removedSpills);
+            }
+        }
+    }
+
+    /**
+     * Remove register moves & copies whose destination is never read (e.g. dead key moves).
+     *
+     * @param MachineFunction& MF The machine function to clean up.
+     * @param TransformContext& context State shared by all modules.
+     */
+    void removeDeadMoves(MachineFunction &MF, TransformContext &context) {
+        const TargetRegisterInfo *TRI = MF.getSubtarget().getRegisterInfo();
+        const MachineRegisterInfo &MRI = MF.getRegInfo();
+
+        // Liveness of physical registers requires accurate live-in lists
+        if (!MRI.tracksLiveness()) return;
+
+        for (auto &MachineBasicBlock : MF) {
+            LivePhysRegs liveRegisters(*TRI);
+            liveRegisters.addLiveOuts(MachineBasicBlock);
+
+            for (auto MachineInstruction = MachineBasicBlock.rbegin(); MachineInstruction != MachineBasicBlock.rend(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                if (isDeadMove(Instruction, liveRegisters, MRI)) {
+                    remove(Instruction, context, removedDeadMoves);
+                    continue;
+                }
+
+                liveRegisters.stepBackward(Instruction);
+            }
+        }
+    }
+
+    /**
+     * Check if an instruction is a register move or copy whose (only) destination is not live after it.
+     *
+     * @param const MachineInstr& Instruction The instruction to check.
+     * @param const LivePhysRegs& liveRegisters The physical registers that are live after the instruction.
+     * @param const MachineRegisterInfo& MRI The register information of the machine function.
+     * @return bool Positive if the instruction can be removed.
+     */
+    bool isDeadMove(const MachineInstr &Instruction, const LivePhysRegs &liveRegisters, const MachineRegisterInfo &MRI) {
+        if (!Instruction.isCopy() && !Instruction.isMoveImmediate() && !Instruction.isMoveReg()) return false;
+        if (Instruction.mayLoadOrStore() || Instruction.hasUnmodeledSideEffects() || Instruction.getNumImplicitOperands() != 0) return false;
+
+        const MachineOperand &destination = Instruction.getOperand(0);
+        if (!destination.isReg() || !destination.isDef() || !destination.getReg().isPhysical()) return false;
+        if (MRI.isReserved(destination.getReg())) return false;
+
+        return liveRegisters.available(MRI, destination.getReg());
+    }
+
+public:
+
+    /**
+     * Main execution method for the CleanupRedundanciesModule class.
+     *
+     * @param MachineFunction& MF The machine function to run the cleanup on.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+
+        // Ensure the architecture is supported
+        auto architecture = MF.getTarget().getTargetTriple().getArch();
+
+        switch (architecture) {
+            // AMD64 & ARM64 (the cleanup only relies on target hooks)
+            case Triple::x86_64:
+            case Triple::aarch64:
+                break;
+            // Unknown architecture
+            default:
+                report_fatal_error(formatv("CleanupRedundanciesModule failed due to unknown architecture: {0}.", architecture));
+                break;
+        }
+
+        // Only physical registers are tracked, so this must run after register allocation
+        if (!MF.getProperties().hasProperty(MachineFunctionProperties::Property::NoVRegs)) return false;
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: CleanupRedundancies().\n";
+
+        removeIdentityCopies(MF, context);
+        removeRedundantReloads(MF, context);
+        removeUnreadSpills(MF, context);
+        removeDeadMoves(MF, context);
+
+        dbgs() << "          ✓ Removed " << removedIdentityCopies << " identity copies, " << removedReloads << " reloads, " << removedSpills << " spills and " << removedDeadMoves << " dead moves.\n";
+
+        return modified;
+    }
+
+};
@@ -0,0 +1,284 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <optional>
+
+/**
+ * Target specific lowerings
+ */
+#include "lowerings_amd64/InlineMemoryCallsLoweringAMD64.cpp"
+#include "lowerings_arm64/InlineMemoryCallsLoweringARM64.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to inline the `memcpy` and `memset` calls that code generation introduced.
+ *
+ * The intermediate transpiler expands the `memcpy` and `memset` intrinsics of the source code, but instruction
+ * selection still introduces calls for e.g. `byval` arguments, large aggregate returns and some stack
+ * initializations. Position independent code has no C library to resolve them, so they are replaced by inline
+ * code of the target (see the target specific lowerings). Other calls (e.g. `memmove`) are left as is.
+ *
+ * This is not a metamorphication, so it does not depend on `MM_*` options (and runs for unmodified builds too).
+ * It runs before the metamorphications of the first step, so that lengths are still plain immediates, and the
+ * constants of the inline code (e.g. the `memset` splat multiplier) are metamorphicated like any other.
+ */
+class InlineMemoryCallsModule {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* INLINE_MEMORY_CALLS = std::getenv("INLINE_MEMORY_CALLS");
+        return (INLINE_MEMORY_CALLS && std::string(INLINE_MEMORY_CALLS) == "true");
+    }
+
+    /**
+     * Retrieve the name of the function that a call instruction calls.
+     *
+     * @param const MachineInstr& instruction The call instruction.
+     * @return StringRef The name of the callee (empty for indirect calls).
+     */
+    StringRef getCalleeName(const MachineInstr& instruction) {
+        for (const MachineOperand& operand : instruction.operands()) {
+            if (operand.isSymbol()) return operand.getSymbolName();
+            if (operand.isGlobal()) return operand.getGlobal()->getName();
+        }
+
+        return StringRef();
+    }
+
+    /**
+     * Find the call frame setup or destroy pseudo instruction that surrounds a call (in the same block).
+     *
+     * @param MachineInstr& Call The call.
+     * @param unsigned opcode The call frame setup or destroy opcode.
+     * @param bool forward Whether to search after (destroy) or before (setup) the call.
+     * @return MachineInstr* The pseudo instruction, or null if there is none.
+     */
+    MachineInstr* findCallFrameInstruction(MachineInstr& Call, unsigned opcode, bool forward) {
+        MachineBasicBlock& MBB = *Call.getParent();
+
+        if (forward) {
+            for (auto it = std::next(MachineBasicBlock::iterator(Call)); it != MBB.end(); ++it) {
+                if (it->getOpcode() == opcode) return &*it;
+                if (it->isCall()) break;
+            }
+        } else {
+            for (auto it = std::next(MachineBasicBlock::reverse_iterator(Call)); it != MBB.rend(); ++it) {
+                if (it->getOpcode() == opcode) return &*it;
+                if (it->isCall()) break;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * Retrieve the constant that is passed in an argument register, by following the copies of its value.
+     *
+     * @param MachineInstr& Call The call.
+     * @param MCRegister argument The argument register.
+     * @param Lowering& lowering The target specific lowering.
+     * @return std::optional<uint64_t> The constant, if the argument is one.
+     */
+    template <class Lowering>
+    std::optional<uint64_t> getConstantArgument(MachineInstr& Call, MCRegister argument, Lowering& lowering) {
+        MachineFunction& MF = *Call.getMF();
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+        const TargetInstrInfo* TII = MF.getSubtarget().getInstrInfo();
+        MachineRegisterInfo& MRI = MF.getRegInfo();
+
+        // The instruction that sets the argument register (within the call sequence)
+        MachineInstr* definition = nullptr;
+
+        for (auto it = std::next(MachineBasicBlock::reverse_iterator(Call)); it != Call.getParent()->rend(); ++it) {
+            if (it->getOpcode() == TII->getCallFrameSetupOpcode()) break;
+            if (!it->modifiesRegister(argument, TRI)) continue;
+
+            definition = &*it;
+            break;
+        }
+
+        while (definition) {
+            if (std::optional<uint64_t> immediate = lowering.getMovImmediate(*definition)) return immediate;
+
+            Register source;
+            if (definition->isCopy()) source = definition->getOperand(1).getReg();
+            else if (definition->isSubregToReg()) source = definition->getOperand(2).getReg();
+
+            if (!source.isVirtual()) break;
+            definition = MRI.getUniqueVRegDef(source);
+        }
+
+        return std::nullopt;
+    }
+
+    /**
+     * Inline all `memcpy` and `memset` calls of a machine function.
+     *
+     * @param MachineFunction& MF The machine function to inline calls in.
+     * @param Lowering& lowering The target specific lowering.
+     */
+    template <class Lowering>
+    void inlineCalls(MachineFunction& MF, Lowering& lowering) {
+        const TargetRegisterInfo* TRI = MF.getSubtarget().getRegisterInfo();
+        const TargetInstrInfo* TII = MF.getSubtarget().getInstrInfo();
+        MachineRegisterInfo& MRI = MF.getRegInfo();
+
+        SmallVector<MachineInstr*, 8> calls;
+
+        for (auto& MachineBasicBlock : MF) {
+            for (auto& Instruction : MachineBasicBlock) {
+                if (!Instruction.isCall()) continue;
+
+                StringRef callee = getCalleeName(Instruction);
+                if (callee == "memcpy" || callee == "memset") calls.push_back(&Instruction);
+            }
+        }
+
+        SmallVector<MCRegister, 3> arguments = lowering.getArgumentRegisters();
+        MCRegister returnRegister = lowering.getReturnRegister();
+
+        for (MachineInstr* Call : calls) {
+            MachineBasicBlock& MBB = *Call->getParent();
+            DebugLoc DL = Call->getDebugLoc();
+            bool isMemset = getCalleeName(*Call) == "memset";
+
+            // Inform user that we encountered a call to inline
+            dbgs() << "          ↳ Found call to inline: ";
+            Call->print(dbgs());
+
+            // The return value (the destination) is only materialized if it is read after the call
+            bool returnValueIsRead = false;
+
+            for (auto it = std::next(MachineBasicBlock::iterator(Call)); it != MBB.end(); ++it) {
+                if (it->readsRegister(returnRegister, TRI)) returnValueIsRead = true;
+                if (returnValueIsRead || it->modifiesRegister(returnRegister, TRI)) break;
+            }
+
+            std::optional<uint64_t> constantLength = getConstantArgument(*Call, arguments[2], lowering);
+
+            // The call sequence (before the lowering, which may move the call to a new block)
+            MachineInstr* setup = findCallFrameInstruction(*Call, TII->getCallFrameSetupOpcode(), false);
+            MachineInstr* destroy = findCallFrameInstruction(*Call, TII->getCallFrameDestroyOpcode(), true);
+
+            // Move the arguments into virtual registers, so that the lowering is free to use any register
+            Register destination = MRI.createVirtualRegister(lowering.getPointerRegisterClass());
+            Register length = MRI.createVirtualRegister(lowering.getPointerRegisterClass());
+            Register sourceOrValue = MRI.createVirtualRegister(isMemset ? lowering.getValueRegisterClass() : lowering.getPointerRegisterClass());
+
+            BuildMI(MBB, *Call, DL, TII->get(TargetOpcode::COPY), destination).addReg(arguments[0]);
+            BuildMI(MBB, *Call, DL, TII->get(TargetOpcode::COPY), sourceOrValue).addReg(isMemset ? TRI->getSubReg(arguments[1], lowering.getValueSubRegister()) : arguments[1]);
+            BuildMI(MBB, *Call, DL, TII->get(TargetOpcode::COPY), length).addReg(arguments[2]);
+
+            if (isMemset) {
+                lowering.lowerMemset(*Call, destination, sourceOrValue, length, constantLength);
+            } else {
+                lowering.lowerMemcpy(*Call, destination, sourceOrValue, length, constantLength);
+            }
+
+            // The call may have moved to a new block (if the lowering emitted loops)
+            if (returnValueIsRead) {
+                BuildMI(*Call->getParent(), *Call, DL, TII->get(TargetOpcode::COPY), returnRegister).addReg(destination);
+            }
+
+            // Remove the call sequence (if it is complete), as nothing is called anymore
+            if (setup && destroy) {
+                setup->eraseFromParent();
+                destroy->eraseFromParent();
+            }
+
+            Call->eraseFromParent();
+
+            dbgs() << "          ✓ Inlined `" << (isMemset ? "memset" : "memcpy") << "` call" << (constantLength ? formatv(" of {0} byte(s)", *constantLength).str() : " of a variable length") << ".\n";
+            modified = true;
+        }
+
+        // Virtual registers of the lowerings are defined more than once (e.g. in loops)
+        if (modified) MF.getProperties().reset(MachineFunctionProperties::Property::IsSSA);
+    }
+
+public:
+
+    /**
+     * Main execution method for the InlineMemoryCallsModule class.
+     *
+     * @param MachineFunction& MF The machine function to inline calls in.
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineFunction(MachineFunction &MF) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: InlineMemoryCalls.\n";
+
+        auto architecture = MF.getTarget().getTargetTriple().getArch();
+
+        switch (architecture) {
+            case Triple::x86_64: {
+                InlineMemoryCallsLoweringAMD64 lowering(MF);
+                inlineCalls(MF, lowering);
+                break;
+            }
+            case Triple::aarch64: {
+                InlineMemoryCallsLoweringARM64 lowering(MF);
+                inlineCalls(MF, lowering);
+                break;
+            }
+            default:
+                report_fatal_error(formatv("InlineMemoryCallsModule failed due to unknown architecture: {0}.", architecture));
+                break;
+        }
+
+        return modified;
+    }
+
+};
@@ -0,0 +1,295 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/X86/X86.h"
+#include "llvm/Target/X86/X86InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <optional>
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to lower `memcpy` and `memset` calls to inline AMD64 code.
+ *
+ * Small constant lengths are unrolled to 8/4/2/1-byte moves. Other lengths use `rep movsb` and `rep stosb`,
+ * which are the fastest generic copy & set on CPUs with ERMSB (enhanced `rep movsb`/`rep stosb`), and still
+ * correct (and compact) on CPUs without it.
+ */
+class InlineMemoryCallsLoweringAMD64 {
+
+private:
+
+    /**
+     * Constant lengths (in bytes) up to this threshold are unrolled.
+     */
+    static constexpr uint64_t UNROLL_THRESHOLD = 64;
+
+    /**
+     * The machine function that is being lowered.
+     */
+    MachineFunction& MF;
+
+    /**
+     * Target instruction & register information.
+     */
+    const TargetInstrInfo* TII;
+    MachineRegisterInfo& MRI;
+
+    /**
+     * Retrieve the register class of a chunk.
+     *
+     * @param uint64_t size The size of the chunk (in bytes).
+     * @return const TargetRegisterClass* The register class.
+     */
+    const TargetRegisterClass* getChunkRegisterClass(uint64_t size) {
+        switch (size) {
+            case 8: return &X86::GR64RegClass;
+            case 4: return &X86::GR32RegClass;
+            case 2: return &X86::GR16RegClass;
+            default: return &X86::GR8RegClass;
+        }
+    }
+
+    /**
+     * Retrieve the sub register (of a 64-bit register) of a chunk.
+     *
+     * @param uint64_t size The size of the chunk (in bytes).
+     * @return unsigned The sub register index.
+     */
+    unsigned getChunkSubRegister(uint64_t size) {
+        switch (size) {
+            case 8: return X86::NoSubRegister;
+            case 4: return X86::sub_32bit;
+            case 2: return X86::sub_16bit;
+            default: return X86::sub_8bit;
+        }
+    }
+
+    /**
+     * Retrieve the `mov reg, [mem]` opcode of a chunk.
+     *
+     * @param uint64_t size The size of the chunk (in bytes).
+     * @return unsigned The opcode.
+     */
+    unsigned getLoadOpcode(uint64_t size) {
+        switch (size) {
+            case 8: return X86::MOV64rm;
+            case 4: return X86::MOV32rm;
+            case 2: return X86::MOV16rm;
+            default: return X86::MOV8rm;
+        }
+    }
+
+    /**
+     * Retrieve the `mov [mem], reg` opcode of a chunk.
+     *
+     * @param uint64_t size The size of the chunk (in bytes).
+     * @return unsigned The opcode.
+     */
+    unsigned getStoreOpcode(uint64_t size) {
+        switch (size) {
+            case 8: return X86::MOV64mr;
+            case 4: return X86::MOV32mr;
+            case 2: return X86::MOV16mr;
+            default: return X86::MOV8mr;
+        }
+    }
+
+public:
+
+    /**
+     * Constructor of the lowering.
+     *
+     * @param MachineFunction& MF The machine function to lower calls in.
+     */
+    InlineMemoryCallsLoweringAMD64(MachineFunction& MF) : MF(MF), TII(MF.getSubtarget().getInstrInfo()), MRI(MF.getRegInfo()) {}
+
+    /**
+     * Retrieve the registers of the first three (integer) arguments of the calling convention.
+     *
+     * @return SmallVector<MCRegister, 3> The argument registers.
+     */
+    SmallVector<MCRegister, 3> getArgumentRegisters() {
+        if (MF.getTarget().getTargetTriple().isOSWindows()) return { X86::RCX, X86::RDX, X86::R8 };
+        return { X86::RDI, X86::RSI, X86::RDX };
+    }
+
+    /**
+     * Retrieve the register of the return value.
+     *
+     * @return MCRegister The return register.
+     */
+    MCRegister getReturnRegister() {
+        return X86::RAX;
+    }
+
+    /**
+     * Retrieve the register class of pointers & lengths.
+     *
+     * @return const TargetRegisterClass* The register class.
+     */
+    const TargetRegisterClass* getPointerRegisterClass() {
+        return &X86::GR64RegClass;
+    }
+
+    /**
+     * Retrieve the register class of the (`int`) value of `memset`.
+     *
+     * @return const TargetRegisterClass* The register class.
+     */
+    const TargetRegisterClass* getValueRegisterClass() {
+        return &X86::GR32RegClass;
+    }
+
+    /**
+     * Retrieve the sub register index of the (`int`) value of `memset`, in its 64-bit argument register.
+     *
+     * @return unsigned The sub register index.
+     */
+    unsigned getValueSubRegister() {
+        return X86::sub_32bit;
+    }
+
+    /**
+     * Retrieve the immediate that an instruction moves into its destination register.
+     *
+     * @param const MachineInstr& instruction The instruction.
+     * @return std::optional<uint64_t> The immediate, if the instruction is a `mov reg, imm`.
+     */
+    std::optional<uint64_t> getMovImmediate(const MachineInstr& instruction) {
+        switch (instruction.getOpcode()) {
+            case X86::MOV32r0:
+                return 0;
+            case X86::MOV32ri:
+            case X86::MOV32ri64:
+                if (!instruction.getOperand(1).isImm()) return std::nullopt;
+                return (uint32_t) instruction.getOperand(1).getImm();
+            case X86::MOV64ri:
+            case X86::MOV64ri32:
+                if (!instruction.getOperand(1).isImm()) return std::nullopt;
+                return (uint64_t) instruction.getOperand(1).getImm();
+            default:
+                return std::nullopt;
+        }
+    }
+
+    /**
+     * Lower a `memcpy` call (in front of the call).
+     *
+     * @param MachineInstr& Call The call to lower.
+     * @param Register destination The (virtual) destination pointer.
+     * @param Register source The (virtual) source pointer.
+     * @param Register length The (virtual) amount of bytes.
+     * @param std::optional<uint64_t> constantLength The amount of bytes, if it is a constant.
+     */
+    void lowerMemcpy(MachineInstr& Call, Register destination, Register source, Register length, std::optional<uint64_t> constantLength) {
+        MachineBasicBlock& MBB = *Call.getParent();
+        DebugLoc DL = Call.getDebugLoc();
+
+        if (constantLength && *constantLength <= UNROLL_THRESHOLD) {
+            uint64_t offset = 0;
+
+            // 1. mov [chunk register], [source+offset]
+            // 2. mov [destination+offset], [chunk register]
+            for (uint64_t size = 8; size > 0; size /= 2) {
+                for (; *constantLength - offset >= size; offset += size) {
+                    Register chunk = MRI.createVirtualRegister(getChunkRegisterClass(size));
+                    BuildMI(MBB, Call, DL, TII->get(getLoadOpcode(size)), chunk).addReg(source).addImm(1).addReg(0).addImm(offset).addReg(0);
+                    BuildMI(MBB, Call, DL, TII->get(getStoreOpcode(size))).addReg(destination).addImm(1).addReg(0).addImm(offset).addReg(0).addReg(chunk);
+                }
+            }
+
+            return;
+        }
+
+        // 1. mov rdi, [destination]
+        // 2. mov rsi, [source]
+        // 3. mov rcx, [length]
+        // 4. rep movsb
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), X86::RDI).addReg(destination);
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), X86::RSI).addReg(source);
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), X86::RCX).addReg(length);
+        BuildMI(MBB, Call, DL, TII->get(X86::REP_MOVSB_64));
+    }
+
+    /**
+     * Lower a `memset` call (in front of the call).
+     *
+     * @param MachineInstr& Call The call to lower.
+     * @param Register destination The (virtual) destination pointer.
+     * @param Register value The (virtual, 32-bit) value of which the lowest byte is set.
+     * @param Register length The (virtual) amount of bytes.
+     * @param std::optional<uint64_t> constantLength The amount of bytes, if it is a constant.
+     */
+    void lowerMemset(MachineInstr& Call, Register destination, Register value, Register length, std::optional<uint64_t> constantLength) {
+        MachineBasicBlock& MBB = *Call.getParent();
+        DebugLoc DL = Call.getDebugLoc();
+
+        if (constantLength && *constantLength <= UNROLL_THRESHOLD) {
+            Register byte = MRI.createVirtualRegister(&X86::GR32RegClass);
+            Register extended = MRI.createVirtualRegister(&X86::GR64RegClass);
+            Register multiplier = MRI.createVirtualRegister(&X86::GR64RegClass);
+            Register splat = MRI.createVirtualRegister(&X86::GR64RegClass);
+
+            // 1. movzx [byte], [value]
+            // 2. mov [multiplier], 0x0101010101010101
+            // 3. imul [splat], [multiplier] (the byte in every byte of the splat)
+            BuildMI(MBB, Call, DL, TII->get(X86::MOVZX32rr8), byte).addReg(value, 0, X86::sub_8bit);
+            BuildMI(MBB, Call, DL, TII->get(TargetOpcode::SUBREG_TO_REG), extended).addImm(0).addReg(byte).addImm(X86::sub_32bit);
+            BuildMI(MBB, Call, DL, TII->get(X86::MOV64ri), multiplier).addImm(0x0101010101010101);
+            BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), splat).addReg(extended);
+            BuildMI(MBB, Call, DL, TII->get(X86::IMUL64rr), splat).addReg(splat).addReg(multiplier);
+
+            // 4. mov [destination+offset], [splat]
+            uint64_t offset = 0;
+
+            for (uint64_t size = 8; size > 0; size /= 2) {
+                for (; *constantLength - offset >= size; offset += size) {
+                    BuildMI(MBB, Call, DL, TII->get(getStoreOpcode(size))).addReg(destination).addImm(1).addReg(0).addImm(offset).addReg(0).addReg(splat, 0, getChunkSubRegister(size));
+                }
+            }
+
+            return;
+        }
+
+        // 1. mov rdi, [destination]
+        // 2. mov rcx, [length]
+        // 3. mov eax, [value]
+        // 4. rep stosb
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), X86::RDI).addReg(destination);
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), X86::RCX).addReg(length);
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), X86::EAX).addReg(value);
+        BuildMI(MBB, Call, DL, TII->get(X86::REP_STOSB_64));
+    }
+
+};
@@ -0,0 +1,360 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/AArch64/AArch64.h"
+#include "llvm/Target/AArch64/AArch64InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <optional>
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to lower `memcpy` and `memset` calls to inline ARM64 code.
+ *
+ * Small constant lengths are unrolled to 16-byte `ldp`/`stp` pairs and a 8/4/2/1-byte tail. Other lengths use
+ * a loop of 16-byte `ldp`/`stp` pairs, followed by a byte loop for the remainder.
+ */
+class InlineMemoryCallsLoweringARM64 {
+
+private:
+
+    /**
+     * Constant lengths (in bytes) up to this threshold are unrolled.
+     */
+    static constexpr uint64_t UNROLL_THRESHOLD = 64;
+
+    /**
+     * The machine function that is being lowered.
+     */
+    MachineFunction& MF;
+
+    /**
+     * Target instruction & register information.
+     */
+    const TargetInstrInfo* TII;
+    MachineRegisterInfo& MRI;
+
+    /**
+     * Emit the store of a chunk (`str` with an unsigned, scaled offset, or `stp` for 16 bytes).
+     *
+     * @param MachineBasicBlock& MBB The block to emit the store in.
+     * @param MachineBasicBlock::iterator position The position to emit the store at.
+     * @param Register chunk The (64-bit) register to store (twice for 16 bytes).
+     * @param Register destination The destination pointer.
+     * @param uint64_t offset The offset (a multiple of the size).
+     * @param uint64_t size The size of the chunk (in bytes).
+     */
+    void emitStore(MachineBasicBlock& MBB, MachineBasicBlock::iterator position, Register chunk, Register destination, uint64_t offset, uint64_t size) {
+        DebugLoc DL = position != MBB.end() ? position->getDebugLoc() : DebugLoc();
+
+        switch (size) {
+            case 16: BuildMI(MBB, position, DL, TII->get(AArch64::STPXi)).addReg(chunk).addReg(chunk).addReg(destination).addImm(offset / 8); break;
+            case 8: BuildMI(MBB, position, DL, TII->get(AArch64::STRXui)).addReg(chunk).addReg(destination).addImm(offset / 8); break;
+            case 4: BuildMI(MBB, position, DL, TII->get(AArch64::STRWui)).addReg(chunk, 0, AArch64::sub_32).addReg(destination).addImm(offset / 4); break;
+            case 2: BuildMI(MBB, position, DL, TII->get(AArch64::STRHHui)).addReg(chunk, 0, AArch64::sub_32).addReg(destination).addImm(offset / 2); break;
+            default: BuildMI(MBB, position, DL, TII->get(AArch64::STRBBui)).addReg(chunk, 0, AArch64::sub_32).addReg(destination).addImm(offset); break;
+        }
+    }
+
+    /**
+     * Emit the copy of a chunk (`ldr` & `str` with unsigned, scaled offsets, or `ldp` & `stp` for 16 bytes).
+     *
+     * @param MachineBasicBlock& MBB The block to emit the copy in.
+     * @param MachineBasicBlock::iterator position The position to emit the copy at.
+     * @param Register destination The destination pointer.
+     * @param Register source The source pointer.
+     * @param uint64_t offset The offset (a multiple of the size).
+     * @param uint64_t size The size of the chunk (in bytes).
+     */
+    void emitCopy(MachineBasicBlock& MBB, MachineBasicBlock::iterator position, Register destination, Register source, uint64_t offset, uint64_t size) {
+        DebugLoc DL = position != MBB.end() ? position->getDebugLoc() : DebugLoc();
+
+        if (size == 16) {
+            Register first = MRI.createVirtualRegister(&AArch64::GPR64RegClass);
+            Register second = MRI.createVirtualRegister(&AArch64::GPR64RegClass);
+            BuildMI(MBB, position, DL, TII->get(AArch64::LDPXi)).addReg(first, RegState::Define).addReg(second, RegState::Define).addReg(source).addImm(offset / 8);
+            BuildMI(MBB, position, DL, TII->get(AArch64::STPXi)).addReg(first).addReg(second).addReg(destination).addImm(offset / 8);
+            return;
+        }
+
+        if (size == 8) {
+            Register chunk = MRI.createVirtualRegister(&AArch64::GPR64RegClass);
+            BuildMI(MBB, position, DL, TII->get(AArch64::LDRXui), chunk).addReg(source).addImm(offset / 8);
+            BuildMI(MBB, position, DL, TII->get(AArch64::STRXui)).addReg(chunk).addReg(destination).addImm(offset / 8);
+            return;
+        }
+
+        Register chunk = MRI.createVirtualRegister(&AArch64::GPR32RegClass);
+
+        switch (size) {
+            case 4:
+                BuildMI(MBB, position, DL, TII->get(AArch64::LDRWui), chunk).addReg(source).addImm(offset / 4);
+                BuildMI(MBB, position, DL, TII->get(AArch64::STRWui)).addReg(chunk).addReg(destination).addImm(offset / 4);
+                break;
+            case 2:
+                BuildMI(MBB, position, DL, TII->get(AArch64::LDRHHui), chunk).addReg(source).addImm(offset / 2);
+                BuildMI(MBB, position, DL, TII->get(AArch64::STRHHui)).addReg(chunk).addReg(destination).addImm(offset / 2);
+                break;
+            default:
+                BuildMI(MBB, position, DL, TII->get(AArch64::LDRBBui), chunk).addReg(source).addImm(offset);
+                BuildMI(MBB, position, DL, TII->get(AArch64::STRBBui)).addReg(chunk).addReg(destination).addImm(offset);
+                break;
+        }
+    }
+
+    /**
+     * Emit the chunks of a constant length (16-byte pairs first, then the tail).
+     *
+     * @param MachineInstr& Call The call to emit the chunks in front of.
+     * @param Register destination The destination pointer.
+     * @param Register source The source pointer (or no register to store `splat`).
+     * @param Register splat The (64-bit) value to store (if there is no source).
+     * @param uint64_t length The amount of bytes.
+     */
+    void emitUnrolled(MachineInstr& Call, Register destination, Register source, Register splat, uint64_t length) {
+        MachineBasicBlock& MBB = *Call.getParent();
+        uint64_t offset = 0;
+
+        for (uint64_t size = 16; size > 0; size /= 2) {
+            for (; length - offset >= size; offset += size) {
+                if (source) emitCopy(MBB, MachineBasicBlock::iterator(Call), destination, source, offset, size);
+                else emitStore(MBB, MachineBasicBlock::iterator(Call), splat, destination, offset, size);
+            }
+        }
+    }
+
+    /**
+     * Emit loops over a variable length (16-byte pairs first, then single bytes) in front of a call.
+     *
+     * The block of the call is split, so that the loops run in between:
+     * - check16: if (remaining < 16) goto check1;
+     * - loop16:  copy or store 16 bytes; advance; remaining -= 16; goto check16;
+     * - check1:  if (remaining == 0) goto exit;
+     * - loop1:   copy or store 1 byte; advance; if (--remaining != 0) goto loop1;
+     * - exit:    the call and everything after it.
+     *
+     * @param MachineInstr& Call The call to emit the loops in front of.
+     * @param Register destination The destination pointer.
+     * @param Register source The source pointer (or no register to store `splat`).
+     * @param Register splat The (64-bit) value to store (if there is no source).
+     * @param Register length The amount of bytes.
+     */
+    void emitLoops(MachineInstr& Call, Register destination, Register source, Register splat, Register length) {
+        MachineBasicBlock& MBB = *Call.getParent();
+        DebugLoc DL = Call.getDebugLoc();
+
+        // The pointers & length are advanced by the loops (on copies, as the destination may be returned)
+        Register cursorDestination = MRI.createVirtualRegister(&AArch64::GPR64commonRegClass);
+        Register cursorSource = source ? MRI.createVirtualRegister(&AArch64::GPR64commonRegClass) : Register();
+        Register remaining = MRI.createVirtualRegister(&AArch64::GPR64commonRegClass);
+
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), cursorDestination).addReg(destination);
+        if (source) BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), cursorSource).addReg(source);
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::COPY), remaining).addReg(length);
+
+        // Split the block of the call, and insert the loop blocks in between (in fall through order)
+        MachineBasicBlock* check16 = MF.CreateMachineBasicBlock();
+        MachineBasicBlock* loop16 = MF.CreateMachineBasicBlock();
+        MachineBasicBlock* check1 = MF.CreateMachineBasicBlock();
+        MachineBasicBlock* loop1 = MF.CreateMachineBasicBlock();
+        MachineBasicBlock* exit = MF.CreateMachineBasicBlock();
+
+        MachineFunction::iterator following = std::next(MBB.getIterator());
+        for (MachineBasicBlock* block : { check16, loop16, check1, loop1, exit }) MF.insert(following, block);
+
+        exit->splice(exit->begin(), &MBB, MachineBasicBlock::iterator(Call), MBB.end());
+        exit->transferSuccessorsAndUpdatePHIs(&MBB);
+        MBB.addSuccessor(check16);
+
+        // check16: cmp [remaining], 16; b.lo check1
+        BuildMI(*check16, check16->end(), DL, TII->get(AArch64::SUBSXri)).addReg(MRI.createVirtualRegister(&AArch64::GPR64RegClass), RegState::Define | RegState::Dead).addReg(remaining).addImm(16).addImm(0);
+        BuildMI(*check16, check16->end(), DL, TII->get(AArch64::Bcc)).addImm(AArch64CC::LO).addMBB(check1);
+        check16->addSuccessor(check1);
+        check16->addSuccessor(loop16);
+
+        // loop16: ldp & stp (or stp of the splat); add [cursors], 16; sub [remaining], 16; b check16
+        if (source) emitCopy(*loop16, loop16->end(), cursorDestination, cursorSource, 0, 16);
+        else emitStore(*loop16, loop16->end(), splat, cursorDestination, 0, 16);
+
+        if (source) BuildMI(*loop16, loop16->end(), DL, TII->get(AArch64::ADDXri), cursorSource).addReg(cursorSource).addImm(16).addImm(0);
+        BuildMI(*loop16, loop16->end(), DL, TII->get(AArch64::ADDXri), cursorDestination).addReg(cursorDestination).addImm(16).addImm(0);
+        BuildMI(*loop16, loop16->end(), DL, TII->get(AArch64::SUBXri), remaining).addReg(remaining).addImm(16).addImm(0);
+        BuildMI(*loop16, loop16->end(), DL, TII->get(AArch64::B)).addMBB(check16);
+        loop16->addSuccessor(check16);
+
+        // check1: cbz [remaining], exit
+        BuildMI(*check1, check1->end(), DL, TII->get(AArch64::CBZX)).addReg(remaining).addMBB(exit);
+        check1->addSuccessor(exit);
+        check1->addSuccessor(loop1);
+
+        // loop1: ldrb & strb (or strb of the splat); add [cursors], 1; subs [remaining], 1; b.ne loop1
+        if (source) emitCopy(*loop1, loop1->end(), cursorDestination, cursorSource, 0, 1);
+        else emitStore(*loop1, loop1->end(), splat, cursorDestination, 0, 1);
+
+        if (source) BuildMI(*loop1, loop1->end(), DL, TII->get(AArch64::ADDXri), cursorSource).addReg(cursorSource).addImm(1).addImm(0);
+        BuildMI(*loop1, loop1->end(), DL, TII->get(AArch64::ADDXri), cursorDestination).addReg(cursorDestination).addImm(1).addImm(0);
+        BuildMI(*loop1, loop1->end(), DL, TII->get(AArch64::SUBSXri), remaining).addReg(remaining).addImm(1).addImm(0);
+        BuildMI(*loop1, loop1->end(), DL, TII->get(AArch64::Bcc)).addImm(AArch64CC::NE).addMBB(loop1);
+        loop1->addSuccessor(loop1);
+        loop1->addSuccessor(exit);
+    }
+
+public:
+
+    /**
+     * Constructor of the lowering.
+     *
+     * @param MachineFunction& MF The machine function to lower calls in.
+     */
+    InlineMemoryCallsLoweringARM64(MachineFunction& MF) : MF(MF), TII(MF.getSubtarget().getInstrInfo()), MRI(MF.getRegInfo()) {}
+
+    /**
+     * Retrieve the registers of the first three (integer) arguments of the calling convention.
+     *
+     * @return SmallVector<MCRegister, 3> The argument registers.
+     */
+    SmallVector<MCRegister, 3> getArgumentRegisters() {
+        return { AArch64::X0, AArch64::X1, AArch64::X2 };
+    }
+
+    /**
+     * Retrieve the register of the return value.
+     *
+     * @return MCRegister The return register.
+     */
+    MCRegister getReturnRegister() {
+        return AArch64::X0;
+    }
+
+    /**
+     * Retrieve the register class of pointers & lengths (which are used as base registers of loads & stores).
+     *
+     * @return const TargetRegisterClass* The register class.
+     */
+    const TargetRegisterClass* getPointerRegisterClass() {
+        return &AArch64::GPR64commonRegClass;
+    }
+
+    /**
+     * Retrieve the register class of the (`int`) value of `memset`.
+     *
+     * @return const TargetRegisterClass* The register class.
+     */
+    const TargetRegisterClass* getValueRegisterClass() {
+        return &AArch64::GPR32RegClass;
+    }
+
+    /**
+     * Retrieve the sub register index of the (`int`) value of `memset`, in its 64-bit argument register.
+     *
+     * @return unsigned The sub register index.
+     */
+    unsigned getValueSubRegister() {
+        return AArch64::sub_32;
+    }
+
+    /**
+     * Retrieve the immediate that an instruction moves into its destination register.
+     *
+     * @param const MachineInstr& instruction The instruction.
+     * @return std::optional<uint64_t> The immediate, if the instruction is a `mov reg, imm`.
+     */
+    std::optional<uint64_t> getMovImmediate(const MachineInstr& instruction) {
+        switch (instruction.getOpcode()) {
+            case AArch64::MOVi32imm:
+                if (!instruction.getOperand(1).isImm()) return std::nullopt;
+                return (uint32_t) instruction.getOperand(1).getImm();
+            case AArch64::MOVi64imm:
+                if (!instruction.getOperand(1).isImm()) return std::nullopt;
+                return (uint64_t) instruction.getOperand(1).getImm();
+            case AArch64::MOVZWi:
+            case AArch64::MOVZXi:
+                if (!instruction.getOperand(1).isImm() || !instruction.getOperand(2).isImm()) return std::nullopt;
+                return (uint64_t) instruction.getOperand(1).getImm() << instruction.getOperand(2).getImm();
+            default:
+                return std::nullopt;
+        }
+    }
+
+    /**
+     * Lower a `memcpy` call (in front of the call, which may end up in a new block).
+     *
+     * @param MachineInstr& Call The call to lower.
+     * @param Register destination The (virtual) destination pointer.
+     * @param Register source The (virtual) source pointer.
+     * @param Register length The (virtual) amount of bytes.
+     * @param std::optional<uint64_t> constantLength The amount of bytes, if it is a constant.
+     */
+    void lowerMemcpy(MachineInstr& Call, Register destination, Register source, Register length, std::optional<uint64_t> constantLength) {
+        if (constantLength && *constantLength <= UNROLL_THRESHOLD) {
+            emitUnrolled(Call, destination, source, Register(), *constantLength);
+        } else {
+            emitLoops(Call, destination, source, Register(), length);
+        }
+    }
+
+    /**
+     * Lower a `memset` call (in front of the call, which may end up in a new block).
+     *
+     * @param MachineInstr& Call The call to lower.
+     * @param Register destination The (virtual) destination pointer.
+     * @param Register value The (virtual, 32-bit) value of which the lowest byte is set.
+     * @param Register length The (virtual) amount of bytes.
+     * @param std::optional<uint64_t> constantLength The amount of bytes, if it is a constant.
+     */
+    void lowerMemset(MachineInstr& Call, Register destination, Register value, Register length, std::optional<uint64_t> constantLength) {
+        MachineBasicBlock& MBB = *Call.getParent();
+        DebugLoc DL = Call.getDebugLoc();
+
+        Register extended = MRI.createVirtualRegister(&AArch64::GPR64RegClass);
+        Register byte = MRI.createVirtualRegister(&AArch64::GPR64RegClass);
+        Register multiplier = MRI.createVirtualRegister(&AArch64::GPR64RegClass);
+        Register splat = MRI.createVirtualRegister(&AArch64::GPR64RegClass);
+
+        // 1. uxtb [byte], [value]
+        // 2. mov [multiplier], 0x0101010101010101
+        // 3. mul [splat], [byte], [multiplier] (the byte in every byte of the splat)
+        BuildMI(MBB, Call, DL, TII->get(TargetOpcode::SUBREG_TO_REG), extended).addImm(0).addReg(value).addImm(AArch64::sub_32);
+        BuildMI(MBB, Call, DL, TII->get(AArch64::UBFMXri), byte).addReg(extended).addImm(0).addImm(7);
+        BuildMI(MBB, Call, DL, TII->get(AArch64::MOVi64imm), multiplier).addImm(0x0101010101010101);
+        BuildMI(MBB, Call, DL, TII->get(AArch64::MADDXrrr), splat).addReg(byte).addReg(multiplier).addReg(AArch64::XZR);
+
+        if (constantLength && *constantLength <= UNROLL_THRESHOLD) {
+            emitUnrolled(Call, destination, Register(), splat, *constantLength);
+        } else {
+            emitLoops(Call, destination, Register(), splat, length);
+        }
+    }
+
+};
@@ -15,6 +15,7 @@
 /**
  * LLVM includes
  */
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstr.h"
@@ -35,6 +36,7 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/X86/X86.h"
@@ -46,9 +48,11 @@
  * Regular includes
  */
 #include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+#include "../../helpers/TransformOptionRegistry.cpp"
 
 /**
- * Modify `mov` immediate substitution options
+ * Semantic noise insertion options
  */
 #include "options_amd64/InsertSemanticNoiseOptionAMD64.cpp"
 #include "options_arm64/InsertSemanticNoiseOptionARM64.cpp"
@@ -68,6 +72,11 @@ using namespace llvm;
  * - lin-arm64: https://mirror.nl.leaseweb.net/debian-cd/current/arm64/iso-dvd/
  * - mac-amd64: to-do
  * - mac-arm64: to-do
+ *
+ * Noise is only inserted where it is never executed: behind blocks that cannot fall through (after a
+ * return, an unconditional branch, a trap or a `noreturn` call), which includes the padding after the
+ * last block of the function. Branch probabilities are heuristics, so branches that are merely unlikely
+ * are never used as insertion point. The added bytes count against the growth budget (`MM_MAX_GROWTH`).
  */
 class InsertSemanticNoiseModule {
 
@@ -78,16 +87,6 @@ private:
      */
     bool modified = false;
 
-    /**
-     * List of lambdas that invoke the `run` methods of AMD64 option classes.
-     */
-    std::vector<std::function<bool(MachineFunction&, bool)>> options_amd64;
-
-    /**
-     * List of lambdas that invoke the `run` methods of ARM64 option classes.
-     */
-    std::vector<std::function<bool(MachineFunction&, bool)>> options_arm64;
-
     /**
      * Whether the module is enabled (default) or disabled.
      * 
@@ -114,44 +113,25 @@ private:
 
 public:
 
-    /**
-     * Constructor that initializes the list of substitution option classes.
-     */
-    InsertSemanticNoiseModule() {
-        options_amd64 = {
-            [&](MachineFunction &MF, bool isBeingTested) { return InsertSemanticNoiseOptionAMD64().runOnMachineFunction(MF, isBeingTested); }
-        };
-
-        options_arm64 = {
-            [&](MachineFunction &MF, bool isBeingTested) { return InsertSemanticNoiseOptionARM64().runOnMachineFunction(MF, isBeingTested); }
-        };
-    }
-
     /**
      * Main execution method for the InsertSemanticNoiseModule class.
      *
      * @param MachineFunction& MF The machine function to run the substitution on.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF) {
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
         // Ensure module is enabled
         if (!moduleIsEnabled()) return false;
         bool isBeingTested = moduleIsBeingTested();
 
-        // Run random compatible options
+        // Ensure the architecture is supported
         auto architecture = MF.getTarget().getTargetTriple().getArch();
-        int index = 0;
 
         switch (architecture) {
-            // AMD64
+            // AMD64 & ARM64
             case Triple::x86_64:
-                index = std::rand() % options_amd64.size();
-                modified = options_amd64[index](MF, isBeingTested) || modified;
-                break;
-            // ARM64
             case Triple::aarch64:
-                index = std::rand() % options_arm64.size();
-                modified = options_arm64[index](MF, isBeingTested) || modified;
                 break;
             // Unknown architecture
             default:
@@ -159,6 +139,58 @@ public:
                 break;
         }
 
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: InsertSemanticNoise(isBeingTested=" << isBeingTested << ").\n";
+
+        // Pick a random compatible option for each instruction, weighted by the cost model of the target
+        TransformOptionSampler sampler("InsertSemanticNoise", MF);
+        if (!sampler.hasOptions()) return modified;
+
+        std::vector<TransformContext::Candidate> candidates;
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                const TransformOption* option = sampler.pick(Instruction);
+                if (!option) continue;
+
+                // Lower the density of modifications in hot code (unless the module is being tested)
+                if (!moduleIsBeingTested() && !context.shouldModify(MachineBasicBlock)) continue;
+
+                candidates.push_back({ &Instruction, option, sampler.getCandidateCount() });
+            }
+        }
+
+        // Remember the original blocks, as every insertion adds a new block
+        SmallPtrSet<const MachineBasicBlock*, 16> original;
+        for (auto &MachineBasicBlock : MF) original.insert(&MachineBasicBlock);
+
+        // Apply the options (ranked & picked under the growth budget, if any)
+        if (context.applyOptions(candidates)) {
+            modified = true;
+        }
+
+        // Report the overhead, where the dynamic overhead must be zero (noise blocks must not have predecessors)
+        unsigned blocks = 0;
+        unsigned reachableInstructions = 0;
+
+        for (auto &MachineBasicBlock : MF) {
+            if (original.count(&MachineBasicBlock)) continue;
+            blocks++;
+
+            if (MachineBasicBlock.pred_empty()) continue;
+
+            for (const MachineInstr& Instruction : MachineBasicBlock) {
+                if (!Instruction.isInlineAsm()) continue;
+                reachableInstructions += Instruction.getOperand(0).getSymbolName().count('\n') + 1;
+            }
+
+            dbgs() << "          ↳ Noise block `" << MachineBasicBlock.getName() << "` has " << MachineBasicBlock.pred_size() << " predecessor(s), so it may be executed.\n";
+        }
+
+        dbgs() << "          ✓ Inserted " << blocks << " noise block(s), " << format("%.0f", context.getGrowth("InsertSemanticNoise")) << " static byte(s), " << reachableInstructions << " reachable instruction(s).\n";
+
         return modified;
     }
 
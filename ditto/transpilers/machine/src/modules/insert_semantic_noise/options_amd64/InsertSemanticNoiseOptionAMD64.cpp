@@ -15,6 +15,8 @@
 /**
  * LLVM includes
  */
+#include "llvm/CodeGen/LivePhysRegs.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstr.h"
@@ -28,6 +30,7 @@
 #include "llvm/CodeGen/TargetPassConfig.h"
 #include "llvm/CodeGen/TargetRegisterInfo.h"
 #include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Module.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/MC/TargetRegistry.h"
@@ -35,6 +38,7 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/X86/X86.h"
@@ -45,7 +49,12 @@
 /**
  * Regular includes
  */
+#include <optional>
+#include <string>
 #include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/NoiseCorpusHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Namespace(s) to use
@@ -53,7 +62,12 @@
 using namespace llvm;
 
 /**
- * A class to obfuscate mov immediate values.
+ * A class to insert a harvested basic block (semantic noise) behind a block that cannot fall through.
+ *
+ * The noise is placed in a new block without predecessors, right after a block that ends in a `ret`,
+ * an unconditional `jmp`, a trap or a call without successors (`noreturn`). It is therefore never
+ * executed (zero dynamic instructions). After the last block of the function, this pads the space
+ * between functions. The noise is emitted verbatim (`.byte`), as harvested from the trusted binary.
  */
 class InsertSemanticNoiseOptionAMD64 {
 
@@ -66,36 +80,90 @@ private:
 
 public:
 
+    /**
+     * Check if semantic noise can be inserted after the given instruction by the InsertSemanticNoiseOptionAMD64 class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if noise can be inserted after the instruction.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        MachineBasicBlock* MBB = const_cast<MachineBasicBlock*>(instruction.getParent());
+
+        // Noise may only follow the last instruction of a block that never falls through
+        if (instruction.isBundled() || &*MBB->getLastNonDebugInstr() != &instruction) return false;
+        if (MBB->canFallThrough()) return false;
+
+        return NoiseCorpusHelper::getCorpus(MBB->getParent()->getTarget().getTargetTriple()).isLoaded();
+    }
+
     /**
      * Main execution method for the InsertSemanticNoiseOptionAMD64 class.
      *
-     * @param MachineFunction& MF The machine function to run the substitution on.
-     * @param bool isBeingTested Whether all the occurrences should be modified (for testing purposes).
+     * @param MachineInstr& Instruction The instruction to insert semantic noise after.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF, bool isBeingTested) {
-        // Local variables
-        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
-        MachineRegisterInfo &MRI = MF.getRegInfo();
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
+        MachineBasicBlock& MBB = *Instruction.getParent();
+        MachineFunction& MF = *MBB.getParent();
+        const TargetInstrInfo* TII = MF.getSubtarget().getInstrInfo();
+        MachineFunction::iterator following = std::next(MBB.getIterator());
+
+        // The noise may not clobber registers that are live at the insertion point (or reserved)
+        LivePhysRegs live(*MF.getSubtarget().getRegisterInfo());
+        if (following != MF.end()) live.addLiveIns(*following);
+
+        NoiseCorpusHelper& corpus = NoiseCorpusHelper::getCorpus(MF.getTarget().getTargetTriple());
+        uint64_t allowed = corpus.getAllowedFootprint(live, MF.getRegInfo());
+
+        // Prefer any length, but fall back to shorter blocks if the noise doesn't fit in the growth budget
+        std::optional<NoiseBlock> noise;
+        for (unsigned maximumInstructions = 128; maximumInstructions >= 2 && !noise; maximumInstructions /= 2) {
+            noise = corpus.sample(allowed, maximumInstructions);
+            if (noise && !context.fitsGrowth(noise->bytes.size())) noise.reset();
+        }
 
-        // Inform user that we are running this option of the module
-        dbgs() << "        ↳ Running AMD64 module: InsertSemanticNoise(isBeingTested=" << isBeingTested << ").\n";
+        if (!noise) {
+            dbgs() << "          ↳ Skipping insertion point because no noise block leaves the live registers intact (and fits in the growth budget).\n";
+            return false;
+        }
 
-        // For each line in each basic block, perform our substitution
-        for (auto &MachineBasicBlock : MF) {
-            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
-                MachineInstr &Instruction = *MachineInstruction++;
+        // One `.byte` directive per harvested instruction
+        std::string assembly;
+        size_t offset = 0;
 
-                // Instruction.eraseFromParent();
-                // modified = true;
+        for (uint8_t length : noise->lengths) {
+            assembly += assembly.empty() ? ".byte " : "\n\t.byte ";
+
+            for (size_t index = offset; index < offset + length; index++) {
+                assembly += (index != offset ? ", " : "") + formatv("{0:x2}", noise->bytes[index]).str();
             }
+
+            offset += length;
         }
 
+        MachineBasicBlock* block = MF.CreateMachineBasicBlock();
+        MF.insert(following, block);
+
+        BuildMI(*block, block->end(), DebugLoc(), TII->get(TargetOpcode::INLINEASM))
+            .addExternalSymbol(MF.createExternalSymbolName(assembly))
+            .addImm(InlineAsm::Extra_HasSideEffects);
+
+        context.recordGrowth("InsertSemanticNoise", noise->bytes.size());
+        dbgs() << "          ✓ Inserted " << noise->lengths.size() << " instruction(s) of noise (" << noise->bytes.size() << " byte(s)) after `" << MBB.getName() << "`.\n";
+
+        modified = true;
         return modified;
     }
 
-private:
-
-   // Any supporting functions
+};
 
-};
\ No newline at end of file
+/**
+ * Register the option with the transform option registry (as `InsertSemanticNoise` option `CORPUS`).
+ */
+static RegisterTransformOption<InsertSemanticNoiseOptionAMD64> InsertSemanticNoiseOptionAMD64Registration(
+    "InsertSemanticNoise", "CORPUS", Triple::x86_64,
+    { X86::RET, X86::RET64, X86::JMP_1, X86::JMP_4, X86::JMP64r, X86::JMP64m, X86::TRAP, X86::TCRETURNdi64, X86::TCRETURNri64, X86::CALL64pcrel32, X86::CALL64r, X86::CALL64m },
+    { },
+    1
+);
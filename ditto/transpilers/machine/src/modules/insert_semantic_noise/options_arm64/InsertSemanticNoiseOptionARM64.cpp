@@ -15,6 +15,8 @@
 /**
  * LLVM includes
  */
+#include "llvm/CodeGen/LivePhysRegs.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstr.h"
@@ -28,6 +30,7 @@
 #include "llvm/CodeGen/TargetPassConfig.h"
 #include "llvm/CodeGen/TargetRegisterInfo.h"
 #include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Module.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/MC/TargetRegistry.h"
@@ -35,17 +38,22 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
-#include "llvm/Target/X86/X86.h"
-#include "llvm/Target/X86/X86InstrInfo.h"
-#include "llvm/Target/X86/X86TargetMachine.h"
+#include "llvm/Target/AArch64/AArch64.h"
+#include "llvm/Target/AArch64/AArch64InstrInfo.h"
 #include "llvm/TargetParser/Triple.h"
 
 /**
  * Regular includes
  */
+#include <optional>
+#include <string>
 #include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/NoiseCorpusHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Namespace(s) to use
@@ -53,7 +61,12 @@
 using namespace llvm;
 
 /**
- * A class to obfuscate mov immediate values.
+ * A class to insert a harvested basic block (semantic noise) behind a block that cannot fall through.
+ *
+ * The noise is placed in a new block without predecessors, right after a block that ends in a `ret`,
+ * an unconditional `b`/`br`, a `brk` or a call without successors (`noreturn`). It is therefore never
+ * executed (zero dynamic instructions). After the last block of the function, this pads the space
+ * between functions. The noise is emitted verbatim (`.inst`, so that it is disassembled as code).
  */
 class InsertSemanticNoiseOptionARM64 {
 
@@ -66,36 +79,85 @@ private:
 
 public:
 
+    /**
+     * Check if semantic noise can be inserted after the given instruction by the InsertSemanticNoiseOptionARM64 class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if noise can be inserted after the instruction.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        MachineBasicBlock* MBB = const_cast<MachineBasicBlock*>(instruction.getParent());
+
+        // Noise may only follow the last instruction of a block that never falls through
+        if (instruction.isBundled() || &*MBB->getLastNonDebugInstr() != &instruction) return false;
+        if (MBB->canFallThrough()) return false;
+
+        return NoiseCorpusHelper::getCorpus(MBB->getParent()->getTarget().getTargetTriple()).isLoaded();
+    }
+
     /**
      * Main execution method for the InsertSemanticNoiseOptionARM64 class.
      *
-     * @param MachineFunction& MF The machine function to run the substitution on.
-     * @param bool isBeingTested Whether all the occurrences should be modified (for testing purposes).
+     * @param MachineInstr& Instruction The instruction to insert semantic noise after.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF, bool isBeingTested) {
-        // Local variables
-        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
-        MachineRegisterInfo &MRI = MF.getRegInfo();
-
-        // Inform user that we are running this option of the module
-        dbgs() << "        ↳ Running ARM64 module: InsertSemanticNoise(isBeingTested=" << isBeingTested << ").\n";
-
-        // For each line in each basic block, perform our substitution
-        for (auto &MachineBasicBlock : MF) {
-            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
-                MachineInstr &Instruction = *MachineInstruction++;
-
-                // Instruction.eraseFromParent();
-                // modified = true;
-            }
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
+        MachineBasicBlock& MBB = *Instruction.getParent();
+        MachineFunction& MF = *MBB.getParent();
+        const TargetInstrInfo* TII = MF.getSubtarget().getInstrInfo();
+        MachineFunction::iterator following = std::next(MBB.getIterator());
+
+        // The noise may not clobber registers that are live at the insertion point (or reserved)
+        LivePhysRegs live(*MF.getSubtarget().getRegisterInfo());
+        if (following != MF.end()) live.addLiveIns(*following);
+
+        NoiseCorpusHelper& corpus = NoiseCorpusHelper::getCorpus(MF.getTarget().getTargetTriple());
+        uint64_t allowed = corpus.getAllowedFootprint(live, MF.getRegInfo());
+
+        // Prefer any length, but fall back to shorter blocks if the noise doesn't fit in the growth budget
+        std::optional<NoiseBlock> noise;
+        for (unsigned maximumInstructions = 128; maximumInstructions >= 2 && !noise; maximumInstructions /= 2) {
+            noise = corpus.sample(allowed, maximumInstructions);
+            if (noise && (noise->bytes.size() != 4 * noise->lengths.size() || !context.fitsGrowth(noise->bytes.size()))) noise.reset();
+        }
+
+        if (!noise) {
+            dbgs() << "          ↳ Skipping insertion point because no noise block leaves the live registers intact (and fits in the growth budget).\n";
+            return false;
         }
 
+        // One `.inst` directive per harvested (little endian) instruction
+        std::string assembly;
+
+        for (size_t offset = 0; offset < noise->bytes.size(); offset += 4) {
+            const uint8_t* bytes = noise->bytes.data() + offset;
+            uint32_t encoding = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+            assembly += (assembly.empty() ? ".inst " : "\n\t.inst ") + formatv("{0:x8}", encoding).str();
+        }
+
+        MachineBasicBlock* block = MF.CreateMachineBasicBlock();
+        MF.insert(following, block);
+
+        BuildMI(*block, block->end(), DebugLoc(), TII->get(TargetOpcode::INLINEASM))
+            .addExternalSymbol(MF.createExternalSymbolName(assembly))
+            .addImm(InlineAsm::Extra_HasSideEffects);
+
+        context.recordGrowth("InsertSemanticNoise", noise->bytes.size());
+        dbgs() << "          ✓ Inserted " << noise->lengths.size() << " instruction(s) of noise (" << noise->bytes.size() << " byte(s)) after `" << MBB.getName() << "`.\n";
+
+        modified = true;
         return modified;
     }
 
-private:
-
-   // Any supporting functions
+};
 
-};
\ No newline at end of file
+/**
+ * Register the option with the transform option registry (as `InsertSemanticNoise` option `CORPUS`).
+ */
+static RegisterTransformOption<InsertSemanticNoiseOptionARM64> InsertSemanticNoiseOptionARM64Registration(
+    "InsertSemanticNoise", "CORPUS", Triple::aarch64,
+    { AArch64::RET, AArch64::RET_ReallyLR, AArch64::B, AArch64::BR, AArch64::BRK, AArch64::TCRETURNdi, AArch64::TCRETURNri, AArch64::BL, AArch64::BLR },
+    { },
+    1
+);
@@ -0,0 +1,277 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/CodeGen/MachineBranchProbabilityInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to randomize the order of the basic blocks of a machine function.
+ *
+ * Blocks connected by a hot edge (see `MachineBranchProbabilityInfo::isEdgeHot`) are kept together as a chain,
+ * so that the hot path keeps falling through. All chains except the one of the entry block are shuffled.
+ * Afterwards the terminators are updated, which inverts conditional branches and inserts or removes
+ * unconditional jumps where needed.
+ */
+class RandomizeBlockLayoutModule {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* MM_RANDOMIZE_BLOCK_LAYOUT = std::getenv("MM_RANDOMIZE_BLOCK_LAYOUT");
+        bool result = (MM_RANDOMIZE_BLOCK_LAYOUT && std::string(MM_RANDOMIZE_BLOCK_LAYOUT) == "true");
+
+        return result || moduleIsBeingTested();
+    }
+
+    /**
+     * Whether the module is being feature tested or not (default).
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsBeingTested() {
+        const char* MM_TEST_RANDOMIZE_BLOCK_LAYOUT = std::getenv("MM_TEST_RANDOMIZE_BLOCK_LAYOUT");
+        bool result = (MM_TEST_RANDOMIZE_BLOCK_LAYOUT && std::string(MM_TEST_RANDOMIZE_BLOCK_LAYOUT) == "true");
+
+        return result;
+    }
+
+    /**
+     * Check if the terminators of every block can be updated after the layout changes.
+     *
+     * @param MachineFunction& MF The machine function to check.
+     * @return bool Positive if every block with successors has analyzable terminators.
+     */
+    bool isLayoutChangeable(MachineFunction& MF) {
+        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+
+        for (auto &MachineBasicBlock : MF) {
+            if (MachineBasicBlock.isEHPad() || MachineBasicBlock.isEHFuncletEntry()) return false;
+            if (MachineBasicBlock.succ_empty()) continue;
+
+            llvm::MachineBasicBlock *TBB = nullptr;
+            llvm::MachineBasicBlock *FBB = nullptr;
+            SmallVector<MachineOperand, 4> Cond;
+
+            if (TII->analyzeBranch(MachineBasicBlock, TBB, FBB, Cond)) return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Group the blocks into chains, where every hot edge (in order of frequency) keeps falling through.
+     *
+     * @param MachineFunction& MF The machine function to group the blocks of.
+     * @param TransformContext& context State shared by all modules (e.g. block frequency & branch probability information).
+     * @return std::vector<std::vector<MachineBasicBlock*>> The chains, in original order of their first block.
+     */
+    std::vector<std::vector<MachineBasicBlock*>> getChains(MachineFunction& MF, TransformContext& context) {
+        MachineBranchProbabilityInfo& MBPI = context.getBranchProbabilityInfo();
+        MachineBasicBlock* entry = &MF.front();
+
+        struct Edge {
+            MachineBasicBlock* from;
+            MachineBasicBlock* to;
+            double frequency;
+        };
+
+        std::vector<Edge> edges;
+        for (auto &MachineBasicBlock : MF) {
+            for (llvm::MachineBasicBlock* successor : MachineBasicBlock.successors()) {
+                if (successor == entry || successor == &MachineBasicBlock || !MBPI.isEdgeHot(&MachineBasicBlock, successor)) continue;
+
+                double probability = (double) MBPI.getEdgeProbability(&MachineBasicBlock, successor).getNumerator() / BranchProbability::getDenominator();
+                edges.push_back({ &MachineBasicBlock, successor, context.getRelativeFrequency(MachineBasicBlock) * probability });
+            }
+        }
+
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.frequency > b.frequency; });
+
+        DenseMap<MachineBasicBlock*, MachineBasicBlock*> next;
+        DenseMap<MachineBasicBlock*, MachineBasicBlock*> previous;
+
+        for (const Edge& edge : edges) {
+            if (next.count(edge.from) || previous.count(edge.to)) continue;
+
+            // Don't close a cycle (the chain of `from` may not start with `to`)
+            MachineBasicBlock* head = edge.from;
+            while (previous.count(head)) head = previous[head];
+            if (head == edge.to) continue;
+
+            next[edge.from] = edge.to;
+            previous[edge.to] = edge.from;
+        }
+
+        std::vector<std::vector<MachineBasicBlock*>> result;
+        for (auto &MachineBasicBlock : MF) {
+            if (previous.count(&MachineBasicBlock)) continue;
+
+            std::vector<llvm::MachineBasicBlock*> chain;
+            for (llvm::MachineBasicBlock* block = &MachineBasicBlock; block; block = next.lookup(block)) {
+                chain.push_back(block);
+            }
+
+            result.push_back(chain);
+        }
+
+        return result;
+    }
+
+    /**
+     * Move the blocks into the given order, and update their terminators accordingly.
+     *
+     * @param MachineFunction& MF The machine function to reorder the blocks of.
+     * @param const std::vector<MachineBasicBlock*>& order The new order of all blocks.
+     * @param TransformContext& context State shared by all modules.
+     * @return double The growth (in bytes) of the terminators.
+     */
+    double applyOrder(MachineFunction& MF, const std::vector<MachineBasicBlock*>& order, TransformContext& context) {
+        DenseMap<MachineBasicBlock*, MachineBasicBlock*> previousLayoutSuccessor;
+        double result = 0;
+
+        for (auto &MachineBasicBlock : MF) {
+            auto following = std::next(MachineBasicBlock.getIterator());
+            previousLayoutSuccessor[&MachineBasicBlock] = (following == MF.end()) ? nullptr : &*following;
+            result -= context.getSize(MachineBasicBlock);
+        }
+
+        for (MachineBasicBlock* block : order) {
+            MF.splice(MF.end(), block);
+        }
+
+        for (MachineBasicBlock* block : order) {
+            if (!block->succ_empty()) block->updateTerminator(previousLayoutSuccessor[block]);
+            result += context.getSize(*block);
+        }
+
+        MF.RenumberBlocks();
+        return result;
+    }
+
+public:
+
+    /**
+     * Main execution method for the RandomizeBlockLayoutModule class.
+     *
+     * @param MachineFunction& MF The machine function to reorder the blocks of.
+     * @param TransformContext& context State shared by all modules (e.g. block frequency & branch probability information).
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+
+        // Ensure the architecture is supported
+        auto architecture = MF.getTarget().getTargetTriple().getArch();
+
+        switch (architecture) {
+            // AMD64 & ARM64 (the terminators are updated through target hooks)
+            case Triple::x86_64:
+            case Triple::aarch64:
+                break;
+            // Unknown architecture
+            default:
+                report_fatal_error(formatv("RandomizeBlockLayoutModule failed due to unknown architecture: {0}.", architecture));
+                break;
+        }
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: RandomizeBlockLayout().\n";
+
+        if (MF.size() < 3) return modified;
+
+        if (!isLayoutChangeable(MF)) {
+            dbgs() << "          ↳ Skipping machine function because not all terminators can be analyzed.\n";
+            return modified;
+        }
+
+        std::vector<MachineBasicBlock*> original;
+        std::vector<MachineBasicBlock*> order;
+
+        for (auto &MachineBasicBlock : MF) original.push_back(&MachineBasicBlock);
+
+        // Shuffle all chains, except the chain of the entry block (which must stay first). Functions with few
+        // chains often end up in their original layout, so that is retried a few times.
+        std::vector<std::vector<MachineBasicBlock*>> chains = getChains(MF, context);
+
+        for (unsigned attempt = 0; attempt < 8 && (order.empty() || order == original); attempt++) {
+            std::shuffle(chains.begin() + 1, chains.end(), RandomHelper::getRandomGenerator());
+
+            order.clear();
+            for (const auto& chain : chains) order.insert(order.end(), chain.begin(), chain.end());
+        }
+
+        if (order == original) {
+            dbgs() << "          ↳ Random layout is equal to the original layout.\n";
+            return modified;
+        }
+
+        double growth = applyOrder(MF, order, context);
+
+        // Inserted jumps must fit in the growth budget
+        if (!context.fitsGrowth(growth)) {
+            dbgs() << "          ↳ Restoring the original layout because " << format("%.0f", growth) << " byte(s) of jumps don't fit in the growth budget.\n";
+            growth += applyOrder(MF, original, context);
+
+            context.recordGrowth("RandomizeBlockLayout", growth);
+            return modified;
+        }
+
+        context.recordGrowth("RandomizeBlockLayout", growth);
+        dbgs() << "          ✓ Shuffled " << chains.size() << " chain(s) of " << MF.size() << " block(s), " << format("%.0f", growth) << " byte(s) of growth.\n";
+
+        modified = true;
+        return modified;
+    }
+
+};
@@ -0,0 +1,231 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/X86/X86.h"
+#include "llvm/Target/X86/X86InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to randomize the encoding of instructions that have several equivalent encodings.
+ *
+ * On AMD64, register to register `mov` and ALU instructions can be encoded with the `r/m` operand as
+ * destination (e.g. `0x89`) or as source (e.g. `0x8B`). Both forms have the same length and speed, and
+ * decode to the same instruction. This module randomly picks one of them, which only changes the bytes.
+ *
+ * Register to register moves are still `COPY` pseudo instructions at this point (they are expanded after
+ * prologue & epilogue insertion), so plain general purpose register copies are lowered to either encoding here.
+ */
+class RandomizeEncodingsModule {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+    /**
+     * Amount of instructions that got an alternate encoding.
+     */
+    unsigned swapped = 0;
+
+    /**
+     * Amount of `COPY` instructions that were lowered to a `mov` of a random encoding.
+     */
+    unsigned lowered = 0;
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* MM_RANDOMIZE_ENCODINGS = std::getenv("MM_RANDOMIZE_ENCODINGS");
+        bool result = (MM_RANDOMIZE_ENCODINGS && std::string(MM_RANDOMIZE_ENCODINGS) == "true");
+
+        return result || moduleIsBeingTested();
+    }
+
+    /**
+     * Whether the module is being feature tested or not (default).
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsBeingTested() {
+        const char* MM_TEST_RANDOMIZE_ENCODINGS = std::getenv("MM_TEST_RANDOMIZE_ENCODINGS");
+        bool result = (MM_TEST_RANDOMIZE_ENCODINGS && std::string(MM_TEST_RANDOMIZE_ENCODINGS) == "true");
+
+        return result;
+    }
+
+    /**
+     * Retrieve the alternate encodings of AMD64 instructions (in both directions).
+     *
+     * The `_REV` opcodes have the same operands as their regular counterpart, but swap the `reg`
+     * and `r/m` fields of the ModRM byte (and thus use the opcode with the other direction bit).
+     *
+     * @return const DenseMap<unsigned, unsigned>& The alternate opcode of every opcode.
+     */
+    static const DenseMap<unsigned, unsigned>& getAlternatesAMD64() {
+        static DenseMap<unsigned, unsigned> result;
+        if (!result.empty()) return result;
+
+        const unsigned pairs[][2] = {
+            { X86::MOV8rr, X86::MOV8rr_REV }, { X86::MOV16rr, X86::MOV16rr_REV }, { X86::MOV32rr, X86::MOV32rr_REV }, { X86::MOV64rr, X86::MOV64rr_REV },
+            { X86::ADD8rr, X86::ADD8rr_REV }, { X86::ADD16rr, X86::ADD16rr_REV }, { X86::ADD32rr, X86::ADD32rr_REV }, { X86::ADD64rr, X86::ADD64rr_REV },
+            { X86::ADC8rr, X86::ADC8rr_REV }, { X86::ADC16rr, X86::ADC16rr_REV }, { X86::ADC32rr, X86::ADC32rr_REV }, { X86::ADC64rr, X86::ADC64rr_REV },
+            { X86::SUB8rr, X86::SUB8rr_REV }, { X86::SUB16rr, X86::SUB16rr_REV }, { X86::SUB32rr, X86::SUB32rr_REV }, { X86::SUB64rr, X86::SUB64rr_REV },
+            { X86::SBB8rr, X86::SBB8rr_REV }, { X86::SBB16rr, X86::SBB16rr_REV }, { X86::SBB32rr, X86::SBB32rr_REV }, { X86::SBB64rr, X86::SBB64rr_REV },
+            { X86::AND8rr, X86::AND8rr_REV }, { X86::AND16rr, X86::AND16rr_REV }, { X86::AND32rr, X86::AND32rr_REV }, { X86::AND64rr, X86::AND64rr_REV },
+            { X86::OR8rr, X86::OR8rr_REV }, { X86::OR16rr, X86::OR16rr_REV }, { X86::OR32rr, X86::OR32rr_REV }, { X86::OR64rr, X86::OR64rr_REV },
+            { X86::XOR8rr, X86::XOR8rr_REV }, { X86::XOR16rr, X86::XOR16rr_REV }, { X86::XOR32rr, X86::XOR32rr_REV }, { X86::XOR64rr, X86::XOR64rr_REV },
+            { X86::CMP8rr, X86::CMP8rr_REV }, { X86::CMP16rr, X86::CMP16rr_REV }, { X86::CMP32rr, X86::CMP32rr_REV }, { X86::CMP64rr, X86::CMP64rr_REV },
+        };
+
+        for (const auto& pair : pairs) {
+            result[pair[0]] = pair[1];
+            result[pair[1]] = pair[0];
+        }
+
+        return result;
+    }
+
+    /**
+     * Retrieve both encodings of a `mov` that can replace a `COPY` between general purpose registers.
+     *
+     * Only copies of 16, 32 or 64 bits without sub registers or implicit operands are lowered (8-bit copies
+     * are skipped, as `ah`-like registers cannot be encoded together with REX-only registers). Identity
+     * copies are left for the expansion of pseudo instructions, which removes them.
+     *
+     * @param const MachineInstr& instruction The `COPY` instruction.
+     * @return std::optional<std::pair<unsigned, unsigned>> The regular & `_REV` opcode, if it can be lowered.
+     */
+    std::optional<std::pair<unsigned, unsigned>> getCopyEncodingsAMD64(const MachineInstr& instruction) {
+        if (!instruction.isCopy() || instruction.getNumOperands() != 2 || instruction.isBundled()) return std::nullopt;
+
+        const MachineOperand& destination = instruction.getOperand(0);
+        const MachineOperand& source = instruction.getOperand(1);
+
+        if (destination.getSubReg() || source.getSubReg()) return std::nullopt;
+        if (!destination.getReg().isPhysical() || !source.getReg().isPhysical()) return std::nullopt;
+        if (destination.getReg() == source.getReg()) return std::nullopt;
+
+        const std::pair<const TargetRegisterClass*, std::pair<unsigned, unsigned>> classes[] = {
+            { &X86::GR64RegClass, { X86::MOV64rr, X86::MOV64rr_REV } },
+            { &X86::GR32RegClass, { X86::MOV32rr, X86::MOV32rr_REV } },
+            { &X86::GR16RegClass, { X86::MOV16rr, X86::MOV16rr_REV } },
+        };
+
+        for (const auto& [registerClass, encodings] : classes) {
+            if (registerClass->contains(destination.getReg()) && registerClass->contains(source.getReg())) return encodings;
+        }
+
+        return std::nullopt;
+    }
+
+public:
+
+    /**
+     * Main execution method for the RandomizeEncodingsModule class.
+     *
+     * @param MachineFunction& MF The machine function to randomize the encodings of.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+
+        // Ensure the architecture is supported
+        auto architecture = MF.getTarget().getTargetTriple().getArch();
+
+        switch (architecture) {
+            // AMD64
+            case Triple::x86_64:
+                break;
+            // ARM64 (fixed-width instructions have a single encoding)
+            case Triple::aarch64:
+                return modified;
+            // Unknown architecture
+            default:
+                report_fatal_error(formatv("RandomizeEncodingsModule failed due to unknown architecture: {0}.", architecture));
+                break;
+        }
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: RandomizeEncodings().\n";
+
+        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+        const DenseMap<unsigned, unsigned>& alternates = getAlternatesAMD64();
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto &Instruction : make_early_inc_range(MachineBasicBlock)) {
+                if (auto encodings = getCopyEncodingsAMD64(Instruction)) {
+                    unsigned opcode = RandomHelper::getChanceOneIn(2) ? encodings->second : encodings->first;
+                    const MachineOperand& source = Instruction.getOperand(1);
+
+                    BuildMI(MachineBasicBlock, Instruction, Instruction.getDebugLoc(), TII->get(opcode), Instruction.getOperand(0).getReg())
+                        .addReg(source.getReg(), getKillRegState(source.isKill()) | getUndefRegState(source.isUndef()));
+
+                    Instruction.eraseFromParent();
+                    lowered++;
+                    modified = true;
+                    continue;
+                }
+
+                auto alternate = alternates.find(Instruction.getOpcode());
+                if (alternate == alternates.end() || Instruction.isBundled()) continue;
+
+                // Both encodings are equally likely, independent of the original one
+                if (!RandomHelper::getChanceOneIn(2)) continue;
+
+                Instruction.setDesc(TII->get(alternate->second));
+                swapped++;
+                modified = true;
+            }
+        }
+
+        dbgs() << "          ✓ Swapped the encoding of " << swapped << " instruction(s), and lowered " << lowered << " copies to a random encoding.\n";
+
+        return modified;
+    }
+
+};
@@ -0,0 +1,251 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/Support/Alignment.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to randomize the layout of the stack frame (the offsets of locals & spill slots).
+ *
+ * Without optimization, prolog/epilog insertion assigns offsets to stack objects in order of their frame index.
+ * This module therefore recreates the stack objects in a random order (and remaps all references to them),
+ * which changes every `[rbp-N]` / `[sp+N]` offset without adding any instruction. Optionally, objects are
+ * packed by decreasing alignment (shuffled within each alignment), which minimizes the padding in the frame.
+ */
+class RandomizeFrameLayoutModule {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* MM_RANDOMIZE_FRAME_LAYOUT = std::getenv("MM_RANDOMIZE_FRAME_LAYOUT");
+        bool result = (MM_RANDOMIZE_FRAME_LAYOUT && std::string(MM_RANDOMIZE_FRAME_LAYOUT) == "true");
+
+        return result || moduleIsBeingTested();
+    }
+
+    /**
+     * Whether the module is being feature tested or not (default).
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsBeingTested() {
+        const char* MM_TEST_RANDOMIZE_FRAME_LAYOUT = std::getenv("MM_TEST_RANDOMIZE_FRAME_LAYOUT");
+        bool result = (MM_TEST_RANDOMIZE_FRAME_LAYOUT && std::string(MM_TEST_RANDOMIZE_FRAME_LAYOUT) == "true");
+
+        return result;
+    }
+
+    /**
+     * Whether stack objects should be packed by alignment (to minimize the frame size) or not (default).
+     *
+     * @returns bool Positive if enabled.
+     */
+    static bool packingIsEnabled() {
+        const char* MM_PACK_FRAME_OBJECTS = std::getenv("MM_PACK_FRAME_OBJECTS");
+        return MM_PACK_FRAME_OBJECTS && std::string(MM_PACK_FRAME_OBJECTS) == "true";
+    }
+
+    /**
+     * Check if a stack object can be moved to another place in the frame.
+     *
+     * @param const MachineFrameInfo& MFI The frame information of the machine function.
+     * @param int frameIndex The stack object to check.
+     * @return bool Positive if the object is a regular (non-fixed, fixed-size) object that has not been allocated yet.
+     */
+    bool isMovable(const MachineFrameInfo& MFI, int frameIndex) {
+        if (MFI.isFixedObjectIndex(frameIndex) || MFI.isDeadObjectIndex(frameIndex) || MFI.isVariableSizedObjectIndex(frameIndex)) return false;
+        if (MFI.isObjectPreAllocated(frameIndex) || MFI.getStackID(frameIndex) != 0 || MFI.getObjectSize(frameIndex) == 0) return false;
+        if (MFI.hasStackProtectorIndex() && MFI.getStackProtectorIndex() == frameIndex) return false;
+
+        return true;
+    }
+
+    /**
+     * Estimate the size of the frame (excluding fixed objects), when objects are allocated in the given order.
+     *
+     * @param const MachineFrameInfo& MFI The frame information of the machine function.
+     * @param const std::vector<int>& order The frame indexes in order of allocation.
+     * @return uint64_t The estimated size (in bytes).
+     */
+    uint64_t getFrameSize(const MachineFrameInfo& MFI, const std::vector<int>& order) {
+        uint64_t result = 0;
+
+        for (int frameIndex : order) {
+            result = alignTo(result + MFI.getObjectSize(frameIndex), MFI.getObjectAlign(frameIndex));
+        }
+
+        return result;
+    }
+
+    /**
+     * Replace all references (operands, memory operands & debug information) to the old stack objects.
+     *
+     * @param MachineFunction& MF The machine function to remap the references of.
+     * @param const DenseMap<int, int>& remapping The new frame index of every old frame index.
+     */
+    void remapReferences(MachineFunction& MF, const DenseMap<int, int>& remapping) {
+        for (auto &MachineBasicBlock : MF) {
+            for (auto &Instruction : MachineBasicBlock) {
+                for (MachineOperand& operand : Instruction.operands()) {
+                    if (operand.isFI() && remapping.count(operand.getIndex())) operand.setIndex(remapping.lookup(operand.getIndex()));
+                }
+
+                SmallVector<MachineMemOperand*, 2> memoryOperands;
+                bool changed = false;
+
+                for (MachineMemOperand* memoryOperand : Instruction.memoperands()) {
+                    auto* stack = dyn_cast_or_null<FixedStackPseudoSourceValue>(memoryOperand->getPseudoValue());
+
+                    if (stack && remapping.count(stack->getFrameIndex())) {
+                        MachinePointerInfo pointer = MachinePointerInfo::getFixedStack(MF, remapping.lookup(stack->getFrameIndex()), memoryOperand->getOffset());
+                        memoryOperand = MF.getMachineMemOperand(memoryOperand, pointer, memoryOperand->getSize());
+                        changed = true;
+                    }
+
+                    memoryOperands.push_back(memoryOperand);
+                }
+
+                if (changed) Instruction.setMemRefs(MF, memoryOperands);
+            }
+        }
+
+        for (auto &variable : MF.getVariableDbgInfo()) {
+            if (variable.inStackSlot() && remapping.count(variable.getStackSlot())) variable.updateStackSlot(remapping.lookup(variable.getStackSlot()));
+        }
+    }
+
+public:
+
+    /**
+     * Main execution method for the RandomizeFrameLayoutModule class.
+     *
+     * @param MachineFunction& MF The machine function to randomize the frame layout of.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+
+        // Ensure the architecture is supported
+        auto architecture = MF.getTarget().getTargetTriple().getArch();
+
+        switch (architecture) {
+            // AMD64 & ARM64 (objects are allocated by the target independent prolog/epilog insertion)
+            case Triple::x86_64:
+            case Triple::aarch64:
+                break;
+            // Unknown architecture
+            default:
+                report_fatal_error(formatv("RandomizeFrameLayoutModule failed due to unknown architecture: {0}.", architecture));
+                break;
+        }
+
+        MachineFrameInfo& MFI = MF.getFrameInfo();
+        bool pack = packingIsEnabled();
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: RandomizeFrameLayout(pack=" << pack << ").\n";
+
+        // Objects of the SjLj exception handling context are referenced by index elsewhere
+        if (MFI.getFunctionContextIndex() != -1) return modified;
+
+        std::vector<int> original;
+        for (int frameIndex = 0; frameIndex < MFI.getObjectIndexEnd(); frameIndex++) {
+            if (isMovable(MFI, frameIndex)) original.push_back(frameIndex);
+        }
+
+        if (original.size() < 2) return modified;
+
+        // Small frames often end up in their original layout, so that is retried a few times
+        std::vector<int> order = original;
+
+        for (unsigned attempt = 0; attempt < 8 && (attempt == 0 || order == original); attempt++) {
+            std::shuffle(order.begin(), order.end(), RandomHelper::getRandomGenerator());
+
+            if (pack) {
+                std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return MFI.getObjectAlign(a) > MFI.getObjectAlign(b); });
+            }
+        }
+
+        if (order == original) {
+            dbgs() << "          ↳ Random frame layout is equal to the original frame layout.\n";
+            return modified;
+        }
+
+        uint64_t originalSize = getFrameSize(MFI, original);
+
+        // Recreate the objects in the new order (so that they get increasing frame indexes in that order)
+        DenseMap<int, int> remapping;
+        std::vector<int> recreated;
+
+        for (int frameIndex : order) {
+            int newFrameIndex = MFI.CreateStackObject(MFI.getObjectSize(frameIndex), MFI.getObjectAlign(frameIndex), MFI.isSpillSlotObjectIndex(frameIndex), MFI.getObjectAllocation(frameIndex));
+            MFI.setObjectSSPLayout(newFrameIndex, MFI.getObjectSSPLayout(frameIndex));
+            remapping[frameIndex] = newFrameIndex;
+            recreated.push_back(newFrameIndex);
+        }
+
+        remapReferences(MF, remapping);
+
+        for (int frameIndex : order) {
+            MFI.RemoveStackObject(frameIndex);
+        }
+
+        dbgs() << "          ✓ Shuffled " << order.size() << " stack object(s), estimated frame size " << originalSize << " → " << getFrameSize(MFI, recreated) << " byte(s).\n";
+
+        modified = true;
+        return modified;
+    }
+
+};
@@ -0,0 +1,377 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSchedule.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to randomize the order of independent instructions in each basic block.
+ *
+ * After register allocation, a dependency DAG is built per scheduling region (a sequence of instructions
+ * between scheduling boundaries such as calls and terminators), with register (true, anti & output),
+ * memory and side effect edges. A random topological order of that DAG is then emitted. This adds zero
+ * bytes, while the instruction sequences differ heavily between compilations.
+ */
+class RandomizeInstructionScheduleModule {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+    /**
+     * Statistics of the scheduled regions.
+     */
+    unsigned regions = 0;
+    unsigned reordered = 0;
+    unsigned keptForCriticalPath = 0;
+
+    /**
+     * Maximum amount of random orders to try per region, before keeping the original order.
+     */
+    static const unsigned MaxAttempts = 16;
+
+    /**
+     * Placeholder for instructions that don't access (exactly one) stack object.
+     */
+    static const int NoFrameIndex = std::numeric_limits<int>::min();
+
+    /**
+     * Machine model of the target (used to estimate instruction latencies).
+     */
+    TargetSchedModel schedModel;
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* MM_RANDOMIZE_INSTRUCTION_SCHEDULE = std::getenv("MM_RANDOMIZE_INSTRUCTION_SCHEDULE");
+        bool result = (MM_RANDOMIZE_INSTRUCTION_SCHEDULE && std::string(MM_RANDOMIZE_INSTRUCTION_SCHEDULE) == "true");
+
+        return result || moduleIsBeingTested();
+    }
+
+    /**
+     * Whether the module is being feature tested or not (default).
+     *
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsBeingTested() {
+        const char* MM_TEST_RANDOMIZE_INSTRUCTION_SCHEDULE = std::getenv("MM_TEST_RANDOMIZE_INSTRUCTION_SCHEDULE");
+        bool result = (MM_TEST_RANDOMIZE_INSTRUCTION_SCHEDULE && std::string(MM_TEST_RANDOMIZE_INSTRUCTION_SCHEDULE) == "true");
+
+        return result;
+    }
+
+    /**
+     * Whether only orders with an estimated critical path no longer than the original are emitted (default) or not.
+     *
+     * @returns bool Positive if enabled.
+     */
+    static bool criticalPathPreservationIsEnabled() {
+        const char* MM_PRESERVE_CRITICAL_PATH = std::getenv("MM_PRESERVE_CRITICAL_PATH");
+        return !MM_PRESERVE_CRITICAL_PATH || std::string(MM_PRESERVE_CRITICAL_PATH) != "false";
+    }
+
+    /**
+     * Check if an instruction may not be moved, and no instruction may be moved across it.
+     *
+     * @param const MachineInstr& Instruction The instruction to check.
+     * @param const MachineBasicBlock& MBB The block of the instruction.
+     * @param const MachineFunction& MF The machine function of the instruction.
+     * @return bool Positive if the instruction is a scheduling boundary.
+     */
+    bool isBoundary(const MachineInstr& Instruction, const MachineBasicBlock& MBB, const MachineFunction& MF) {
+        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+
+        if (Instruction.isTerminator() || Instruction.isCall() || Instruction.isPosition() || Instruction.isDebugInstr()) return true;
+        if (Instruction.isInlineAsm() || Instruction.isBundled() || Instruction.hasUnmodeledSideEffects() || TII->isFrameInstr(Instruction)) return true;
+        if (any_of(Instruction.operands(), [](const MachineOperand& operand) { return operand.isRegMask(); })) return true;
+
+        return TII->isSchedulingBoundary(Instruction, &MBB, MF);
+    }
+
+    /**
+     * Retrieve the stack object that a memory instruction accesses.
+     *
+     * @param const MachineInstr& Instruction The instruction to check.
+     * @return int The frame index (negative for fixed objects), or `NoFrameIndex` if the instruction doesn't access exactly one stack object.
+     */
+    int getFrameIndex(const MachineInstr& Instruction) {
+        int result = NoFrameIndex;
+
+        for (const MachineOperand& operand : Instruction.operands()) {
+            if (!operand.isFI()) continue;
+            if (result != NoFrameIndex) return NoFrameIndex;
+            result = operand.getIndex();
+        }
+
+        return result;
+    }
+
+    /**
+     * Check if the order of two instructions must be preserved (i.e. if `second` depends on `first`).
+     *
+     * @param const MachineInstr& first The instruction that comes first in the original order.
+     * @param const MachineInstr& second The instruction that comes second in the original order.
+     * @param const TargetRegisterInfo* TRI The register information of the target.
+     * @return bool Positive if there is a register, memory or side effect dependency.
+     */
+    bool dependsOn(const MachineInstr& first, const MachineInstr& second, const TargetRegisterInfo* TRI) {
+        // Register dependencies (true, anti & output), including flags and implicit operands
+        for (const MachineOperand& a : first.operands()) {
+            if (!a.isReg() || !a.getReg()) continue;
+
+            for (const MachineOperand& b : second.operands()) {
+                if (!b.isReg() || !b.getReg() || (!a.isDef() && !b.isDef())) continue;
+                if (!TRI->regsOverlap(a.getReg(), b.getReg())) continue;
+
+                // Two definitions that are never read can be swapped
+                if (a.isDef() && b.isDef() && a.isDead() && b.isDead()) continue;
+
+                return true;
+            }
+        }
+
+        // Memory dependencies (loads may be swapped with each other)
+        if (first.mayLoadOrStore() && second.mayLoadOrStore()) {
+            if (first.hasOrderedMemoryRef() || second.hasOrderedMemoryRef()) return true;
+            if (!first.mayStore() && !second.mayStore()) return false;
+
+            // Distinct (non-fixed) stack objects never overlap
+            int firstFrameIndex = getFrameIndex(first);
+            int secondFrameIndex = getFrameIndex(second);
+            if (firstFrameIndex >= 0 && secondFrameIndex >= 0 && firstFrameIndex != secondFrameIndex) return false;
+
+            return first.mayAlias(nullptr, second, false);
+        }
+
+        return false;
+    }
+
+    /**
+     * Estimate how many cycles a region takes, when its instructions are issued in the given order (one per cycle).
+     *
+     * @param const std::vector<MachineInstr*>& region The instructions of the region.
+     * @param const std::vector<std::vector<size_t>>& predecessors The dependencies of each instruction.
+     * @param const std::vector<size_t>& order The order to estimate (indexes into `region`).
+     * @return unsigned The estimated amount of cycles.
+     */
+    unsigned getScheduleLength(const std::vector<MachineInstr*>& region, const std::vector<std::vector<size_t>>& predecessors, const std::vector<size_t>& order) {
+        std::vector<unsigned> finished(region.size(), 0);
+        unsigned cycle = 0;
+        unsigned result = 0;
+
+        for (size_t index : order) {
+            unsigned issue = cycle;
+
+            for (size_t predecessor : predecessors[index]) {
+                issue = std::max(issue, finished[predecessor]);
+            }
+
+            finished[index] = issue + std::max(1u, schedModel.computeInstrLatency(region[index]));
+            result = std::max(result, finished[index]);
+            cycle = issue + 1;
+        }
+
+        return result;
+    }
+
+    /**
+     * Pick a random topological order of the dependency DAG of a region.
+     *
+     * @param const std::vector<std::vector<size_t>>& predecessors The dependencies of each instruction.
+     * @return std::vector<size_t> The order (indexes into the region).
+     */
+    std::vector<size_t> getRandomOrder(const std::vector<std::vector<size_t>>& predecessors) {
+        std::vector<unsigned> remaining(predecessors.size(), 0);
+        std::vector<std::vector<size_t>> successors(predecessors.size());
+        std::vector<size_t> ready;
+        std::vector<size_t> result;
+
+        for (size_t index = 0; index < predecessors.size(); index++) {
+            remaining[index] = predecessors[index].size();
+            for (size_t predecessor : predecessors[index]) successors[predecessor].push_back(index);
+            if (remaining[index] == 0) ready.push_back(index);
+        }
+
+        while (!ready.empty()) {
+            std::uniform_int_distribution<size_t> dist(0, ready.size() - 1);
+            size_t picked = dist(RandomHelper::getRandomGenerator());
+            size_t index = ready[picked];
+
+            ready.erase(ready.begin() + picked);
+            result.push_back(index);
+
+            for (size_t successor : successors[index]) {
+                if (--remaining[successor] == 0) ready.push_back(successor);
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Randomize the order of the instructions in a region.
+     *
+     * @param MachineBasicBlock& MBB The block of the region.
+     * @param std::vector<MachineInstr*>& region The instructions of the region (in original order).
+     * @param const TargetRegisterInfo* TRI The register information of the target.
+     * @param bool preserveCriticalPath Whether orders with a longer estimated critical path are rejected.
+     */
+    void scheduleRegion(MachineBasicBlock& MBB, std::vector<MachineInstr*>& region, const TargetRegisterInfo* TRI, bool preserveCriticalPath) {
+        if (region.size() < 2) return;
+        regions++;
+
+        // Build the dependency DAG
+        std::vector<std::vector<size_t>> predecessors(region.size());
+        for (size_t second = 1; second < region.size(); second++) {
+            for (size_t first = 0; first < second; first++) {
+                if (dependsOn(*region[first], *region[second], TRI)) predecessors[second].push_back(first);
+            }
+        }
+
+        std::vector<size_t> original(region.size());
+        for (size_t index = 0; index < region.size(); index++) original[index] = index;
+
+        unsigned originalLength = preserveCriticalPath ? getScheduleLength(region, predecessors, original) : 0;
+        std::vector<size_t> order;
+
+        for (unsigned attempt = 0; attempt < MaxAttempts; attempt++) {
+            order = getRandomOrder(predecessors);
+            if (!preserveCriticalPath || getScheduleLength(region, predecessors, order) <= originalLength) break;
+            order.clear();
+        }
+
+        if (order.empty()) {
+            keptForCriticalPath++;
+            return;
+        }
+
+        if (order == original) return;
+
+        // Emit the instructions in the new order, right before the end of the region
+        MachineBasicBlock::iterator end = std::next(region.back()->getIterator());
+
+        for (size_t index : order) {
+            MBB.splice(end, &MBB, region[index]->getIterator());
+        }
+
+        // Uses of the same register may have been swapped, so kill flags are no longer reliable
+        for (MachineInstr* Instruction : region) {
+            for (MachineOperand& operand : Instruction->operands()) {
+                if (operand.isReg() && operand.isUse()) operand.setIsKill(false);
+            }
+        }
+
+        reordered++;
+        modified = true;
+    }
+
+public:
+
+    /**
+     * Main execution method for the RandomizeInstructionScheduleModule class.
+     *
+     * @param MachineFunction& MF The machine function to reorder the instructions of.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+
+        // Ensure the architecture is supported
+        auto architecture = MF.getTarget().getTargetTriple().getArch();
+
+        switch (architecture) {
+            // AMD64 & ARM64 (the dependency DAG only relies on target hooks)
+            case Triple::x86_64:
+            case Triple::aarch64:
+                break;
+            // Unknown architecture
+            default:
+                report_fatal_error(formatv("RandomizeInstructionScheduleModule failed due to unknown architecture: {0}.", architecture));
+                break;
+        }
+
+        // Dependencies are tracked on physical registers, so this must run after register allocation
+        if (!MF.getProperties().hasProperty(MachineFunctionProperties::Property::NoVRegs)) return false;
+
+        bool preserveCriticalPath = criticalPathPreservationIsEnabled();
+        const TargetRegisterInfo *TRI = MF.getSubtarget().getRegisterInfo();
+        schedModel.init(&MF.getSubtarget());
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: RandomizeInstructionSchedule(preserveCriticalPath=" << preserveCriticalPath << ").\n";
+
+        for (auto &MachineBasicBlock : MF) {
+            std::vector<MachineInstr*> region;
+
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                if (!isBoundary(Instruction, MachineBasicBlock, MF)) {
+                    region.push_back(&Instruction);
+                    continue;
+                }
+
+                scheduleRegion(MachineBasicBlock, region, TRI, preserveCriticalPath);
+                region.clear();
+            }
+
+            scheduleRegion(MachineBasicBlock, region, TRI, preserveCriticalPath);
+        }
+
+        dbgs() << "          ✓ Reordered " << reordered << " of " << regions << " region(s), kept " << keptForCriticalPath << " to preserve the critical path.\n";
+
+        return modified;
+    }
+
+};
@@ -0,0 +1,170 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachinePassManager.h"
+#include "llvm/CodeGen/MachinePassRegistry.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/X86/X86.h"
+#include "llvm/Target/X86/X86InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+#include "../../helpers/TransformOptionRegistry.cpp"
+
+/**
+ * Arithmetic identity substitution options
+ */
+#include "options_amd64/TransformArithmeticIdentitiesOptionAMD64_ADDSUB.cpp"
+#include "options_amd64/TransformArithmeticIdentitiesOptionAMD64_LEAADD.cpp"
+#include "options_amd64/TransformArithmeticIdentitiesOptionAMD64_TESTCMP.cpp"
+#include "options_arm64/TransformArithmeticIdentitiesOptionARM64_FLAGS.cpp"
+#include "options_arm64/TransformArithmeticIdentitiesOptionARM64_ZERO.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to substitute arithmetic instructions by an equivalent instruction of the same cost.
+ *
+ * E.g. `add reg, imm` becomes `sub reg, -imm`, `lea reg, [reg+imm]` becomes `add reg, imm` and `test reg, reg`
+ * becomes `cmp reg, 0` (and vice versa). Substitutions that change the flags are only applied if the flags
+ * are dead, so this module runs after register allocation (where the liveness of the flags is known).
+ */
+class TransformArithmeticIdentitiesModule {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+    /**
+     * Whether the module is enabled (default) or disabled.
+     * 
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsEnabled() {
+        const char* MM_TRANSFORM_ARITHMETIC_IDENTITIES = std::getenv("MM_TRANSFORM_ARITHMETIC_IDENTITIES");
+        bool result = (MM_TRANSFORM_ARITHMETIC_IDENTITIES && std::string(MM_TRANSFORM_ARITHMETIC_IDENTITIES) == "true");
+
+        return result || moduleIsBeingTested();
+    }
+
+    /**
+     * Whether the module is being feature tested or not (default).
+     * 
+     * @returns bool Positive if enabled.
+     */
+    bool moduleIsBeingTested() {
+        const char* MM_TEST_TRANSFORM_ARITHMETIC_IDENTITIES = std::getenv("MM_TEST_TRANSFORM_ARITHMETIC_IDENTITIES");
+        bool result = (MM_TEST_TRANSFORM_ARITHMETIC_IDENTITIES && std::string(MM_TEST_TRANSFORM_ARITHMETIC_IDENTITIES) == "true");
+
+        return result;
+    }
+
+public:
+
+    /**
+     * Main execution method for the TransformArithmeticIdentitiesModule class.
+     *
+     * @param MachineFunction& MF The machine function to run the substitution on.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
+        // Ensure module is enabled
+        if (!moduleIsEnabled()) return false;
+        bool modifyAll = moduleIsBeingTested();
+
+        // Ensure the architecture is supported
+        auto architecture = MF.getTarget().getTargetTriple().getArch();
+
+        switch (architecture) {
+            // AMD64 & ARM64
+            case Triple::x86_64:
+            case Triple::aarch64:
+                break;
+            // Unknown architecture
+            default:
+                report_fatal_error(formatv("TransformArithmeticIdentitiesModule failed due to unknown architecture: {0}.", architecture));
+                break;
+        }
+
+        // The liveness of the flags is only known for physical registers, so this must run after register allocation
+        if (!MF.getProperties().hasProperty(MachineFunctionProperties::Property::NoVRegs)) return false;
+
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: TransformArithmeticIdentities(modifyAll=" << modifyAll << ").\n";
+
+        // Pick a random compatible option for each instruction, weighted by the cost model of the target
+        TransformOptionSampler sampler("TransformArithmeticIdentities", MF);
+        if (!sampler.hasOptions()) return modified;
+
+        std::vector<TransformContext::Candidate> candidates;
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                const TransformOption* option = sampler.pick(Instruction);
+                if (!option) continue;
+
+                // Only modify a random subset of the instructions, so that both forms remain equally likely
+                if (!modifyAll && !RandomHelper::getChanceOneIn(2)) continue;
+
+                // Lower the density of modifications in hot code (unless the module is being tested)
+                if (!moduleIsBeingTested() && !context.shouldModify(MachineBasicBlock)) continue;
+
+                candidates.push_back({ &Instruction, option, sampler.getCandidateCount() });
+            }
+        }
+
+        // Apply the options (ranked & picked under the growth budget, if any)
+        if (context.applyOptions(candidates)) {
+            modified = true;
+        }
+
+        return modified;
+    }
+
+};
@@ -0,0 +1,177 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachinePassManager.h"
+#include "llvm/CodeGen/MachinePassRegistry.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/X86/X86.h"
+#include "llvm/Target/X86/X86InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to substitute `add reg, imm` by `sub reg, -imm` (and vice versa).
+ *
+ * The carry & overflow flags of both forms differ, so the flags must be dead. The immediate must be
+ * negatable in the same (8-bit or full) encoding, so that the size of the instruction doesn't change.
+ */
+class TransformArithmeticIdentitiesOptionAMD64_ADDSUB {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+public:
+
+    /**
+     * Check if the given instruction can be substituted by the TransformArithmeticIdentitiesOptionAMD64_ADDSUB class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        const TargetRegisterInfo *TRI = instruction.getMF()->getSubtarget().getRegisterInfo();
+
+        if (!getReplacement(instruction.getOpcode())) return false;
+        if (instruction.getNumExplicitOperands() != 3 || !instruction.getOperand(2).isImm()) return false;
+        if (!instruction.registerDefIsDead(X86::EFLAGS, TRI)) return false;
+
+        unsigned size = getImmediateSize(instruction.getOpcode());
+        int64_t value = SignExtend64(instruction.getOperand(2).getImm(), size);
+
+        return value != 0 && isIntN(size, -value) && isInt<8>(value) == isInt<8>(-value);
+    }
+
+    /**
+     * Main execution method for the TransformArithmeticIdentitiesOptionAMD64_ADDSUB class.
+     *
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
+        // Local variables
+        auto &MachineBasicBlock = *Instruction.getParent();
+        const TargetInstrInfo *TII = MachineBasicBlock.getParent()->getSubtarget().getInstrInfo();
+        const TargetRegisterInfo *TRI = MachineBasicBlock.getParent()->getSubtarget().getRegisterInfo();
+
+        // Inform user that we encountered an `add` or `sub` instruction with immediate value
+        dbgs() << "          ↳ Found AMD64 add/sub instruction with immediate: ";
+        Instruction.print(dbgs());
+
+        // Build the new instruction: sub reg, -imm (or add reg, -imm)
+        DebugLoc DL = Instruction.getDebugLoc();
+        int64_t value = SignExtend64(Instruction.getOperand(2).getImm(), getImmediateSize(Instruction.getOpcode()));
+
+        BuildMI(MachineBasicBlock, Instruction, DL, TII->get(getReplacement(Instruction.getOpcode())))
+            .add(Instruction.getOperand(0))
+            .add(Instruction.getOperand(1))
+            .addImm(-value)
+            ->addRegisterDead(X86::EFLAGS, TRI);
+
+        Instruction.eraseFromParent();
+        modified = true;
+
+        dbgs() << "          ✓ Modified instruction using random option `ADDSUB`.\n";
+        return modified;
+    }
+
+private:
+
+    /**
+     * Determines the opposite (`add` or `sub`) opcode of the given opcode.
+     *
+     * @param unsigned opcode The opcode of the instruction.
+     * @return unsigned The opposite opcode, or zero if there is none.
+     */
+    unsigned getReplacement(unsigned opcode) {
+        switch (opcode) {
+            case X86::ADD8ri: return X86::SUB8ri;
+            case X86::ADD16ri: return X86::SUB16ri;
+            case X86::ADD32ri: return X86::SUB32ri;
+            case X86::ADD64ri32: return X86::SUB64ri32;
+            case X86::SUB8ri: return X86::ADD8ri;
+            case X86::SUB16ri: return X86::ADD16ri;
+            case X86::SUB32ri: return X86::ADD32ri;
+            case X86::SUB64ri32: return X86::ADD64ri32;
+            default: return 0;
+        }
+    }
+
+    /**
+     * Determines the size of the (sign extended) immediate value of the given opcode.
+     *
+     * @param unsigned opcode The opcode of the instruction.
+     * @return unsigned The size of the immediate value in bits (8, 16 or 32).
+     */
+    unsigned getImmediateSize(unsigned opcode) {
+        switch (opcode) {
+            case X86::ADD8ri:
+            case X86::SUB8ri:
+                return 8;
+            case X86::ADD16ri:
+            case X86::SUB16ri:
+                return 16;
+            default:
+                return 32;
+        }
+    }
+
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformArithmeticIdentities` option `ADDSUB`).
+ */
+static RegisterTransformOption<TransformArithmeticIdentitiesOptionAMD64_ADDSUB> TransformArithmeticIdentitiesOptionAMD64_ADDSUBRegistration(
+    "TransformArithmeticIdentities", "ADDSUB", Triple::x86_64,
+    { X86::ADD8ri, X86::ADD16ri, X86::ADD32ri, X86::ADD64ri32, X86::SUB8ri, X86::SUB16ri, X86::SUB32ri, X86::SUB64ri32 },
+    { InstructionClass::AluRegImmediate },
+    1
+);
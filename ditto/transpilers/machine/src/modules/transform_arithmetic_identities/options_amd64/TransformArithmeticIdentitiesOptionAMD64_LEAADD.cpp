@@ -0,0 +1,197 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachinePassManager.h"
+#include "llvm/CodeGen/MachinePassRegistry.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/X86/X86.h"
+#include "llvm/Target/X86/X86InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to substitute `lea reg, [reg+imm]` by `add reg, imm` (and vice versa).
+ *
+ * Unlike `lea`, `add` modifies the flags, so the flags must be dead. Registers that change the size
+ * of either encoding (the stack pointer & `r12` need a SIB byte, `eax` & `rax` have a short `add` form)
+ * are skipped, so that the size of the instruction doesn't change.
+ */
+class TransformArithmeticIdentitiesOptionAMD64_LEAADD {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+public:
+
+    /**
+     * Check if the given instruction can be substituted by the TransformArithmeticIdentitiesOptionAMD64_LEAADD class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        const TargetRegisterInfo *TRI = instruction.getMF()->getSubtarget().getRegisterInfo();
+
+        switch (instruction.getOpcode()) {
+            case X86::LEA64r:
+            case X86::LEA64_32r: {
+                if (instruction.getNumExplicitOperands() != 6 || !instruction.getOperand(1).isReg() || !instruction.getOperand(4).isImm()) return false;
+                if (instruction.getOperand(2).getImm() != 1 || instruction.getOperand(3).getReg() || instruction.getOperand(5).getReg()) return false;
+                if (instruction.getOperand(1).getReg() != getAddressRegister(instruction.getOperand(0).getReg(), TRI)) return false;
+
+                // `lea` doesn't define the flags, so their liveness is determined by scanning the block
+                const MachineBasicBlock &block = *instruction.getParent();
+                if (block.computeRegisterLiveness(TRI, X86::EFLAGS, std::next(instruction.getIterator())) != MachineBasicBlock::LQR_Dead) return false;
+
+                return isSizePreserving(instruction.getOperand(0).getReg(), instruction.getOperand(4).getImm(), TRI);
+            }
+            case X86::ADD32ri:
+            case X86::ADD64ri32: {
+                if (instruction.getNumExplicitOperands() != 3 || !instruction.getOperand(2).isImm()) return false;
+                if (!instruction.registerDefIsDead(X86::EFLAGS, TRI)) return false;
+
+                return isSizePreserving(instruction.getOperand(0).getReg(), instruction.getOperand(2).getImm(), TRI);
+            }
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Main execution method for the TransformArithmeticIdentitiesOptionAMD64_LEAADD class.
+     *
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
+        // Local variables
+        auto &MachineBasicBlock = *Instruction.getParent();
+        const TargetInstrInfo *TII = MachineBasicBlock.getParent()->getSubtarget().getInstrInfo();
+        const TargetRegisterInfo *TRI = MachineBasicBlock.getParent()->getSubtarget().getRegisterInfo();
+
+        // Inform user that we encountered a `lea` or `add` instruction with immediate value
+        dbgs() << "          ↳ Found AMD64 lea/add instruction with immediate: ";
+        Instruction.print(dbgs());
+
+        DebugLoc DL = Instruction.getDebugLoc();
+        Register destinationRegister = Instruction.getOperand(0).getReg();
+
+        switch (Instruction.getOpcode()) {
+            // Build the new instruction: add reg, imm
+            case X86::LEA64r:
+            case X86::LEA64_32r:
+                BuildMI(MachineBasicBlock, Instruction, DL, TII->get(Instruction.getOpcode() == X86::LEA64r ? X86::ADD64ri32 : X86::ADD32ri), destinationRegister)
+                    .addReg(destinationRegister)
+                    .addImm(Instruction.getOperand(4).getImm())
+                    ->addRegisterDead(X86::EFLAGS, TRI);
+                break;
+            // Build the new instruction: lea reg, [reg+imm]
+            default:
+                BuildMI(MachineBasicBlock, Instruction, DL, TII->get(Instruction.getOpcode() == X86::ADD64ri32 ? X86::LEA64r : X86::LEA64_32r), destinationRegister)
+                    .addReg(getAddressRegister(destinationRegister, TRI))
+                    .addImm(1)
+                    .addReg(0)
+                    .addImm(Instruction.getOperand(2).getImm())
+                    .addReg(0);
+                break;
+        }
+
+        Instruction.eraseFromParent();
+        modified = true;
+
+        dbgs() << "          ✓ Modified instruction using random option `LEAADD`.\n";
+        return modified;
+    }
+
+private:
+
+    /**
+     * Determines the 64-bit register that addresses the given destination register.
+     *
+     * @param Register destinationRegister The (32-bit or 64-bit) destination register.
+     * @param const TargetRegisterInfo* TRI The register information of the target.
+     * @return Register The 64-bit register (`lea` in 64-bit mode uses 64-bit addresses).
+     */
+    Register getAddressRegister(Register destinationRegister, const TargetRegisterInfo *TRI) {
+        if (X86::GR64RegClass.contains(destinationRegister)) return destinationRegister;
+        return TRI->getMatchingSuperReg(destinationRegister, X86::sub_32bit, &X86::GR64RegClass);
+    }
+
+    /**
+     * Check if both the `lea` and the `add` form of the given register and immediate have the same size.
+     *
+     * @param Register destinationRegister The destination register.
+     * @param int64_t value The immediate value (displacement).
+     * @param const TargetRegisterInfo* TRI The register information of the target.
+     * @return bool Positive if the substitution doesn't change the size of the instruction.
+     */
+    bool isSizePreserving(Register destinationRegister, int64_t value, const TargetRegisterInfo *TRI) {
+        Register addressRegister = getAddressRegister(destinationRegister, TRI);
+
+        if (!addressRegister || value == 0 || !isInt<32>(value)) return false;
+        if (addressRegister == X86::RSP || addressRegister == X86::R12) return false;
+        if (addressRegister == X86::RAX && !isInt<8>(value)) return false;
+
+        return true;
+    }
+
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformArithmeticIdentities` option `LEAADD`).
+ */
+static RegisterTransformOption<TransformArithmeticIdentitiesOptionAMD64_LEAADD> TransformArithmeticIdentitiesOptionAMD64_LEAADDRegistration(
+    "TransformArithmeticIdentities", "LEAADD", Triple::x86_64,
+    { X86::LEA64r, X86::LEA64_32r, X86::ADD32ri, X86::ADD64ri32 },
+    { InstructionClass::AluRegImmediate },
+    1
+);
@@ -0,0 +1,161 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachinePassManager.h"
+#include "llvm/CodeGen/MachinePassRegistry.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/X86/X86.h"
+#include "llvm/Target/X86/X86InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to substitute `test reg, reg` by `cmp reg, 0` (and vice versa).
+ *
+ * Both set the flags identically (only the auxiliary carry flag, which is undefined after `test`, may
+ * differ), so the flags may be live. The `cmp` form is one byte longer (8-bit immediate).
+ */
+class TransformArithmeticIdentitiesOptionAMD64_TESTCMP {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+public:
+
+    /**
+     * Check if the given instruction can be substituted by the TransformArithmeticIdentitiesOptionAMD64_TESTCMP class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        if (!getReplacement(instruction.getOpcode())) return false;
+        if (instruction.getNumExplicitOperands() != 2 || !instruction.getOperand(0).isReg()) return false;
+
+        // test reg, reg
+        if (instruction.getOperand(1).isReg()) return instruction.getOperand(0).getReg() == instruction.getOperand(1).getReg();
+
+        // cmp reg, 0
+        return instruction.getOperand(1).isImm() && instruction.getOperand(1).getImm() == 0;
+    }
+
+    /**
+     * Main execution method for the TransformArithmeticIdentitiesOptionAMD64_TESTCMP class.
+     *
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
+        // Local variables
+        auto &MachineBasicBlock = *Instruction.getParent();
+        const TargetInstrInfo *TII = MachineBasicBlock.getParent()->getSubtarget().getInstrInfo();
+        const TargetRegisterInfo *TRI = MachineBasicBlock.getParent()->getSubtarget().getRegisterInfo();
+
+        // Inform user that we encountered a `test` or `cmp` instruction
+        dbgs() << "          ↳ Found AMD64 test/cmp instruction: ";
+        Instruction.print(dbgs());
+
+        DebugLoc DL = Instruction.getDebugLoc();
+        Register reg = Instruction.getOperand(0).getReg();
+        bool kill = Instruction.killsRegister(reg, TRI);
+        MachineInstr* replacement;
+
+        if (Instruction.getOperand(1).isReg()) {
+            // Build the new instruction: cmp reg, 0
+            replacement = BuildMI(MachineBasicBlock, Instruction, DL, TII->get(getReplacement(Instruction.getOpcode()))).addReg(reg, getKillRegState(kill)).addImm(0);
+        } else {
+            // Build the new instruction: test reg, reg
+            replacement = BuildMI(MachineBasicBlock, Instruction, DL, TII->get(getReplacement(Instruction.getOpcode()))).addReg(reg).addReg(reg, getKillRegState(kill));
+        }
+
+        if (Instruction.registerDefIsDead(X86::EFLAGS, TRI)) replacement->addRegisterDead(X86::EFLAGS, TRI);
+
+        Instruction.eraseFromParent();
+        modified = true;
+
+        dbgs() << "          ✓ Modified instruction using random option `TESTCMP`.\n";
+        return modified;
+    }
+
+private:
+
+    /**
+     * Determines the opposite (`test` or `cmp`) opcode of the given opcode.
+     *
+     * @param unsigned opcode The opcode of the instruction.
+     * @return unsigned The opposite opcode, or zero if there is none.
+     */
+    unsigned getReplacement(unsigned opcode) {
+        switch (opcode) {
+            case X86::TEST8rr: return X86::CMP8ri;
+            case X86::TEST16rr: return X86::CMP16ri;
+            case X86::TEST32rr: return X86::CMP32ri;
+            case X86::TEST64rr: return X86::CMP64ri32;
+            case X86::CMP8ri: return X86::TEST8rr;
+            case X86::CMP16ri: return X86::TEST16rr;
+            case X86::CMP32ri: return X86::TEST32rr;
+            case X86::CMP64ri32: return X86::TEST64rr;
+            default: return 0;
+        }
+    }
+
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformArithmeticIdentities` option `TESTCMP`).
+ */
+static RegisterTransformOption<TransformArithmeticIdentitiesOptionAMD64_TESTCMP> TransformArithmeticIdentitiesOptionAMD64_TESTCMPRegistration(
+    "TransformArithmeticIdentities", "TESTCMP", Triple::x86_64,
+    { X86::TEST8rr, X86::TEST16rr, X86::TEST32rr, X86::TEST64rr, X86::CMP8ri, X86::CMP16ri, X86::CMP32ri, X86::CMP64ri32 },
+    { InstructionClass::AluRegImmediate },
+    1
+);
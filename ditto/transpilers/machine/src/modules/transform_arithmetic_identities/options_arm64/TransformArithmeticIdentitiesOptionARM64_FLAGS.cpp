@@ -0,0 +1,184 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachinePassManager.h"
+#include "llvm/CodeGen/MachinePassRegistry.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/AArch64/AArch64.h"
+#include "llvm/Target/AArch64/AArch64InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to substitute `adds`/`subs` by `add`/`sub` (and vice versa) if the flags are dead.
+ *
+ * Register 31 means the stack pointer in some and the zero register in other forms, so instructions
+ * that write either of them are skipped.
+ */
+class TransformArithmeticIdentitiesOptionARM64_FLAGS {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+public:
+
+    /**
+     * Check if the given instruction can be substituted by the TransformArithmeticIdentitiesOptionARM64_FLAGS class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        const TargetRegisterInfo *TRI = instruction.getMF()->getSubtarget().getRegisterInfo();
+
+        if (!getReplacement(instruction.getOpcode())) return false;
+        if (instruction.getNumExplicitOperands() < 3 || !instruction.getOperand(0).isReg() || !instruction.getOperand(1).isReg()) return false;
+
+        Register destinationRegister = instruction.getOperand(0).getReg();
+        if (destinationRegister == AArch64::SP || destinationRegister == AArch64::WSP) return false;
+        if (destinationRegister == AArch64::XZR || destinationRegister == AArch64::WZR) return false;
+
+        // adds/subs define the flags
+        if (instruction.definesRegister(AArch64::NZCV, TRI)) return instruction.registerDefIsDead(AArch64::NZCV, TRI);
+
+        // add/sub don't define the flags, so their liveness is determined by scanning the block
+        const MachineBasicBlock &block = *instruction.getParent();
+        return block.computeRegisterLiveness(TRI, AArch64::NZCV, std::next(instruction.getIterator())) == MachineBasicBlock::LQR_Dead;
+    }
+
+    /**
+     * Main execution method for the TransformArithmeticIdentitiesOptionARM64_FLAGS class.
+     *
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
+        // Local variables
+        auto &MachineBasicBlock = *Instruction.getParent();
+        const TargetInstrInfo *TII = MachineBasicBlock.getParent()->getSubtarget().getInstrInfo();
+        const TargetRegisterInfo *TRI = MachineBasicBlock.getParent()->getSubtarget().getRegisterInfo();
+
+        // Inform user that we encountered an `add(s)` or `sub(s)` instruction
+        dbgs() << "          ↳ Found ARM64 add(s)/sub(s) instruction: ";
+        Instruction.print(dbgs());
+
+        // Build the new instruction with the same (explicit) operands
+        DebugLoc DL = Instruction.getDebugLoc();
+        unsigned replacementOpcode = getReplacement(Instruction.getOpcode());
+        MachineInstrBuilder replacement = BuildMI(MachineBasicBlock, Instruction, DL, TII->get(replacementOpcode));
+
+        for (const MachineOperand &operand : Instruction.explicit_operands()) {
+            replacement.add(operand);
+        }
+
+        if (replacement->definesRegister(AArch64::NZCV, TRI)) replacement->addRegisterDead(AArch64::NZCV, TRI);
+
+        Instruction.eraseFromParent();
+        modified = true;
+
+        dbgs() << "          ✓ Modified instruction using random option `FLAGS`.\n";
+        return modified;
+    }
+
+private:
+
+    /**
+     * Determines the opposite (flag setting or not) opcode of the given opcode.
+     *
+     * @param unsigned opcode The opcode of the instruction.
+     * @return unsigned The opposite opcode, or zero if there is none.
+     */
+    unsigned getReplacement(unsigned opcode) {
+        switch (opcode) {
+            case AArch64::ADDWri: return AArch64::ADDSWri;
+            case AArch64::ADDXri: return AArch64::ADDSXri;
+            case AArch64::SUBWri: return AArch64::SUBSWri;
+            case AArch64::SUBXri: return AArch64::SUBSXri;
+            case AArch64::ADDWrr: return AArch64::ADDSWrr;
+            case AArch64::ADDXrr: return AArch64::ADDSXrr;
+            case AArch64::SUBWrr: return AArch64::SUBSWrr;
+            case AArch64::SUBXrr: return AArch64::SUBSXrr;
+            case AArch64::ADDWrs: return AArch64::ADDSWrs;
+            case AArch64::ADDXrs: return AArch64::ADDSXrs;
+            case AArch64::SUBWrs: return AArch64::SUBSWrs;
+            case AArch64::SUBXrs: return AArch64::SUBSXrs;
+            case AArch64::ADDSWri: return AArch64::ADDWri;
+            case AArch64::ADDSXri: return AArch64::ADDXri;
+            case AArch64::SUBSWri: return AArch64::SUBWri;
+            case AArch64::SUBSXri: return AArch64::SUBXri;
+            case AArch64::ADDSWrr: return AArch64::ADDWrr;
+            case AArch64::ADDSXrr: return AArch64::ADDXrr;
+            case AArch64::SUBSWrr: return AArch64::SUBWrr;
+            case AArch64::SUBSXrr: return AArch64::SUBXrr;
+            case AArch64::ADDSWrs: return AArch64::ADDWrs;
+            case AArch64::ADDSXrs: return AArch64::ADDXrs;
+            case AArch64::SUBSWrs: return AArch64::SUBWrs;
+            case AArch64::SUBSXrs: return AArch64::SUBXrs;
+            default: return 0;
+        }
+    }
+
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformArithmeticIdentities` option `FLAGS`).
+ */
+static RegisterTransformOption<TransformArithmeticIdentitiesOptionARM64_FLAGS> TransformArithmeticIdentitiesOptionARM64_FLAGSRegistration(
+    "TransformArithmeticIdentities", "FLAGS", Triple::aarch64,
+    {
+        AArch64::ADDWri, AArch64::ADDXri, AArch64::SUBWri, AArch64::SUBXri, AArch64::ADDWrr, AArch64::ADDXrr, AArch64::SUBWrr, AArch64::SUBXrr,
+        AArch64::ADDWrs, AArch64::ADDXrs, AArch64::SUBWrs, AArch64::SUBXrs, AArch64::ADDSWri, AArch64::ADDSXri, AArch64::SUBSWri, AArch64::SUBSXri,
+        AArch64::ADDSWrr, AArch64::ADDSXrr, AArch64::SUBSWrr, AArch64::SUBSXrr, AArch64::ADDSWrs, AArch64::ADDSXrs, AArch64::SUBSWrs, AArch64::SUBSXrs
+    },
+    { InstructionClass::AluRegImmediate },
+    1
+);
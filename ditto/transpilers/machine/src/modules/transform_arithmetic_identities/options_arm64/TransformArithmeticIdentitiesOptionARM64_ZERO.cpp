@@ -0,0 +1,145 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachinePassManager.h"
+#include "llvm/CodeGen/MachinePassRegistry.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/AArch64/AArch64.h"
+#include "llvm/Target/AArch64/AArch64InstrInfo.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to substitute `add reg, reg, #0` by `sub reg, reg, #0` (and vice versa).
+ *
+ * Both are register moves (e.g. `mov x29, sp`) that leave the flags untouched.
+ */
+class TransformArithmeticIdentitiesOptionARM64_ZERO {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+public:
+
+    /**
+     * Check if the given instruction can be substituted by the TransformArithmeticIdentitiesOptionARM64_ZERO class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        if (!getReplacement(instruction.getOpcode())) return false;
+        if (instruction.getNumExplicitOperands() != 4 || !instruction.getOperand(1).isReg()) return false;
+        if (!instruction.getOperand(2).isImm() || !instruction.getOperand(3).isImm()) return false;
+
+        return instruction.getOperand(2).getImm() == 0 && instruction.getOperand(3).getImm() == 0;
+    }
+
+    /**
+     * Main execution method for the TransformArithmeticIdentitiesOptionARM64_ZERO class.
+     *
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
+        // Local variables
+        auto &MachineBasicBlock = *Instruction.getParent();
+        const TargetInstrInfo *TII = MachineBasicBlock.getParent()->getSubtarget().getInstrInfo();
+
+        // Inform user that we encountered an `add` or `sub` instruction with a zero immediate
+        dbgs() << "          ↳ Found ARM64 add/sub instruction with zero immediate: ";
+        Instruction.print(dbgs());
+
+        // Build the new instruction: sub reg, reg, #0 (or add reg, reg, #0)
+        DebugLoc DL = Instruction.getDebugLoc();
+        BuildMI(MachineBasicBlock, Instruction, DL, TII->get(getReplacement(Instruction.getOpcode())))
+            .add(Instruction.getOperand(0))
+            .add(Instruction.getOperand(1))
+            .addImm(0)
+            .addImm(0);
+
+        Instruction.eraseFromParent();
+        modified = true;
+
+        dbgs() << "          ✓ Modified instruction using random option `ZERO`.\n";
+        return modified;
+    }
+
+private:
+
+    /**
+     * Determines the opposite (`add` or `sub`) opcode of the given opcode.
+     *
+     * @param unsigned opcode The opcode of the instruction.
+     * @return unsigned The opposite opcode, or zero if there is none.
+     */
+    unsigned getReplacement(unsigned opcode) {
+        switch (opcode) {
+            case AArch64::ADDWri: return AArch64::SUBWri;
+            case AArch64::ADDXri: return AArch64::SUBXri;
+            case AArch64::SUBWri: return AArch64::ADDWri;
+            case AArch64::SUBXri: return AArch64::ADDXri;
+            default: return 0;
+        }
+    }
+
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformArithmeticIdentities` option `ZERO`).
+ */
+static RegisterTransformOption<TransformArithmeticIdentitiesOptionARM64_ZERO> TransformArithmeticIdentitiesOptionARM64_ZERORegistration(
+    "TransformArithmeticIdentities", "ZERO", Triple::aarch64,
+    { AArch64::ADDWri, AArch64::ADDXri, AArch64::SUBWri, AArch64::SUBXri },
+    { InstructionClass::MovRegReg },
+    1
+);
@@ -46,6 +46,8 @@
  * Regular includes
  */
 #include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+#include "../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Modify `mov` immediate substitution options
@@ -70,16 +72,6 @@ private:
      */
     bool modified = false;
 
-    /**
-     * List of lambdas that invoke the `run` methods of AMD64 option classes.
-     */
-    std::vector<std::function<bool(MachineFunction&, bool)>> options_amd64;
-
-    /**
-     * List of lambdas that invoke the `run` methods of ARM64 option classes.
-     */
-    std::vector<std::function<bool(MachineFunction&, bool)>> options_arm64;
-
     /**
      * Whether the module is enabled (default) or disabled.
      * 
@@ -106,44 +98,25 @@ private:
 
 public:
 
-    /**
-     * Constructor that initializes the list of substitution option classes.
-     */
-    TransformNullificationsModule() {
-        options_amd64 = {
-            [&](MachineFunction &MF, bool modifyAll) { return TransformNullificationsOptionAMD64().runOnMachineFunction(MF, modifyAll); }
-        };
-
-        options_arm64 = {
-            [&](MachineFunction &MF, bool modifyAll) { return TransformNullificationsOptionARM64().runOnMachineFunction(MF, modifyAll); }
-        };
-    }
-
     /**
      * Main execution method for the TransformNullificationsModule class.
      *
      * @param MachineFunction& MF The machine function to run the substitution on.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF) {
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
         // Ensure module is enabled
         if (!moduleIsEnabled()) return false;
         bool modifyAll = moduleIsBeingTested();
 
-        // Run random compatible options
+        // Ensure the architecture is supported
         auto architecture = MF.getTarget().getTargetTriple().getArch();
-        int index = 0;
 
         switch (architecture) {
-            // AMD64
+            // AMD64 & ARM64
             case Triple::x86_64:
-                index = std::rand() % options_amd64.size();
-                modified = options_amd64[index](MF, modifyAll) || modified;
-                break;
-            // ARM64
             case Triple::aarch64:
-                index = std::rand() % options_arm64.size();
-                modified = options_arm64[index](MF, modifyAll) || modified;
                 break;
             // Unknown architecture
             default:
@@ -151,6 +124,40 @@ public:
                 break;
         }
 
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: TransformNullifications(modifyAll=" << modifyAll << ").\n";
+
+        // Pick a random compatible option for each instruction, weighted by the cost model of the target
+        TransformOptionSampler sampler("TransformNullifications", MF);
+        if (!sampler.hasOptions()) return modified;
+
+        std::vector<TransformContext::Candidate> candidates;
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                const TransformOption* option = sampler.pick(Instruction);
+                if (!option) continue;
+
+                // Only modify a random subset of the instructions (unless all should be modified)
+                if (!modifyAll && !RandomHelper::getChanceOneIn(2)) {
+                    dbgs() << "          ↳ Skipping modification because chance of 1 in 2 was not hit.\n";
+                    continue;
+                }
+
+                // Lower the density of modifications in hot code (unless the module is being tested)
+                if (!moduleIsBeingTested() && !context.shouldModify(MachineBasicBlock)) continue;
+
+                candidates.push_back({ &Instruction, option, sampler.getCandidateCount() });
+            }
+        }
+
+        // Apply the options (ranked & picked under the growth budget, if any)
+        if (context.applyOptions(candidates)) {
+            modified = true;
+        }
+
         return modified;
     }
 
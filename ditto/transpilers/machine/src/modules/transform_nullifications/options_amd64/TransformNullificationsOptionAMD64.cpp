@@ -46,6 +46,7 @@
  * Regular includes
  */
 #include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Namespace(s) to use
@@ -66,47 +67,38 @@ private:
 
 public:
 
+    /**
+     * Check if the given instruction can be substituted by the TransformNullificationsOptionAMD64 class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        return isXorToNullifyRegister(instruction);
+    }
+
     /**
      * Main execution method for the TransformNullificationsOptionAMD64 class.
      *
-     * @param MachineFunction& MF The machine function to run the substitution on.
-     * @param bool modifyAll Whether all the occurrences should be modified (for testing purposes).
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF, bool modifyAll) {
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
         // Local variables
-        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
-        MachineRegisterInfo &MRI = MF.getRegInfo();
-
-        // Inform user that we are running this option of the module
-        dbgs() << "        ↳ Running AMD64 module: TransformNullifications(modifyAll=" << modifyAll << ").\n";
-
-        // For each line in each basic block, perform our substitution
-        for (auto &MachineBasicBlock : MF) {
-            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
-                MachineInstr &Instruction = *MachineInstruction++;
+        auto &MachineBasicBlock = *Instruction.getParent();
+        const TargetInstrInfo *TII = MachineBasicBlock.getParent()->getSubtarget().getInstrInfo();
 
-                // Only modify `mov` instructions with immediate values
-                if (!isXorToNullifyRegister(Instruction)) {
-                    continue;
-                }
+        // Inform user that we encountered a `xor` instruction to nullify a register
+        dbgs() << "          ↳ Found AMD64 xor instruction to nullify a register: ";
+        Instruction.print(dbgs());
 
-                // Inform user that we encountered a `mov` instruction with immediate value
-                dbgs() << "          ↳ Found AMD64 xor instruction to nullify a register: ";
-                Instruction.print(dbgs());
+        // Build the new instruction: mov reg, 0
+        DebugLoc DL = Instruction.getDebugLoc();
+        BuildMI(MachineBasicBlock, Instruction, DL, TII->get(getXorSizeMovReplacement(Instruction)), Instruction.getOperand(0).getReg()).addImm(0);
 
-                if (!modifyAll && !RandomHelper::getChanceOneIn(2)) {
-                    dbgs() << "          ↳ Skipping modification because change of 1 in X was not hit.";
-                }
-
-                // Build the new instruction: mov reg, 0
-                DebugLoc DL = Instruction.getDebugLoc();
-                BuildMI(MachineBasicBlock, Instruction, DL, TII->get(getXorSizeMovReplacement(Instruction)), Instruction.getOperand(0).getReg()).addImm(0);
-
-                Instruction.eraseFromParent();
-                modified = true;
-            }
-        }
+        Instruction.eraseFromParent();
+        modified = true;
 
         return modified;
     }
@@ -165,4 +157,14 @@ private:
         }
     }
 
-};
\ No newline at end of file
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformNullifications` option `MOV`).
+ */
+static RegisterTransformOption<TransformNullificationsOptionAMD64> TransformNullificationsOptionAMD64Registration(
+    "TransformNullifications", "MOV", Triple::x86_64,
+    { X86::XOR8rr, X86::XOR16rr, X86::XOR32rr, X86::XOR64rr },
+    { InstructionClass::MovRegImmediate },
+    1
+);
\ No newline at end of file
@@ -45,6 +45,7 @@
  * Regular includes
  */
 #include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Namespace(s) to use
@@ -65,65 +66,56 @@ private:
 
 public:
 
+    /**
+     * Check if the given instruction can be substituted by the TransformNullificationsOptionARM64 class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        return isXorToNullifyRegister(instruction) || isMovToNullifyRegister(instruction);
+    }
+
     /**
      * Main execution method for the TransformNullificationsOptionARM64 class.
      *
-     * @param MachineFunction& MF The machine function to run the substitution on.
-     * @param bool modifyAll Whether all the occurrences should be modified (for testing purposes).
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF, bool modifyAll) {
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
         // Local variables
-        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
-        MachineRegisterInfo &MRI = MF.getRegInfo();
-
-        // Inform user that we are running this option of the module
-        dbgs() << "        ↳ Running ARM64 module: TransformNullifications(modifyAll=" << modifyAll << ").\n";
-
-        // For each line in each basic block, perform our substitution
-        for (auto &MachineBasicBlock : MF) {
-            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
-                MachineInstr &Instruction = *MachineInstruction++;
-
-                bool instructionIsXorToNullifyRegister = isXorToNullifyRegister(Instruction);
-                bool instructionIsMovToNullifyRegister = isMovToNullifyRegister(Instruction);
-
-                // Only modify `mov` instructions with immediate values
-                if (!instructionIsXorToNullifyRegister && !instructionIsMovToNullifyRegister) {
-                    continue;
-                }
-
-                // Inform user that we encountered a `mov` instruction with immediate value
-                dbgs() << "          ↳ Found ARM64 xor instruction to nullify a register: ";
-                Instruction.print(dbgs());
-
-                if (!modifyAll && !RandomHelper::getChanceOneIn(2)) {
-                    dbgs() << "          ↳ Skipping modification because change of 1 in X was not hit.";
-                }
-
-                DebugLoc DL = Instruction.getDebugLoc();
-
-                if (instructionIsXorToNullifyRegister) {
-                    // Build the new instruction: mov reg, 0
-                    BuildMI(MachineBasicBlock, Instruction, DL, TII->get(getXorSizeMovReplacement(Instruction)), Instruction.getOperand(0).getReg())
-                        .addImm(0)
-                        .addImm(0);
-                }
-
-                if (instructionIsMovToNullifyRegister) {
-                    // Build the new instruction: xor reg, reg
-                    unsigned xorOpcode = getMovSizeXorReplacement(Instruction);
-                    BuildMI(MachineBasicBlock, Instruction, DL, TII->get(xorOpcode), Instruction.getOperand(0).getReg())
-                        .addReg((xorOpcode == AArch64::ORRWrs) ? AArch64::WZR : AArch64::XZR)
-                        .addReg((xorOpcode == AArch64::ORRWrs) ? AArch64::WZR : AArch64::XZR)
-                        .addImm(0);
-                }
-
-                Instruction.eraseFromParent();
-                modified = true;
-            }
+        auto &MachineBasicBlock = *Instruction.getParent();
+        const TargetInstrInfo *TII = MachineBasicBlock.getParent()->getSubtarget().getInstrInfo();
+
+        bool instructionIsXorToNullifyRegister = isXorToNullifyRegister(Instruction);
+        bool instructionIsMovToNullifyRegister = isMovToNullifyRegister(Instruction);
+
+        // Inform user that we encountered an instruction to nullify a register
+        dbgs() << "          ↳ Found ARM64 instruction to nullify a register: ";
+        Instruction.print(dbgs());
+
+        DebugLoc DL = Instruction.getDebugLoc();
+
+        if (instructionIsXorToNullifyRegister) {
+            // Build the new instruction: mov reg, 0
+            BuildMI(MachineBasicBlock, Instruction, DL, TII->get(getXorSizeMovReplacement(Instruction)), Instruction.getOperand(0).getReg())
+                .addImm(0)
+                .addImm(0);
+        }
+
+        if (instructionIsMovToNullifyRegister) {
+            // Build the new instruction: xor reg, reg
+            unsigned xorOpcode = getMovSizeXorReplacement(Instruction);
+            BuildMI(MachineBasicBlock, Instruction, DL, TII->get(xorOpcode), Instruction.getOperand(0).getReg())
+                .addReg((xorOpcode == AArch64::ORRWrs) ? AArch64::WZR : AArch64::XZR)
+                .addReg((xorOpcode == AArch64::ORRWrs) ? AArch64::WZR : AArch64::XZR)
+                .addImm(0);
         }
 
+        Instruction.eraseFromParent();
+        modified = true;
+
         return modified;
     }
 
@@ -255,4 +247,14 @@ private:
         }
     }
 
-};
\ No newline at end of file
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformNullifications` option `MOV`).
+ */
+static RegisterTransformOption<TransformNullificationsOptionARM64> TransformNullificationsOptionARM64Registration(
+    "TransformNullifications", "MOV", Triple::aarch64,
+    { AArch64::EORWrr, AArch64::EORXrr, AArch64::EORWrs, AArch64::EORXrs, AArch64::ORRWrs, AArch64::ORRXrs, AArch64::MOVZWi, AArch64::MOVZXi },
+    { InstructionClass::MovRegImmediate },
+    1
+);
\ No newline at end of file
@@ -46,6 +46,8 @@
  * Regular includes
  */
 #include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+#include "../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Modify `mov reg, imm` immediate substitution options
@@ -56,6 +58,7 @@
 #include "options_arm64/TransformRegMovImmediatesOptionARM64_XOR.cpp"
 #include "options_arm64/TransformRegMovImmediatesOptionARM64_ADD.cpp"
 #include "options_arm64/TransformRegMovImmediatesOptionARM64_SUB.cpp"
+#include "options_arm64/TransformRegMovImmediatesOptionARM64_MATERIALIZE.cpp"
 
 /**
  * Namespace(s) to use
@@ -74,16 +77,6 @@ private:
      */
     bool modified = false;
 
-    /**
-     * List of lambdas that invoke the `run` methods of AMD64 option classes.
-     */
-    std::vector<std::function<bool(MachineFunction&, bool)>> options_amd64;
-
-    /**
-     * List of lambdas that invoke the `run` methods of ARM64 option classes.
-     */
-    std::vector<std::function<bool(MachineFunction&, bool)>> options_arm64;
-
     /**
      * Whether the module is enabled (default) or disabled.
      * 
@@ -108,50 +101,106 @@ private:
         return result;
     }
 
-public:
-
     /**
-     * Constructor that initializes the list of substitution option classes.
+     * Normalizes ARM64 `movn` and `movz` instructions into standard `mov` instructions.
+     *
+     * This function scans through the machine function's instructions and replaces supported
+     * immediate-move variants (e.g., MOVN, MOVZ) with equivalent `MOVi32imm` or `MOVi64imm`
+     * instructions. This simplifies further transformations, such as XOR-based immediate obfuscation.
+     *
+     * `MOVK` instructions are skipped as they require reconstructing full register values from partial updates.
+     *
+     * @param MachineFunction& MF The machine function to normalize MOV instructions in.
      */
-    TransformRegMovImmediatesModule() {
-        options_amd64 = {
-            [&](MachineFunction &MF, bool modifyAll) { return TransformRegMovImmediatesOptionAMD64_ADD().runOnMachineFunction(MF, modifyAll); },
-            [&](MachineFunction &MF, bool modifyAll) { return TransformRegMovImmediatesOptionAMD64_SUB().runOnMachineFunction(MF, modifyAll); },
-            [&](MachineFunction &MF, bool modifyAll) { return TransformRegMovImmediatesOptionAMD64_XOR().runOnMachineFunction(MF, modifyAll); }
-        };
-
-        options_arm64 = {
-            [&](MachineFunction &MF, bool modifyAll) { return TransformRegMovImmediatesOptionARM64_ADD().runOnMachineFunction(MF, modifyAll); },
-            [&](MachineFunction &MF, bool modifyAll) { return TransformRegMovImmediatesOptionARM64_SUB().runOnMachineFunction(MF, modifyAll); },
-            [&](MachineFunction &MF, bool modifyAll) { return TransformRegMovImmediatesOptionARM64_XOR().runOnMachineFunction(MF, modifyAll); }
-        };
+    void normalizeMovs(MachineFunction& MF) {
+        // Local variables
+        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                // Ensure we only substitute compatible instruction definitions
+                if (Instruction.getNumOperands() != 3 || !Instruction.getOperand(1).isImm() || !Instruction.getOperand(2).isImm())
+                    continue;
+
+                // Obtain information about the instruction
+                const DebugLoc& debugLocation = Instruction.getDebugLoc();
+                Register destinationRegister = Instruction.getOperand(0).getReg();
+                size_t immediateValue = (size_t) Instruction.getOperand(1).getImm();
+                size_t immediateShift = (size_t) Instruction.getOperand(2).getImm();
+                size_t originalOpcode = Instruction.getOpcode();
+
+                // Keep track of new information
+                bool replace = false;
+                size_t newOpcode = 0;
+                size_t newValue = 0;
+
+                switch (originalOpcode) {
+                    case AArch64::MOVNWi:
+                        newValue = ~(immediateValue << immediateShift) & 0xFFFFFFFF;
+                        newOpcode = AArch64::MOVi32imm;
+                        replace = true;
+                        break;
+                    case AArch64::MOVNXi:
+                        newValue = ~(immediateValue << immediateShift);
+                        newOpcode = AArch64::MOVi64imm;
+                        replace = true;
+                        break;
+                    case AArch64::MOVZWi:
+                        newValue = (immediateValue << immediateShift) & 0xFFFFFFFF;
+                        newOpcode = AArch64::MOVi32imm;
+                        replace = true;
+                        break;
+                    case AArch64::MOVZXi:
+                        newValue = (immediateValue << immediateShift);
+                        newOpcode = AArch64::MOVi64imm;
+                        replace = true;
+                        break;
+                    case AArch64::MOVKWi:
+                    case AArch64::MOVKXi:
+                        // MOVK is not fully reconstructable standalone—skip
+                        continue;
+                }
+
+                if (replace) {
+                    // Inform user that we encountered a `mov(z|n)` instruction with immediate value
+                    dbgs() << "          ↳ Normalizing ARM64 mov(z|n) instruction with immediate: ";
+                    Instruction.print(dbgs());
+
+                    BuildMI(MachineBasicBlock, Instruction, debugLocation, TII->get(newOpcode), destinationRegister).addImm(newValue);
+                    Instruction.eraseFromParent();
+                    modified = true;
+                }
+            }
+        }
     }
 
+public:
+
     /**
      * Main execution method for the TransformRegMovImmediatesModule class.
      *
      * @param MachineFunction& MF The machine function to run the substitution on.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF) {
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
         // Ensure module is enabled
         if (!moduleIsEnabled()) return false;
         bool modifyAll = true || moduleIsBeingTested(); // We always modify all instances
 
-        // Run random compatible options
+        // Ensure the architecture is supported
         auto architecture = MF.getTarget().getTargetTriple().getArch();
-        int index = 0;
 
         switch (architecture) {
             // AMD64
             case Triple::x86_64:
-                index = std::rand() % options_amd64.size();
-                modified = options_amd64[index](MF, modifyAll) || modified;
                 break;
             // ARM64
             case Triple::aarch64:
-                index = std::rand() % options_arm64.size();
-                modified = options_arm64[index](MF, modifyAll) || modified;
+                // First convert `movn` or `movz` instructions to regular movs
+                normalizeMovs(MF);
                 break;
             // Unknown architecture
             default:
@@ -159,6 +208,34 @@ public:
                 break;
         }
 
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: TransformRegMovImmediates(modifyAll=" << modifyAll << ").\n";
+
+        // Pick a random compatible option for each instruction, weighted by the cost model of the target
+        TransformOptionSampler sampler("TransformRegMovImmediates", MF);
+        if (!sampler.hasOptions()) return modified;
+
+        std::vector<TransformContext::Candidate> candidates;
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                const TransformOption* option = sampler.pick(Instruction);
+                if (!option) continue;
+
+                // Lower the density of modifications in hot code (unless the module is being tested)
+                if (!moduleIsBeingTested() && !context.shouldModify(MachineBasicBlock)) continue;
+
+                candidates.push_back({ &Instruction, option, sampler.getCandidateCount() });
+            }
+        }
+
+        // Apply the options (ranked & picked under the growth budget, if any)
+        if (context.applyOptions(candidates)) {
+            modified = true;
+        }
+
         return modified;
     }
 
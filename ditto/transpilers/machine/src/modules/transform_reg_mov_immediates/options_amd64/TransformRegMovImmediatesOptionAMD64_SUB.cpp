@@ -46,6 +46,8 @@
  * Regular includes
  */
 #include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Namespace(s) to use
@@ -66,77 +68,88 @@ private:
 
 public:
 
+    /**
+     * Check if the given instruction can be substituted by the TransformRegMovImmediatesOptionAMD64_SUB class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        return isRegMovImmediate(instruction);
+    }
+
     /**
      * Main execution method for the TransformRegMovImmediatesOptionAMD64_SUB class.
      *
-     * @param MachineFunction& MF The machine function to run the substitution on.
-     * @param bool modifyAll Whether all the occurrences should be modified (for testing purposes).
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF, bool modifyAll) {
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
         // Local variables
+        auto MachineInstruction = std::next(Instruction.getIterator());
+        auto &MachineBasicBlock = *Instruction.getParent();
+        MachineFunction &MF = *MachineBasicBlock.getParent();
         const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
         MachineRegisterInfo &MRI = MF.getRegInfo();
 
-        // Inform user that we are running this option of the module
-        dbgs() << "        ↳ Running AMD64 module: TransformRegMovImmediates(option=SUB,modifyAll=" << modifyAll << ").\n";
-
-        // For each line in each basic block, perform our substitution
-        for (auto &MachineBasicBlock : MF) {
-            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
-                MachineInstr &Instruction = *MachineInstruction++;
-
-                // Only modify `mov` instructions with immediate values
-                if (!isRegMovImmediate(Instruction)) {
-                    continue;
-                }
-
-                // Inform user that we encountered a `mov` instruction with immediate value
-                dbgs() << "          ↳ Found AMD64 mov instruction with immediate: ";
-                Instruction.print(dbgs());
-
-                // Obtain information about the instruction
-                const DebugLoc& debugLocation = Instruction.getDebugLoc();
-                Register destinationRegister = Instruction.getOperand(0).getReg();
-                size_t immediateValue = (size_t) Instruction.getOperand(1).getImm();
-                size_t immediateSize = getMovImmediateSize(Instruction);
-                size_t originalOpcode = Instruction.getOpcode();
-                unsigned subOpcode = getMovSizeSubReplacement(Instruction);
-
-                // Generate SUB key on compile time
-                size_t subKey = RandomHelper::getSimilarIntegerForDestination(immediateSize, immediateValue, false);
-
-                // `add` the immediate value and mask it to the correct size
-                size_t immediateValueEncoded = immediateValue + subKey;
-                int64_t immediateMask = (immediateSize == 64) ? -1 : ((1ULL << immediateSize) - 1);
-                immediateValueEncoded = immediateValueEncoded & immediateMask;
-
-                // Register to use in the substition
-                Register virtualSubKeyRegister;
-
-                // Allocate a virtual register for the `sub` key
-                switch (immediateSize) {
-                    case 64: virtualSubKeyRegister = MRI.createVirtualRegister(&X86::GR64RegClass); break;
-                    case 32: virtualSubKeyRegister = MRI.createVirtualRegister(&X86::GR32RegClass); break;
-                    case 16: virtualSubKeyRegister = MRI.createVirtualRegister(&X86::GR16RegClass); break;
-                    default: virtualSubKeyRegister = MRI.createVirtualRegister(&X86::GR8RegClass); break;
-                }
-
-                // 1. mov [sub key register], [sub key immediate value]
-                // 2. mov [original register], [encoded immediate value]
-                // 3. sub [original register], [sub key register]
-                BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), virtualSubKeyRegister).addImm(subKey);
-                BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), destinationRegister).addImm(immediateValueEncoded);
-                BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(subOpcode), destinationRegister).addReg(destinationRegister).addReg(virtualSubKeyRegister);
-
-                Instruction.eraseFromParent();
-
-                // Inform module and user that we've successfully substituted the immediate value.
-                modified = true;
-                dbgs() << "          ✓ Modified immediate value using random option `SUB`.\n";
-            }
+        // Inform user that we encountered a `mov` instruction with immediate value
+        dbgs() << "          ↳ Found AMD64 mov instruction with immediate: ";
+        Instruction.print(dbgs());
+
+        // Obtain information about the instruction
+        const DebugLoc& debugLocation = Instruction.getDebugLoc();
+        Register destinationRegister = Instruction.getOperand(0).getReg();
+        size_t immediateValue = (size_t) Instruction.getOperand(1).getImm();
+        size_t immediateSize = getMovImmediateSize(Instruction);
+        size_t originalOpcode = Instruction.getOpcode();
+        unsigned subOpcode = getMovSizeSubReplacement(Instruction);
+
+        // Register class of the `sub` key
+        const TargetRegisterClass* keyRegisterClass;
+
+        switch (immediateSize) {
+            case 64: keyRegisterClass = &X86::GR64RegClass; break;
+            case 32: keyRegisterClass = &X86::GR32RegClass; break;
+            case 16: keyRegisterClass = &X86::GR16RegClass; break;
+            default: keyRegisterClass = &X86::GR8RegClass; break;
+        }
+
+        // Use an immediate `sub` key (which needs no additional register) if the block is under register pressure
+        bool downgrade = context.getPressureDecision(Instruction, keyRegisterClass, true) == TransformContext::PressureDecision::Downgrade;
+
+        // Generate SUB key on compile time (immediate keys of 64-bit instructions are sign extended 32-bit values)
+        size_t subKey = RandomHelper::getSimilarIntegerForDestination((downgrade && immediateSize == 64) ? 32 : immediateSize, immediateValue, false);
+        if (downgrade && immediateSize == 64) subKey = (size_t) (int64_t) (int32_t) subKey;
+
+        // `sub` the immediate value and mask it to the correct size
+        size_t immediateValueEncoded = immediateValue + subKey;
+        int64_t immediateMask = (immediateSize == 64) ? -1 : ((1ULL << immediateSize) - 1);
+        immediateValueEncoded = immediateValueEncoded & immediateMask;
+
+        if (downgrade) {
+            // 1. mov [original register], [encoded immediate value]
+            // 2. sub [original register], [sub key immediate value]
+            BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), destinationRegister).addImm(immediateValueEncoded);
+            BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(getMovSizeSubImmediateReplacement(Instruction)), destinationRegister).addReg(destinationRegister).addImm(subKey);
+        } else {
+            // Allocate a virtual register for the `sub` key
+            Register virtualSubKeyRegister = MRI.createVirtualRegister(keyRegisterClass);
+
+            // 1. mov [sub key register], [sub key immediate value]
+            // 2. mov [original register], [encoded immediate value]
+            // 3. sub [original register], [sub key register]
+            BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), virtualSubKeyRegister).addImm(subKey);
+            BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), destinationRegister).addImm(immediateValueEncoded);
+            BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(subOpcode), destinationRegister).addReg(destinationRegister).addReg(virtualSubKeyRegister);
         }
-        
+
+        Instruction.eraseFromParent();
+
+        // Inform module and user that we've successfully substituted the immediate value.
+        modified = true;
+        dbgs() << "          ✓ Modified immediate value using random option `SUB`.\n";
+
         return modified;
     }
 
@@ -204,6 +217,32 @@ private:
         }
     }
 
+    /**
+     * Determines the SUB (with immediate) replacement opcode for a given MOV instruction opcode.
+     * 
+     * This is the downgraded form of the substitution, which uses an immediate key instead of a key
+     * register, so that it doesn't add register pressure.
+     * 
+     * If the opcode does not match any known MOV instruction types, a fatal error is reported.
+     *
+     * @param MachineFunction& MF instruction The `MachineInstr` whose opcode will be checked and replaced with the corresponding SUB opcode.
+     * @return unsigned The corresponding SUB (with immediate) opcode for the MOV instruction's immediate size.
+     */
+    unsigned getMovSizeSubImmediateReplacement(const MachineInstr &instruction) {
+        unsigned opcode = instruction.getOpcode();
+
+        switch (opcode) {
+            case X86::MOV8ri:    return X86::SUB8ri;
+            case X86::MOV16ri:   return X86::SUB16ri;
+            case X86::MOV32ri:   return X86::SUB32ri;
+            case X86::MOV64ri:   return X86::SUB64ri32;
+            case X86::MOV64ri32: return X86::SUB64ri32;
+            default:
+                report_fatal_error(formatv("TransformRegMovImmediatesOptionAMD64_SUB - Unknown SUB (with immediate) replacement size for opcode {0:X}: {1}.", opcode, instruction));
+                return 0;
+        }
+    }
+
     /**
      * Checks if the given instruction is a MOV instruction with an immediate operand.
      * 
@@ -229,4 +268,14 @@ private:
         }
     }
 
-};
\ No newline at end of file
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformRegMovImmediates` option `SUB`).
+ */
+static RegisterTransformOption<TransformRegMovImmediatesOptionAMD64_SUB> TransformRegMovImmediatesOptionAMD64_SUBRegistration(
+    "TransformRegMovImmediates", "SUB", Triple::x86_64,
+    { X86::MOV8ri, X86::MOV16ri, X86::MOV32ri, X86::MOV64ri, X86::MOV64ri32 },
+    { InstructionClass::MovRegImmediate, InstructionClass::MovRegImmediate, InstructionClass::AluRegReg },
+    1
+);
\ No newline at end of file
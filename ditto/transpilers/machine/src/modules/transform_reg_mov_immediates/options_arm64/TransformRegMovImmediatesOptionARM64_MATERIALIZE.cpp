@@ -0,0 +1,389 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/AArch64/AArch64.h"
+#include "llvm/Target/AArch64/AArch64ExpandImm.h"
+#include "llvm/Target/AArch64/AArch64InstrInfo.h"
+#include "llvm/Target/AArch64/MCTargetDesc/AArch64AddressingModes.h"
+#include "llvm/TargetParser/Triple.h"
+
+/**
+ * Regular includes
+ */
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
+
+/**
+ * Namespace(s) to use
+ */
+using namespace llvm;
+
+/**
+ * A class to randomize how `mov` immediate values are materialized, without adding instructions.
+ *
+ * The `MOVi32imm` & `MOVi64imm` pseudo instructions are normally expanded into one fixed sequence
+ * (see `AArch64_IMM::expandMOVImm`). Most constants however have several sequences of the same length,
+ * e.g. `movz` or `movn` as first instruction, any order of the `movk` chunks, or an `orr` of a logical
+ * immediate (optionally followed by a `movk`). This option emits a random one of those sequences.
+ */
+class TransformRegMovImmediatesOptionARM64_MATERIALIZE {
+
+private:
+
+    /**
+     * Whether this class modified the machine function.
+     */
+    bool modified = false;
+
+    /**
+     * A single instruction of a materialization sequence.
+     */
+    struct Step {
+        unsigned opcode;
+        uint64_t immediate;
+        unsigned shift;
+
+        bool operator==(const Step& other) const {
+            return opcode == other.opcode && immediate == other.immediate && shift == other.shift;
+        }
+    };
+
+    /**
+     * The alternative sequences per immediate value, register size and whether `orr` is allowed.
+     */
+    std::map<std::tuple<uint64_t, unsigned, bool>, std::vector<std::vector<Step>>> sequencesCache;
+
+public:
+
+    /**
+     * Check if the given instruction can be substituted by the TransformRegMovImmediatesOptionARM64_MATERIALIZE class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        if (!isRegMovImmediate(instruction)) return false;
+
+        // There must be at least one sequence that differs from the default expansion
+        return !getCachedSequences(getMovImmediateValue(instruction), getMovImmediateSize(instruction), isOrrAllowed(instruction)).empty();
+    }
+
+    /**
+     * Main execution method for the TransformRegMovImmediatesOptionARM64_MATERIALIZE class.
+     *
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
+     * @return bool Indicates if the machine function was modified.
+     */
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
+        // Local variables
+        auto MachineInstruction = std::next(Instruction.getIterator());
+        auto &MachineBasicBlock = *Instruction.getParent();
+        MachineFunction &MF = *MachineBasicBlock.getParent();
+        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+        MachineRegisterInfo &MRI = MF.getRegInfo();
+
+        // Inform user that we encountered a `mov` instruction with immediate value
+        dbgs() << "          ↳ Found ARM64 mov instruction with immediate: ";
+        Instruction.print(dbgs());
+
+        // Obtain information about the instruction
+        const DebugLoc& debugLocation = Instruction.getDebugLoc();
+        Register destinationRegister = Instruction.getOperand(0).getReg();
+        unsigned immediateSize = getMovImmediateSize(Instruction);
+        uint64_t immediateValue = getMovImmediateValue(Instruction);
+        Register zeroRegister = (immediateSize == 64) ? AArch64::XZR : AArch64::WZR;
+
+        // Pick a random sequence (all sequences differ from, but have the length of, the default expansion)
+        const std::vector<std::vector<Step>>& sequences = getCachedSequences(immediateValue, immediateSize, isOrrAllowed(Instruction));
+        if (sequences.empty()) return false;
+
+        std::uniform_int_distribution<size_t> distribution(0, sequences.size() - 1);
+        const std::vector<Step>& sequence = sequences[distribution(RandomHelper::getRandomGenerator())];
+
+        // The destination of `orr` (immediate) may be the stack pointer, but not the zero register
+        if (sequence.front().opcode == AArch64::ORRWri || sequence.front().opcode == AArch64::ORRXri) {
+            if (destinationRegister.isVirtual()) MRI.constrainRegClass(destinationRegister, getOrrRegisterClass(immediateSize));
+        }
+
+        // 1. movz/movn/orr [original register], [first chunk or logical immediate]
+        // 2. movk [original register], [remaining chunks in random order]
+        for (const Step& step : sequence) {
+            switch (step.opcode) {
+                case AArch64::ORRWri:
+                case AArch64::ORRXri:
+                    BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(step.opcode), destinationRegister).addReg(zeroRegister).addImm(step.immediate);
+                    break;
+                case AArch64::MOVKWi:
+                case AArch64::MOVKXi:
+                    BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(step.opcode), destinationRegister).addReg(destinationRegister).addImm(step.immediate).addImm(step.shift);
+                    break;
+                default:
+                    BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(step.opcode), destinationRegister).addImm(step.immediate).addImm(step.shift);
+                    break;
+            }
+        }
+
+        // Erase the original instruction after inserting the new ones
+        Instruction.eraseFromParent();
+
+        // Inform module and user that we've successfully substituted the immediate value.
+        modified = true;
+        dbgs() << "          ✓ Modified immediate value using random option `MATERIALIZE` (" << sequences.size() << " equal-length sequences).\n";
+
+        return modified;
+    }
+
+private:
+
+    /**
+     * Retrieve the default expansion of an immediate value, as emitted by the AArch64 pseudo expansion.
+     *
+     * @param uint64_t value The immediate value.
+     * @param unsigned size The size of the register (32 or 64 bits).
+     * @return std::vector<Step> The instructions of the default expansion.
+     */
+    std::vector<Step> getExpansion(uint64_t value, unsigned size) {
+        SmallVector<AArch64_IMM::ImmInsnModel, 4> instructions;
+        AArch64_IMM::expandMOVImm(value, size, instructions);
+
+        std::vector<Step> result;
+        for (const AArch64_IMM::ImmInsnModel& instruction : instructions) {
+            // Logical immediates keep the encoding in the second operand
+            bool logical = instruction.Opcode == AArch64::ORRWri || instruction.Opcode == AArch64::ORRXri;
+            result.push_back({ instruction.Opcode, logical ? instruction.Op2 : instruction.Op1, logical ? 0u : (unsigned) instruction.Op2 });
+        }
+
+        return result;
+    }
+
+    /**
+     * Retrieve the alternative sequences of the given value, which are only enumerated once per value.
+     *
+     * @param uint64_t value The immediate value.
+     * @param unsigned size The size of the register (32 or 64 bits).
+     * @param bool orrAllowed Whether the destination register can be written by `orr` (immediate).
+     * @return const std::vector<std::vector<Step>>& The (unique) alternative sequences.
+     */
+    const std::vector<std::vector<Step>>& getCachedSequences(uint64_t value, unsigned size, bool orrAllowed) {
+        auto key = std::make_tuple(value, size, orrAllowed);
+        auto cached = sequencesCache.find(key);
+
+        if (cached == sequencesCache.end()) {
+            cached = sequencesCache.emplace(key, getSequences(value, size, orrAllowed)).first;
+        }
+
+        return cached->second;
+    }
+
+    /**
+     * Enumerate all sequences that materialize the given value, with the same length as the default expansion.
+     *
+     * The default expansion itself is excluded, so that every substitution changes the instructions.
+     *
+     * @param uint64_t value The immediate value.
+     * @param unsigned size The size of the register (32 or 64 bits).
+     * @param bool orrAllowed Whether the destination register can be written by `orr` (immediate).
+     * @return std::vector<std::vector<Step>> The (unique) alternative sequences.
+     */
+    std::vector<std::vector<Step>> getSequences(uint64_t value, unsigned size, bool orrAllowed) {
+        unsigned movz = (size == 64) ? AArch64::MOVZXi : AArch64::MOVZWi;
+        unsigned movn = (size == 64) ? AArch64::MOVNXi : AArch64::MOVNWi;
+        unsigned movk = (size == 64) ? AArch64::MOVKXi : AArch64::MOVKWi;
+        unsigned orr = (size == 64) ? AArch64::ORRXri : AArch64::ORRWri;
+        unsigned chunks = size / 16;
+
+        std::vector<std::vector<Step>> result;
+        auto add = [&](const std::vector<Step>& sequence) {
+            if (std::find(result.begin(), result.end(), sequence) == result.end()) result.push_back(sequence);
+        };
+
+        // `movz` (starting from zero) or `movn` (starting from all ones), with the other chunks in any order
+        for (bool inverted : { false, true }) {
+            uint64_t fill = inverted ? 0xFFFF : 0x0000;
+
+            std::vector<unsigned> order;
+            for (unsigned chunk = 0; chunk < chunks; chunk++) {
+                if (getChunk(value, chunk) != fill) order.push_back(chunk);
+            }
+
+            // A value that equals the fill is materialized by a single `movz #0` or `movn #0`
+            if (order.empty()) {
+                add({ { inverted ? movn : movz, 0, 0 } });
+                continue;
+            }
+
+            do {
+                std::vector<Step> sequence;
+                uint64_t first = getChunk(value, order.front());
+                sequence.push_back({ inverted ? movn : movz, inverted ? (~first & 0xFFFF) : first, order.front() * 16 });
+
+                for (size_t index = 1; index < order.size(); index++) {
+                    sequence.push_back({ movk, getChunk(value, order[index]), order[index] * 16 });
+                }
+
+                add(sequence);
+            } while (std::next_permutation(order.begin(), order.end()));
+        }
+
+        // `orr` of a logical immediate, optionally followed by a `movk` that patches one chunk
+        if (orrAllowed) {
+            uint64_t encoding = 0;
+            if (AArch64_AM::processLogicalImmediate(value, size, encoding)) add({ { orr, encoding, 0 } });
+
+            for (unsigned chunk = 0; chunk < chunks; chunk++) {
+                std::vector<uint64_t> replacements = { 0x0000, 0xFFFF };
+                for (unsigned other = 0; other < chunks; other++) replacements.push_back(getChunk(value, other));
+
+                for (uint64_t replacement : replacements) {
+                    uint64_t patched = (value & ~(0xFFFFULL << (chunk * 16))) | (replacement << (chunk * 16));
+                    if (patched == value || !AArch64_AM::processLogicalImmediate(patched, size, encoding)) continue;
+
+                    add({ { orr, encoding, 0 }, { movk, getChunk(value, chunk), chunk * 16 } });
+                }
+            }
+        }
+
+        // Only keep sequences that are as short as (but differ from) the default expansion
+        std::vector<Step> expansion = getExpansion(value, size);
+        result.erase(std::remove_if(result.begin(), result.end(), [&](const std::vector<Step>& sequence) { return sequence.size() != expansion.size() || sequence == expansion; }), result.end());
+
+        return result;
+    }
+
+    /**
+     * Retrieve a 16-bit chunk of a value.
+     *
+     * @param uint64_t value The value.
+     * @param unsigned chunk The index of the chunk (0 is the least significant).
+     * @return uint64_t The chunk.
+     */
+    uint64_t getChunk(uint64_t value, unsigned chunk) {
+        return (value >> (chunk * 16)) & 0xFFFF;
+    }
+
+    /**
+     * Retrieve the register class that `orr` (immediate) can write to.
+     *
+     * @param unsigned size The size of the register (32 or 64 bits).
+     * @return const TargetRegisterClass* The register class (general purpose registers or the stack pointer).
+     */
+    const TargetRegisterClass* getOrrRegisterClass(unsigned size) {
+        return (size == 64) ? (const TargetRegisterClass*) &AArch64::GPR64spRegClass : &AArch64::GPR32spRegClass;
+    }
+
+    /**
+     * Check if the destination register of the instruction can be written by `orr` (immediate).
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the destination is a general purpose register (and not the zero register).
+     */
+    bool isOrrAllowed(const MachineInstr &instruction) {
+        const MachineFunction &MF = *instruction.getParent()->getParent();
+        const TargetRegisterInfo *TRI = MF.getSubtarget().getRegisterInfo();
+        const TargetRegisterClass* registerClass = getOrrRegisterClass(getMovImmediateSize(instruction));
+        Register destinationRegister = instruction.getOperand(0).getReg();
+
+        if (destinationRegister.isPhysical()) return registerClass->contains(destinationRegister);
+        return TRI->getCommonSubClass(MF.getRegInfo().getRegClass(destinationRegister), registerClass) != nullptr;
+    }
+
+    /**
+     * Determines the size of the immediate value for a given machine instruction.
+     *
+     * @param const MachineInstr& instruction The `MachineInstr` whose opcode will be checked to determine the immediate size.
+     * @return unsigned The size of the immediate value in bits (32 or 64).
+     */
+    unsigned getMovImmediateSize(const MachineInstr &instruction) {
+        unsigned opcode = instruction.getOpcode();
+
+        switch (opcode) {
+            case AArch64::MOVi32imm:
+                return 32;
+                break;
+            case AArch64::MOVi64imm:
+                return 64;
+                break;
+            default:
+                report_fatal_error(formatv("TransformRegMovImmediatesOptionARM64_MATERIALIZE - Unknown immediate size for opcode {0:X}: {1}.", opcode, instruction));
+                return 0;
+        }
+    }
+
+    /**
+     * Retrieve the immediate value of the instruction, masked to the size of the register.
+     *
+     * @param const MachineInstr& instruction The instruction to retrieve the immediate value of.
+     * @return uint64_t The immediate value.
+     */
+    uint64_t getMovImmediateValue(const MachineInstr &instruction) {
+        uint64_t value = (uint64_t) instruction.getOperand(1).getImm();
+        return (getMovImmediateSize(instruction) == 64) ? value : (value & 0xFFFFFFFF);
+    }
+
+    /**
+     * Checks if the given instruction is a MOV instruction with an immediate operand.
+     *
+     * @param const MachineInstr& instruction The `MachineInstr` whose opcode will be checked to determine if it's a MOV with an immediate operand.
+     * @return bool Returns `true` if the instruction is a MOV immediate instruction, otherwise `false`.
+     */
+    bool isRegMovImmediate(const MachineInstr &instruction) {
+        unsigned opcode = instruction.getOpcode();
+
+        if (instruction.getNumOperands() != 2) return false;
+        if (!instruction.getOperand(0).isReg()) return false;
+        if (!instruction.getOperand(1).isImm()) return false;
+
+        switch (opcode) {
+            case AArch64::MOVi32imm:
+            case AArch64::MOVi64imm:
+                return true;
+                break;
+            default:
+                return false;
+                break;
+        }
+    }
+
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformRegMovImmediates` option `MATERIALIZE`).
+ */
+static RegisterTransformOption<TransformRegMovImmediatesOptionARM64_MATERIALIZE> TransformRegMovImmediatesOptionARM64_MATERIALIZERegistration(
+    "TransformRegMovImmediates", "MATERIALIZE", Triple::aarch64,
+    { AArch64::MOVi32imm, AArch64::MOVi64imm },
+    { InstructionClass::MovRegImmediate },
+    1
+);
@@ -45,6 +45,8 @@
  * Regular includes
  */
 #include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Namespace(s) to use
@@ -65,79 +67,72 @@ private:
 
 public:
 
+    /**
+     * Check if the given instruction can be substituted by the TransformRegMovImmediatesOptionARM64_SUB class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        return isRegMovImmediate(instruction);
+    }
+
     /**
      * Main execution method for the TransformRegMovImmediatesOptionARM64_SUB class.
      *
-     * @param MachineFunction& MF The machine function to run the substitution on.
-     * @param bool modifyAll Whether all the occurrences should be modified (for testing purposes).
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF, bool modifyAll) {
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
         // Local variables
+        auto MachineInstruction = std::next(Instruction.getIterator());
+        auto &MachineBasicBlock = *Instruction.getParent();
+        MachineFunction &MF = *MachineBasicBlock.getParent();
         const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
         MachineRegisterInfo &MRI = MF.getRegInfo();
 
-        // Inform user that we are running this option of the module
-        dbgs() << "        ↳ Running ARM64 module: TransformRegMovImmediates(option=SUB,modifyAll=" << modifyAll << ").\n";
-
-        // First convert `movn`, `movz` or `movk` instructions to regular movs
-        normalizeMovs(MF);
-
-        // For each line in each basic block, perform our substitution
-        for (auto &MachineBasicBlock : MF) {
-            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
-                MachineInstr &Instruction = *MachineInstruction++;
+        // Inform user that we encountered a `mov` instruction with immediate value
+        dbgs() << "          ↳ Found ARM64 mov instruction with immediate: ";
+        Instruction.print(dbgs());
 
-                // Only modify `mov` instructions with immediate values
-                if (!isRegMovImmediate(Instruction)) {
-                    continue;
-                }
+        // Obtain information about the instruction
+        const DebugLoc& debugLocation = Instruction.getDebugLoc();
+        Register destinationRegister = Instruction.getOperand(0).getReg();
+        size_t immediateValue = (size_t) Instruction.getOperand(1).getImm();
+        size_t immediateSize = getMovImmediateSize(Instruction);
+        size_t originalOpcode = Instruction.getOpcode();
+        unsigned subOpcode = getMovSizeSubReplacement(Instruction);
 
-                // Inform user that we encountered a `mov` instruction with immediate value
-                dbgs() << "          ↳ Found ARM64 mov instruction with immediate: ";
-                Instruction.print(dbgs());
+        // Skip the substitution if the key register would exceed the allocatable registers (there is no generic immediate form on ARM64)
+        const TargetRegisterClass* keyRegisterClass = (immediateSize == 64) ? (const TargetRegisterClass*) &AArch64::GPR64RegClass : &AArch64::GPR32RegClass;
+        if (context.getPressureDecision(Instruction, keyRegisterClass, false) == TransformContext::PressureDecision::Skip) return false;
 
-                // Obtain information about the instruction
-                const DebugLoc& debugLocation = Instruction.getDebugLoc();
-                Register destinationRegister = Instruction.getOperand(0).getReg();
-                size_t immediateValue = (size_t) Instruction.getOperand(1).getImm();
-                size_t immediateSize = getMovImmediateSize(Instruction);
-                size_t originalOpcode = Instruction.getOpcode();
-                unsigned subOpcode = getMovSizeSubReplacement(Instruction);
+        // Generate mask on compile time
+        size_t subKey = RandomHelper::getSimilarIntegerForDestination(immediateSize, immediateValue, false);
 
-                // Generate mask on compile time
-                size_t subKey = RandomHelper::getSimilarIntegerForDestination(immediateSize, immediateValue, false);
+        // `add` the immediate value and mask it to the correct size
+        size_t immediateValueEncoded = (immediateValue + subKey);
+        int64_t immediateMask = (immediateSize == 64) ? -1 : ((1ULL << immediateSize) - 1);
+        immediateValueEncoded = immediateValueEncoded & immediateMask;
 
-                // `add` the immediate value and mask it to the correct size
-                size_t immediateValueEncoded = (immediateValue + subKey);
-                int64_t immediateMask = (immediateSize == 64) ? -1 : ((1ULL << immediateSize) - 1);
-                immediateValueEncoded = immediateValueEncoded & immediateMask;
+        // Allocate a virtual register for the `sub` key
+        Register virtualSubKeyRegister = MRI.createVirtualRegister(keyRegisterClass);
 
-                // Register to use in the substition
-                Register virtualSubKeyRegister;
+        // 1. mov [original register], [encoded immediate value]
+        // 2. mov [sub key register], [sub key]
+        // 3. sub [original register], [original register], [sub key register]
+        BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), destinationRegister).addImm(immediateValueEncoded);
+        BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), virtualSubKeyRegister).addImm(subKey);
+        BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(subOpcode), destinationRegister).addReg(destinationRegister).addReg(virtualSubKeyRegister);
 
-                // Allocate a virtual register for the `sub` key
-                switch (immediateSize) {
-                    case 64: virtualSubKeyRegister = MRI.createVirtualRegister(&AArch64::GPR64RegClass); break;
-                    default: virtualSubKeyRegister = MRI.createVirtualRegister(&AArch64::GPR32RegClass); break;
-                }
+        // Erase the original instruction after inserting the new ones
+        Instruction.eraseFromParent();
 
-                // 1. mov [original register], [encoded immediate value]
-                // 2. mov [sub key register], [sub key]
-                // 3. sub [original register], [original register], [sub key register]
-                BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), destinationRegister).addImm(immediateValueEncoded);
-                BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(originalOpcode), virtualSubKeyRegister).addImm(subKey);
-                BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(subOpcode), destinationRegister).addReg(destinationRegister).addReg(virtualSubKeyRegister);
+        // Inform module and user that we've successfully substituted the immediate value.
+        modified = true;
+        dbgs() << "          ✓ Modified immediate value using random option `SUB`.\n";
 
-                // Erase the original instruction after inserting the new ones
-                Instruction.eraseFromParent();
-
-                // Inform module and user that we've successfully substituted the immediate value.
-                modified = true;
-                dbgs() << "          ✓ Modified immediate value using random option `SUB`.\n";
-            }
-        }
-        
         return modified;
     }
 
@@ -218,80 +213,15 @@ private:
                 break;
         }
     }
-        
-    /**
-     * Normalizes `movn`, `movz`, and `movk` instructions into standard `mov` instructions.
-     *
-     * This function scans through the machine function's instructions and replaces supported
-     * immediate-move variants (e.g., MOVN, MOVZ) with equivalent `MOVi32imm` or `MOVi64imm`
-     * instructions. This simplifies further transformations, such as SUB-based immediate obfuscation.
-     * 
-     * `MOVK` instructions are skipped as they require reconstructing full register values from partial updates.
-     *
-     * @param MachineFunction& MF The machine function to normalize MOV instructions in.
-     */
-    void normalizeMovs(MachineFunction& MF) {
-        // Local variables
-        const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
-
-        for (auto &MachineBasicBlock : MF) {
-            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
-                MachineInstr &Instruction = *MachineInstruction++;
-
-                // Ensure we only substitute compatible instruction definitions
-                if (Instruction.getNumOperands() != 3 || !Instruction.getOperand(1).isImm() || !Instruction.getOperand(2).isImm())
-                    continue;
-
-                // Inform user that we encountered a `mov(z|k|n)` instruction with immediate value
-                dbgs() << "          ↳ Found ARM64 mov(z|k|n) instruction with immediate: ";
-                Instruction.print(dbgs());
-
-                // Obtain information about the instruction
-                const DebugLoc& debugLocation = Instruction.getDebugLoc();
-                Register destinationRegister = Instruction.getOperand(0).getReg();
-                size_t immediateValue = (size_t) Instruction.getOperand(1).getImm();
-                size_t immediateShift = (size_t) Instruction.getOperand(2).getImm();
-                size_t originalOpcode = Instruction.getOpcode();
 
-                // Keep track of new information
-                bool replace = false;
-                size_t newOpcode = 0;
-                size_t newValue = 0;
+};
 
-                switch (originalOpcode) {
-                    case AArch64::MOVNWi:
-                        newValue = ~(immediateValue << immediateShift) & 0xFFFFFFFF;
-                        newOpcode = AArch64::MOVi32imm;
-                        replace = true;
-                        break;
-                    case AArch64::MOVNXi:
-                        newValue = ~(immediateValue << immediateShift);
-                        newOpcode = AArch64::MOVi64imm;
-                        replace = true;
-                        break;
-                    case AArch64::MOVZWi:
-                        newValue = (immediateValue << immediateShift) & 0xFFFFFFFF;
-                        newOpcode = AArch64::MOVi32imm;
-                        replace = true;
-                        break;
-                    case AArch64::MOVZXi:
-                        newValue = (immediateValue << immediateShift);
-                        newOpcode = AArch64::MOVi64imm;
-                        replace = true;
-                        break;
-                    case AArch64::MOVKWi:
-                    case AArch64::MOVKXi:
-                        // MOVK is not fully reconstructable standalone—skip
-                        continue;
-                }
-
-                if (replace) {
-                    BuildMI(MachineBasicBlock, Instruction, debugLocation, TII->get(newOpcode), destinationRegister).addImm(newValue);
-                    Instruction.eraseFromParent();
-                    modified = true;
-                }
-            }
-        }
-    }
-
-};
\ No newline at end of file
+/**
+ * Register the option with the transform option registry (as `TransformRegMovImmediates` option `SUB`).
+ */
+static RegisterTransformOption<TransformRegMovImmediatesOptionARM64_SUB> TransformRegMovImmediatesOptionARM64_SUBRegistration(
+    "TransformRegMovImmediates", "SUB", Triple::aarch64,
+    { AArch64::MOVi32imm, AArch64::MOVi64imm },
+    { InstructionClass::MovRegImmediate, InstructionClass::MovRegImmediate, InstructionClass::AluRegReg },
+    1
+);
\ No newline at end of file
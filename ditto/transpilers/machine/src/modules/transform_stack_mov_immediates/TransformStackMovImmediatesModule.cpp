@@ -46,6 +46,8 @@
  * Regular includes
  */
 #include "../../../../shared/helpers/RandomHelper.cpp"
+#include "../../helpers/TransformContext.cpp"
+#include "../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Modify `mov [reg+var_a], imm` immediate substitution options
@@ -71,16 +73,6 @@ private:
      */
     bool modified = false;
 
-    /**
-     * List of lambdas that invoke the `run` methods of AMD64 option classes.
-     */
-    std::vector<std::function<bool(MachineFunction&, bool)>> options_amd64;
-
-    /**
-     * List of lambdas that invoke the `run` methods of ARM64 option classes.
-     */
-    std::vector<std::function<bool(MachineFunction&, bool)>> options_arm64;
-
     /**
      * Whether the module is enabled (default) or disabled.
      * 
@@ -107,45 +99,25 @@ private:
 
 public:
 
-    /**
-     * Constructor that initializes the list of substitution option classes.
-     */
-    TransformStackMovImmediatesModule() {
-        options_amd64 = {
-            [&](MachineFunction &MF, bool modifyAll) { return TransformStackMovImmediatesOptionAMD64_ADD().runOnMachineFunction(MF, modifyAll); },
-            [&](MachineFunction &MF, bool modifyAll) { return TransformStackMovImmediatesOptionAMD64_SUB().runOnMachineFunction(MF, modifyAll); },
-            [&](MachineFunction &MF, bool modifyAll) { return TransformStackMovImmediatesOptionAMD64_XOR().runOnMachineFunction(MF, modifyAll); }
-        };
-
-        options_arm64 = {
-            // ARM64 doesn't have `mov [reg+offset], imm`, so no need to substitute anything.
-        };
-    }
-
     /**
      * Main execution method for the TransformStackMovImmediatesModule class.
      *
      * @param MachineFunction& MF The machine function to run the substitution on.
+     * @param TransformContext& context State shared by all modules (e.g. loop & block frequency information).
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF) {
+    bool runOnMachineFunction(MachineFunction &MF, TransformContext &context) {
         // Ensure module is enabled
         if (!moduleIsEnabled()) return false;
         bool modifyAll = true || moduleIsBeingTested(); // We always modify all instances
 
-        // Run random compatible options
+        // Ensure the architecture is supported
         auto architecture = MF.getTarget().getTargetTriple().getArch();
-        int index = 0;
 
         switch (architecture) {
-            // AMD64
+            // AMD64 & ARM64 (ARM64 doesn't have `mov [reg+offset], imm`, so it has no registered options)
             case Triple::x86_64:
-                index = std::rand() % options_amd64.size();
-                modified = options_amd64[index](MF, modifyAll) || modified;
-                break;
-            // ARM64
             case Triple::aarch64:
-                // ARM64 doesn't have `mov [reg+offset], imm`, so no need to substitute anything.
                 break;
             // Unknown architecture
             default:
@@ -153,6 +125,34 @@ public:
                 break;
         }
 
+        // Inform user that we are running this module
+        dbgs() << "        ↳ Running module: TransformStackMovImmediates(modifyAll=" << modifyAll << ").\n";
+
+        // Pick a random compatible option for each instruction, weighted by the cost model of the target
+        TransformOptionSampler sampler("TransformStackMovImmediates", MF);
+        if (!sampler.hasOptions()) return modified;
+
+        std::vector<TransformContext::Candidate> candidates;
+
+        for (auto &MachineBasicBlock : MF) {
+            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
+                MachineInstr &Instruction = *MachineInstruction++;
+
+                const TransformOption* option = sampler.pick(Instruction);
+                if (!option) continue;
+
+                // Lower the density of modifications in hot code (unless the module is being tested)
+                if (!moduleIsBeingTested() && !context.shouldModify(MachineBasicBlock)) continue;
+
+                candidates.push_back({ &Instruction, option, sampler.getCandidateCount() });
+            }
+        }
+
+        // Apply the options (ranked & picked under the growth budget, if any)
+        if (context.applyOptions(candidates)) {
+            modified = true;
+        }
+
         return modified;
     }
 
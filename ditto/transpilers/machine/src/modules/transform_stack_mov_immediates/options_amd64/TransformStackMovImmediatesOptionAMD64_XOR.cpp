@@ -46,6 +46,8 @@
  * Regular includes
  */
 #include "../../../../../shared/helpers/RandomHelper.cpp"
+#include "../../../helpers/TransformContext.cpp"
+#include "../../../helpers/TransformOptionRegistry.cpp"
 
 /**
  * Namespace(s) to use
@@ -66,85 +68,127 @@ private:
 
 public:
 
+    /**
+     * Check if the given instruction can be substituted by the TransformStackMovImmediatesOptionAMD64_XOR class.
+     *
+     * @param const MachineInstr& instruction The instruction to check.
+     * @return bool Positive if the instruction can be substituted.
+     */
+    bool isCandidate(const MachineInstr &instruction) {
+        return isStackMovImmediate(instruction);
+    }
+
     /**
      * Main execution method for the TransformStackMovImmediatesOptionAMD64_XOR class.
      *
-     * @param MachineFunction& MF The machine function to run the substitution on.
-     * @param bool modifyAll Whether all the occurrences should be modified (for testing purposes).
+     * @param MachineInstr& Instruction The instruction to run the substitution on.
+     * @param TransformContext& context State shared by all substitutions of the machine function.
      * @return bool Indicates if the machine function was modified.
      */
-    bool runOnMachineFunction(MachineFunction &MF, bool modifyAll) {
+    bool runOnMachineInstruction(MachineInstr &Instruction, TransformContext &context) {
         // Local variables
+        auto MachineInstruction = std::next(Instruction.getIterator());
+        auto &MachineBasicBlock = *Instruction.getParent();
+        MachineFunction &MF = *MachineBasicBlock.getParent();
         const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
         MachineRegisterInfo &MRI = MF.getRegInfo();
 
-        // Inform user that we are running this option of the module
-        dbgs() << "        ↳ Running AMD64 module: TransformStackMovImmediates(option=XOR,modifyAll=" << modifyAll << ").\n";
-
-        // For each line in each basic block, perform our substitution
-        for (auto &MachineBasicBlock : MF) {
-            for (auto MachineInstruction = MachineBasicBlock.begin(); MachineInstruction != MachineBasicBlock.end(); ) {
-                MachineInstr &Instruction = *MachineInstruction++;
-
-                // Only modify `mov` instructions with immediate values
-                if (!isStackMovImmediate(Instruction)) {
-                    continue;
-                }
-
-                // Inform user that we encountered a `mov` instruction with immediate value
-                dbgs() << "          ↳ Found AMD64 mov instruction with immediate: ";
-                Instruction.print(dbgs());
-
-                // Obtain information about the instruction
-                const DebugLoc& debugLocation = Instruction.getDebugLoc();
-                int destinationFrameIndex = Instruction.getOperand(0).getIndex();
-                size_t immediateValue = (size_t) Instruction.getOperand((Instruction.getNumOperands() - 1)).getImm();
-                size_t immediateSize = getMovImmediateSize(Instruction);
-                size_t originalOpcode = Instruction.getOpcode();
-                size_t movRegImmediateOpcode = getMovRegImmediateReplacement(Instruction);
-                unsigned xorOpcode = getMovSizeXorReplacement(Instruction);
-
-                // Generate XOR key on compile time
-                size_t xorKey = RandomHelper::getSimilarIntegerForDestination(immediateSize, immediateValue, false);
-
-                // `xor` the immediate value and mask it to the correct size
-                size_t immediateValueEncoded = immediateValue ^ xorKey;
-                int64_t immediateMask = (immediateSize == 64) ? -1 : ((1ULL << immediateSize) - 1);
-                immediateValueEncoded = immediateValueEncoded & immediateMask;
-
-                // Register to use in the substition
-                Register virtualXorKeyRegister;
-
-                // Allocate a virtual register for the `xor` key
-                switch (immediateSize) {
-                    case 64: virtualXorKeyRegister = MRI.createVirtualRegister(&X86::GR64RegClass); break;
-                    case 32: virtualXorKeyRegister = MRI.createVirtualRegister(&X86::GR32RegClass); break;
-                    case 16: virtualXorKeyRegister = MRI.createVirtualRegister(&X86::GR16RegClass); break;
-                    default: virtualXorKeyRegister = MRI.createVirtualRegister(&X86::GR8RegClass); break;
-                }
-
-                // 1. mov [xor key register], [xor key immediate value]
-                BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(movRegImmediateOpcode), virtualXorKeyRegister).addImm(xorKey);
-        
-                // 2. mov [rbp+offset], [encoded immediate value]
-                MachineInstr* StackMovImmediateEncoded = MF.CloneMachineInstr(&Instruction);
-                StackMovImmediateEncoded->getOperand(StackMovImmediateEncoded->getNumOperands() - 1).setImm(immediateValueEncoded);
-                MachineBasicBlock.insert(MachineInstruction, StackMovImmediateEncoded);
-       
-                // 3. xor [rbp+offset], [xor key register]
-                MachineInstrBuilder NewXorInstruction = BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(xorOpcode));
-                for (unsigned i = 0; i < Instruction.getNumOperands() - 1; ++i) NewXorInstruction.add(Instruction.getOperand(i));
-                NewXorInstruction.addReg(virtualXorKeyRegister);
-
-                // Erase the original instruction after inserting the new ones
-                Instruction.eraseFromParent();
-
-                // Inform module and user that we've successfully substituted the immediate value.
-                modified = true;
-                dbgs() << "          ✓ Modified immediate value using random option `XOR`.\n";
-            }
+        // Inform user that we encountered a `mov` instruction with immediate value
+        dbgs() << "          ↳ Found AMD64 mov instruction with immediate: ";
+        Instruction.print(dbgs());
+
+        // Obtain information about the instruction
+        const DebugLoc& debugLocation = Instruction.getDebugLoc();
+        int destinationFrameIndex = Instruction.getOperand(0).getIndex();
+        size_t immediateValue = (size_t) Instruction.getOperand((Instruction.getNumOperands() - 1)).getImm();
+        size_t immediateSize = getMovImmediateSize(Instruction);
+        size_t originalOpcode = Instruction.getOpcode();
+        size_t movRegImmediateOpcode = getMovRegImmediateReplacement(Instruction);
+        unsigned xorOpcode = getMovSizeXorReplacement(Instruction);
+
+        // Register class of the `xor` key
+        const TargetRegisterClass* keyRegisterClass;
+
+        switch (immediateSize) {
+            case 64: keyRegisterClass = &X86::GR64RegClass; break;
+            case 32: keyRegisterClass = &X86::GR32RegClass; break;
+            case 16: keyRegisterClass = &X86::GR16RegClass; break;
+            default: keyRegisterClass = &X86::GR8RegClass; break;
         }
 
+        // Store the decoded constant of an earlier substitution of the same immediate in this block (if any)
+        if (Register decodedConstant = context.getDecodedConstant(Instruction, keyRegisterClass)) {
+            // 1. mov [rbp+offset], [decoded constant register]
+            MachineInstrBuilder StackMovRegister = BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(getMovRegStoreReplacement(Instruction)));
+            for (unsigned i = 0; i < Instruction.getNumOperands() - 1; ++i) StackMovRegister.add(Instruction.getOperand(i));
+            StackMovRegister.addReg(decodedConstant);
+
+            // Erase the original instruction after inserting the new one
+            Instruction.eraseFromParent();
+
+            modified = true;
+            return modified;
+        }
+
+        // Share the key register of the current run of adjacent stores (e.g. strings moved to the stack)
+        size_t xorKey = 0;
+        Register virtualXorKeyRegister = context.getRunKey(Instruction, keyRegisterClass, xorKey);
+        bool downgrade = false;
+
+        if (!virtualXorKeyRegister) {
+            // Use an immediate `xor` key (which needs no additional register) in loops, or if the block is under register pressure
+            downgrade = context.shouldFoldKey(Instruction) || context.getPressureDecision(Instruction, keyRegisterClass, true) == TransformContext::PressureDecision::Downgrade;
+
+            // Generate XOR key on compile time (immediate keys of 64-bit instructions are sign extended 32-bit values)
+            xorKey = RandomHelper::getSimilarIntegerForDestination((downgrade && immediateSize == 64) ? 32 : immediateSize, immediateValue, false);
+            if (downgrade && immediateSize == 64) xorKey = (size_t) (int64_t) (int32_t) xorKey;
+        }
+
+        if (!virtualXorKeyRegister && !downgrade) {
+            virtualXorKeyRegister = MRI.createVirtualRegister(keyRegisterClass);
+
+            // 1. mov [xor key register], [xor key immediate value]
+            BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(movRegImmediateOpcode), virtualXorKeyRegister).addImm(xorKey);
+            context.setRunKey(Instruction, virtualXorKeyRegister, xorKey);
+        }
+
+        // `xor` the immediate value and mask it to the correct size
+        size_t immediateValueEncoded = immediateValue ^ xorKey;
+        int64_t immediateMask = (immediateSize == 64) ? -1 : ((1ULL << immediateSize) - 1);
+        immediateValueEncoded = immediateValueEncoded & immediateMask;
+
+        // 2. mov [rbp+offset], [encoded immediate value]
+        MachineInstr* StackMovImmediateEncoded = MF.CloneMachineInstr(&Instruction);
+        StackMovImmediateEncoded->getOperand(StackMovImmediateEncoded->getNumOperands() - 1).setImm(immediateValueEncoded);
+        MachineBasicBlock.insert(MachineInstruction, StackMovImmediateEncoded);
+
+        // 3. xor [rbp+offset], [xor key register] (or [xor key immediate value] if downgraded)
+        MachineInstrBuilder NewXorInstruction = BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(downgrade ? getMovSizeXorImmediateReplacement(Instruction) : xorOpcode));
+        for (unsigned i = 0; i < Instruction.getNumOperands() - 1; ++i) NewXorInstruction.add(Instruction.getOperand(i));
+
+        if (downgrade) {
+            NewXorInstruction.addImm(xorKey);
+        } else {
+            NewXorInstruction.addReg(virtualXorKeyRegister);
+        }
+
+        // 4. mov [decoded constant register], [rbp+offset] (if the same immediate recurs in this block)
+        if (context.shouldKeepDecodedConstant(Instruction)) {
+            Register decodedConstant = MRI.createVirtualRegister(keyRegisterClass);
+
+            MachineInstrBuilder StackLoadInstruction = BuildMI(MachineBasicBlock, MachineInstruction, debugLocation, TII->get(getMovRegLoadReplacement(Instruction)), decodedConstant);
+            for (unsigned i = 0; i < Instruction.getNumOperands() - 1; ++i) StackLoadInstruction.add(Instruction.getOperand(i));
+
+            context.setDecodedConstant(Instruction, decodedConstant);
+        }
+
+        // Erase the original instruction after inserting the new ones
+        Instruction.eraseFromParent();
+
+        // Inform module and user that we've successfully substituted the immediate value.
+        modified = true;
+        dbgs() << "          ✓ Modified immediate value using random option `XOR`.\n";
+
         return modified;
     }
 
@@ -237,6 +281,31 @@ private:
         }
     }
 
+    /**
+     * Determines the XOR (with immediate) replacement opcode for a given MOV instruction opcode.
+     * 
+     * This is the downgraded form of the substitution, which uses an immediate key instead of a key
+     * register, so that it doesn't add register pressure.
+     * 
+     * If the opcode does not match any known MOV instruction types, a fatal error is reported.
+     *
+     * @param MachineFunction& MF instruction The `MachineInstr` whose opcode will be checked and replaced with the corresponding XOR opcode.
+     * @return unsigned The corresponding XOR (with immediate) opcode for the MOV instruction's immediate size.
+     */
+    unsigned getMovSizeXorImmediateReplacement(const MachineInstr &instruction) {
+        unsigned opcode = instruction.getOpcode();
+
+        switch (opcode) {
+            case X86::MOV8mi:    return X86::XOR8mi;
+            case X86::MOV16mi:   return X86::XOR16mi;
+            case X86::MOV32mi:   return X86::XOR32mi;
+            case X86::MOV64mi32: return X86::XOR64mi32;
+            default:
+                report_fatal_error(formatv("TransformStackMovImmediatesOptionAMD64_XOR - Unknown XOR (with immediate) replacement size for opcode {0:X}: {1}.", opcode, instruction));
+                return 0;
+        }
+    }
+
     /**
      * Determines the MOVri replacement opcode for a given MOVmi instruction opcode.
      * 
@@ -263,4 +332,63 @@ private:
         }
     }
 
-};
\ No newline at end of file
+    /**
+     * Determines the MOVmr replacement opcode for a given MOVmi instruction opcode.
+     * 
+     * This is used to store a decoded constant (kept in a register) instead of the immediate value.
+     * 
+     * If the opcode does not match any known MOV instruction types, a fatal error is reported.
+     *
+     * @param MachineFunction& MF instruction The `MachineInstr` whose opcode will be checked and replaced with the corresponding MOVmr opcode.
+     * @return unsigned The corresponding MOVmr opcode for the MOVmi instruction's immediate size.
+     */
+    unsigned getMovRegStoreReplacement(const MachineInstr &instruction) {
+        unsigned opcode = instruction.getOpcode();
+
+        switch (opcode) {
+            case X86::MOV8mi:    return X86::MOV8mr;
+            case X86::MOV16mi:   return X86::MOV16mr;
+            case X86::MOV32mi:   return X86::MOV32mr;
+            case X86::MOV64mi32: return X86::MOV64mr;
+            default:
+                report_fatal_error(formatv("TransformStackMovImmediatesOptionAMD64_XOR - Unknown MOVmr replacement size for opcode {0:X}: {1}.", opcode, instruction));
+                return 0;
+        }
+    }
+
+    /**
+     * Determines the MOVrm replacement opcode for a given MOVmi instruction opcode.
+     * 
+     * This is used to load the decoded constant back from the stack, so that later stores of the same
+     * immediate value can store that register instead.
+     * 
+     * If the opcode does not match any known MOV instruction types, a fatal error is reported.
+     *
+     * @param MachineFunction& MF instruction The `MachineInstr` whose opcode will be checked and replaced with the corresponding MOVrm opcode.
+     * @return unsigned The corresponding MOVrm opcode for the MOVmi instruction's immediate size.
+     */
+    unsigned getMovRegLoadReplacement(const MachineInstr &instruction) {
+        unsigned opcode = instruction.getOpcode();
+
+        switch (opcode) {
+            case X86::MOV8mi:    return X86::MOV8rm;
+            case X86::MOV16mi:   return X86::MOV16rm;
+            case X86::MOV32mi:   return X86::MOV32rm;
+            case X86::MOV64mi32: return X86::MOV64rm;
+            default:
+                report_fatal_error(formatv("TransformStackMovImmediatesOptionAMD64_XOR - Unknown MOVrm replacement size for opcode {0:X}: {1}.", opcode, instruction));
+                return 0;
+        }
+    }
+
+};
+
+/**
+ * Register the option with the transform option registry (as `TransformStackMovImmediates` option `XOR`).
+ */
+static RegisterTransformOption<TransformStackMovImmediatesOptionAMD64_XOR> TransformStackMovImmediatesOptionAMD64_XORRegistration(
+    "TransformStackMovImmediates", "XOR", Triple::x86_64,
+    { X86::MOV8mi, X86::MOV16mi, X86::MOV32mi, X86::MOV64mi32 },
+    { InstructionClass::MovRegImmediate, InstructionClass::MovStackImmediate, InstructionClass::AluStackReg },
+    1
+);
\ No newline at end of file
@@ -0,0 +1,263 @@
+/**
+ * GNU General Public License, version 2.0.
+ *
+ * Copyright (c) 2025 Tijme Gommers (@tijme).
+ *
+ * This source code file is part of Dittobytes. Dittobytes is
+ * licensed under GNU General Public License, version 2.0, and
+ * you are free to use, modify, and distribute this file under
+ * its terms. However, any modified versions of this file must
+ * include this same license and copyright notice.
+ */
+
+#pragma once
+
+/**
+ * Regular includes
+ */
+#include <stdint.h>
+#include <cctype>
+#include <string>
+
+/**
+ * The header of a compiled noise corpus (`<os>-<arch>.bin`).
+ *
+ * All integers are little endian. The file consists of the header, the buckets, the blocks and the
+ * byte pool (in that order, each section 8-byte aligned). It is written by `noise.py provide` (from the
+ * extracted JSON) and memory-mapped by the machine transpiler, which uses it without any parsing.
+ */
+struct NoiseCorpusHeader {
+
+    /**
+     * The magic (`DNC1`) and the version of the format.
+     */
+    char magic[4];
+    uint32_t version;
+
+    /**
+     * The amount of buckets and the amount of (deduplicated) blocks.
+     */
+    uint32_t bucketCount;
+    uint32_t blockCount;
+
+    /**
+     * The file offsets of the bucket table, the block table and the byte pool, and the size of the byte pool.
+     */
+    uint64_t bucketsOffset;
+    uint64_t blocksOffset;
+    uint64_t bytesOffset;
+    uint64_t bytesSize;
+
+};
+
+/**
+ * A bucket of blocks with the same register footprint and the same amount of instructions.
+ *
+ * Buckets are sorted by amount of instructions and then by footprint. Their blocks are consecutive.
+ */
+struct NoiseCorpusBucket {
+
+    /**
+     * The registers the blocks write to (see `NoiseCorpusFormat::getFootprintBit`).
+     */
+    uint64_t footprint;
+
+    /**
+     * The sum of the (real-world) counts of the blocks in the bucket.
+     */
+    uint64_t count;
+
+    /**
+     * The amount of instructions of every block in the bucket.
+     */
+    uint32_t instructionCount;
+
+    /**
+     * The index of the first block, and the amount of blocks, in the bucket.
+     */
+    uint32_t firstBlock;
+    uint32_t blockCount;
+
+    /**
+     * Reserved (zero).
+     */
+    uint32_t reserved;
+
+};
+
+/**
+ * A single (deduplicated) block of harvested instructions.
+ *
+ * The block is stored in the byte pool as the length of every instruction (one byte each), followed by
+ * the encoded instructions.
+ */
+struct NoiseCorpusBlock {
+
+    /**
+     * The sum of the counts of this block and all blocks before it in its bucket. The count of a block is
+     * how often its pattern (the block with registers & immediates abstracted) was seen while harvesting.
+     */
+    uint64_t cumulativeCount;
+
+    /**
+     * The offset of the block in the byte pool.
+     */
+    uint32_t offset;
+
+    /**
+     * The size (in bytes) of the encoded instructions.
+     */
+    uint16_t size;
+
+    /**
+     * The amount of instructions.
+     */
+    uint16_t instructionCount;
+
+};
+
+static_assert(sizeof(NoiseCorpusHeader) == 48, "The noise corpus header must not be padded.");
+static_assert(sizeof(NoiseCorpusBucket) == 32, "A noise corpus bucket must not be padded.");
+static_assert(sizeof(NoiseCorpusBlock) == 16, "A noise corpus block must not be padded.");
+
+/**
+ * Constants & register footprints of the compiled noise corpus format.
+ *
+ * A register footprint has one bit per architectural register (sub-registers map to their full register).
+ * Writes to the instruction (and shadow stack) pointer and the zero registers are not part of the footprint, nor is the write
+ * to the stack pointer by a call or return that terminates the block. Registers that are not known (e.g.
+ * segment or x87 registers) set the `other` bit, which is never compatible.
+ */
+class NoiseCorpusFormat {
+
+public:
+
+    /**
+     * The magic & the version of the format.
+     */
+    static constexpr char MAGIC[4] = { 'D', 'N', 'C', '1' };
+    static constexpr uint32_t VERSION = 2;
+
+    /**
+     * The footprint bits of the flags, of all vector (and floating point) registers, and of unknown registers.
+     */
+    static constexpr int BIT_FLAGS_AMD64 = 16;
+    static constexpr int BIT_VECTOR_AMD64 = 17;
+    static constexpr int BIT_FLAGS_ARM64 = 32;
+    static constexpr int BIT_VECTOR_ARM64 = 33;
+    static constexpr int BIT_OTHER = 63;
+
+    /**
+     * Retrieve the name of the full register of every general purpose footprint bit.
+     *
+     * @param bool arm64 Whether the footprint is of ARM64 (or AMD64).
+     * @param int bit The footprint bit.
+     * @return const char* The name of the register (or a null pointer if the bit is not a general purpose register).
+     */
+    static const char* getRegisterName(bool arm64, int bit) {
+        static const char* amd64[] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+        static const char* arm64Names[] = {
+            "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15",
+            "x16", "x17", "x18", "x19", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "x29", "x30", "sp"
+        };
+
+        if (!arm64) return (bit >= 0 && bit < 16) ? amd64[bit] : nullptr;
+        return (bit >= 0 && bit < 32) ? arm64Names[bit] : nullptr;
+    }
+
+    /**
+     * Retrieve the footprint bit of a (lowercase) register name, as written by the disassembler.
+     *
+     * @param bool arm64 Whether the register is of ARM64 (or AMD64).
+     * @param const std::string& name The name of the register (e.g. `eax` or `w3`).
+     * @return int The footprint bit (or -1 if writes to the register are not part of the footprint).
+     */
+    static int getFootprintBit(bool arm64, const std::string& name) {
+        return arm64 ? getFootprintBitARM64(name) : getFootprintBitAMD64(name);
+    }
+
+private:
+
+    /**
+     * Check if the given name is a prefix followed by a number (e.g. `xmm12`).
+     *
+     * @param const std::string& name The name of the register.
+     * @param const std::string& prefix The prefix.
+     * @return int The number (or -1 if the name doesn't match).
+     */
+    static int getNumberAfterPrefix(const std::string& name, const std::string& prefix) {
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) return -1;
+
+        int result = 0;
+        for (size_t index = prefix.size(); index < name.size(); index++) {
+            if (!std::isdigit((unsigned char) name[index])) return -1;
+            result = result * 10 + (name[index] - '0');
+        }
+
+        return result;
+    }
+
+    /**
+     * Retrieve the footprint bit of an AMD64 register name.
+     *
+     * @param const std::string& name The name of the register.
+     * @return int The footprint bit (or -1 if writes to the register are not part of the footprint).
+     */
+    static int getFootprintBitAMD64(const std::string& name) {
+        static const char* legacy[][5] = {
+            { "rax", "eax", "ax", "al", "ah" }, { "rcx", "ecx", "cx", "cl", "ch" }, { "rdx", "edx", "dx", "dl", "dh" }, { "rbx", "ebx", "bx", "bl", "bh" },
+            { "rsp", "esp", "sp", "spl", "" }, { "rbp", "ebp", "bp", "bpl", "" }, { "rsi", "esi", "si", "sil", "" }, { "rdi", "edi", "di", "dil", "" }
+        };
+
+        for (int bit = 0; bit < 8; bit++) {
+            for (const char* alias : legacy[bit]) {
+                if (*alias && name == alias) return bit;
+            }
+        }
+
+        // The extended registers (e.g. `r8`, `r8d`, `r8w` & `r8b`)
+        std::string full = name;
+        if (!full.empty() && (full.back() == 'd' || full.back() == 'w' || full.back() == 'b')) full.pop_back();
+
+        int number = getNumberAfterPrefix(full, "r");
+        if (number >= 8 && number <= 15) return number;
+
+        if (name == "rflags" || name == "eflags" || name == "flags") return BIT_FLAGS_AMD64;
+        if (name == "rip" || name == "eip" || name == "ip" || name == "ssp") return -1;
+
+        for (const char* prefix : { "xmm", "ymm", "zmm", "k" }) {
+            if (getNumberAfterPrefix(name, prefix) >= 0) return BIT_VECTOR_AMD64;
+        }
+
+        if (name == "mxcsr") return BIT_VECTOR_AMD64;
+
+        return BIT_OTHER;
+    }
+
+    /**
+     * Retrieve the footprint bit of an ARM64 register name.
+     *
+     * @param const std::string& name The name of the register.
+     * @return int The footprint bit (or -1 if writes to the register are not part of the footprint).
+     */
+    static int getFootprintBitARM64(const std::string& name) {
+        if (name == "xzr" || name == "wzr" || name == "pc") return -1;
+        if (name == "sp" || name == "wsp") return 31;
+        if (name == "fp") return 29;
+        if (name == "lr") return 30;
+        if (name == "nzcv") return BIT_FLAGS_ARM64;
+        if (name == "fpcr" || name == "fpsr") return BIT_VECTOR_ARM64;
+
+        for (const char* prefix : { "x", "w" }) {
+            int number = getNumberAfterPrefix(name, prefix);
+            if (number >= 0 && number <= 30) return number;
+        }
+
+        for (const char* prefix : { "v", "q", "d", "s", "h", "b", "z", "p" }) {
+            if (getNumberAfterPrefix(name, prefix) >= 0) return BIT_VECTOR_ARM64;
+        }
+
+        return BIT_OTHER;
+    }
+
+};
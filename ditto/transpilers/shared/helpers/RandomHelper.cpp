@@ -12,13 +12,21 @@
 
 #pragma once
 
+/**
+ * LLVM includes
+ */
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/xxhash.h"
+
 /**
  * Regular includes
  */
 #include <stdint.h>
+#include <cstdlib>
 #include <random>
 #include <chrono>
 #include <iostream>
+#include <vector>
 
 /**
  * Namespace(s) to use
@@ -41,6 +49,33 @@ public:
         std::srand(millis);
     }
 
+    /**
+     * Start the random substream of a function (if a seed is configured).
+     *
+     * With `MM_SEED`, the generator is reseeded with a hash of the seed, the function name and the stream (e.g.
+     * the step in the pass pipeline). Every function is then transformed the same way, regardless of the other
+     * functions in its module, the partition it is compiled in, or the amount of partitions compiled in parallel.
+     * Without `MM_SEED`, the generator keeps its non-deterministic seed.
+     *
+     * @param StringRef function The name of the function.
+     * @param uint32_t stream The substream of the function.
+     */
+    static void seedFunction(StringRef function, uint32_t stream) {
+        const char* MM_SEED = std::getenv("MM_SEED");
+        if (!MM_SEED || !*MM_SEED) return;
+
+        uint64_t seedHash = xxh3_64bits(StringRef(MM_SEED));
+        uint64_t functionHash = xxh3_64bits(function);
+
+        std::seed_seq sequence {
+            (uint32_t) seedHash, (uint32_t) (seedHash >> 32),
+            (uint32_t) functionHash, (uint32_t) (functionHash >> 32),
+            stream
+        };
+
+        getRandomGenerator().seed(sequence);
+    }
+
     /**
      * Generates a random integer for a given destination size that is similar to the original value.
      * 
@@ -92,22 +127,34 @@ public:
      * @return bool Positive if the 1 in X chance hit.
      */
     static bool getChanceOneIn(int x) {
-        auto rng = RandomHelper::getRandomGenerator();
+        auto& rng = RandomHelper::getRandomGenerator();
         std::uniform_int_distribution<int> dist(1, x);
         return dist(rng) == 1;
     }
 
+    /**
+     * Get a random index into the given list of weights, with a chance proportional to the weight at that index.
+     * 
+     * @param const std::vector<double>& weights The (non-negative) weights to pick from.
+     * @return size_t The picked index.
+     */
+    static size_t getWeightedIndex(const std::vector<double>& weights) {
+        auto& rng = RandomHelper::getRandomGenerator();
+        std::discrete_distribution<size_t> dist(weights.begin(), weights.end());
+        return dist(rng);
+    }
+
 private:
 
     /**
-     * Generates a random 64-bit number by combining two random integers.
+     * Generates a random 64-bit number by combining two random integers (of the, possibly seeded, generator).
      * 
      * @return size_t A random 64-bit number generated by combining two random integers.
      */
     static size_t getRandomNumber() {
-        std::random_device rd;
-        uint64_t high = ((uint64_t) rd()) << 32;
-        uint64_t low  = rd();
+        auto& rng = RandomHelper::getRandomGenerator();
+        uint64_t high = ((uint64_t) rng()) << 32;
+        uint64_t low  = rng();
 
         return high | low;    
     }